@@ -0,0 +1,88 @@
+/**
+ * --------------------------------------------------------------------------------------------------------------------
+ * Example sketch/program showing how to read each card once per visit and notice when it is removed.
+ * --------------------------------------------------------------------------------------------------------------------
+ * This is a MFRC522 library example; for further details and other examples see: https://github.com/miguelbalboa/rfid
+ *
+ * PICC_IsNewCardPresent() only finds cards in state IDLE. MFRC522PresenceTracker remembers the card on the reader
+ * and checks every 100ms that it is still there, with WUPA and SELECT of its UID. The sketch prints the UID when the
+ * card arrives and how long it stayed when it leaves. A card lying on the reader is not read again.
+ *
+ * Build the tracker on an MFRC522Extended and a TagInfo to keep ISO/IEC 14443-4 cards activated while present.
+ *
+ * @license Released into the public domain.
+ *
+ * Typical pin layout used:
+ * -----------------------------------------------------------------------------------------
+ *             MFRC522      Arduino       Arduino   Arduino    Arduino          Arduino
+ *             Reader/PCD   Uno/101       Mega      Nano v3    Leonardo/Micro   Pro Micro
+ * Signal      Pin          Pin           Pin       Pin        Pin              Pin
+ * -----------------------------------------------------------------------------------------
+ * RST/Reset   RST          9             5         D9         RESET/ICSP-5     RST
+ * SPI SS      SDA(SS)      10            53        D10        10               10
+ * SPI MOSI    MOSI         11 / ICSP-4   51        D11        ICSP-4           16
+ * SPI MISO    MISO         12 / ICSP-1   50        D12        ICSP-1           14
+ * SPI SCK     SCK          13 / ICSP-3   52        D13        ICSP-3           15
+ *
+ * More pin layouts for other boards can be found here: https://github.com/miguelbalboa/rfid#pin-layout
+ *
+ */
+
+#include <SPI.h>
+#include <MFRC522.h>
+#include <MFRC522PresenceTracker.h>
+
+#define RST_PIN         9          // Configurable, see typical pin layout above
+#define SS_PIN          10         // Configurable, see typical pin layout above
+
+MFRC522 mfrc522(SS_PIN, RST_PIN);  // Create MFRC522 instance
+MFRC522PresenceTracker tracker(mfrc522);
+
+/**
+ * Initialize.
+ */
+void setup() {
+  Serial.begin(9600); // Initialize serial communications with the PC
+  while (!Serial);    // Do nothing if no serial port is opened (added for Arduinos based on ATMEGA32U4)
+  SPI.begin();        // Init SPI bus
+  mfrc522.PCD_Init(); // Init MFRC522 card
+
+  tracker.setInterval(100);     // Check every 100ms
+  tracker.setHysteresis(1, 3);  // Report a card at once, its removal after 3 missed checks
+  Serial.println(F("Put a card on the reader, then take it away..."));
+}
+
+/**
+ * Main loop.
+ */
+void loop() {
+  MFRC522PresenceTracker::PresenceReport report;
+
+  tracker.poll();
+  while (tracker.getEvent(&report)) {
+    if (report.event == MFRC522PresenceTracker::Presence_Arrived) {
+      // The card is selected now, read it here
+      Serial.print(F("Card arrived, UID:"));
+      dump_byte_array(report.uid.uidByte, report.uid.size);
+      Serial.print(F(", PICC type: "));
+      Serial.println(mfrc522.PICC_GetTypeName(mfrc522.PICC_GetType(report.uid.sak)));
+    }
+    else if (report.event == MFRC522PresenceTracker::Presence_Departed) {
+      Serial.print(F("Card left, UID:"));
+      dump_byte_array(report.uid.uidByte, report.uid.size);
+      Serial.print(F(", present for "));
+      Serial.print(report.lastSeen - report.arrival);
+      Serial.println(F("ms"));
+    }
+  }
+}
+
+/**
+ * Helper routine to dump a byte array as hex values to Serial.
+ */
+void dump_byte_array(const byte *buffer, byte bufferSize) {
+  for (byte i = 0; i < bufferSize; i++) {
+    Serial.print(buffer[i] < 0x10 ? " 0" : " ");
+    Serial.print(buffer[i], HEX);
+  }
+}
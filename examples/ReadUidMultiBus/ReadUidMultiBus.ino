@@ -0,0 +1,117 @@
+/**
+ * --------------------------------------------------------------------------------------------------------------------
+ * Example sketch/program showing how to read data from more than one PICC with readers on separate SPI buses.
+ * --------------------------------------------------------------------------------------------------------------------
+ * This is a MFRC522 library example; for further details and other examples see: https://github.com/miguelbalboa/rfid
+ *
+ * Like ReadUidMultiReader, but each MFRC522 gets its own SPIClass and SPISettings. Many MCUs have more than one
+ * hardware SPI controller (ESP32: VSPI and HSPI, RP2040: SPI and SPI1). Readers on different buses do not share
+ * clock and data lines, so they do not disturb each other and can be polled at the same time, e.g. from one task
+ * per bus. On boards with only one SPI bus both readers use SPI, only with different settings.
+ *
+ * @license Released into the public domain.
+ *
+ * Typical pin layout used:
+ * -----------------------------------------------------------------------------------------
+ *             MFRC522      ESP32              ESP32              RP2040           RP2040
+ *             Reader/PCD   Bus 1 (VSPI)       Bus 2 (HSPI)       Bus 1 (SPI)      Bus 2 (SPI1)
+ * Signal      Pin          Pin                Pin                Pin              Pin
+ * -----------------------------------------------------------------------------------------
+ * RST/Reset   RST          22                 22                 20               20
+ * SPI SS      SDA(SS)      5                  15                 17               13
+ * SPI MOSI    MOSI         23                 13                 19               11
+ * SPI MISO    MISO         19                 12                 16               12
+ * SPI SCK     SCK          18                 14                 18               10
+ *
+ * More pin layouts for other boards can be found here: https://github.com/miguelbalboa/rfid#pin-layout
+ *
+ */
+
+#include <SPI.h>
+#include <MFRC522.h>
+
+#if defined(ESP32)
+#define RST_PIN         22
+#define SS_1_PIN        5
+#define SS_2_PIN        15
+SPIClass spiBus2(HSPI);           // Second hardware SPI controller
+#define BUS_1           SPI
+#define BUS_2           spiBus2
+#elif defined(ARDUINO_ARCH_RP2040)
+#define RST_PIN         20
+#define SS_1_PIN        17
+#define SS_2_PIN        13
+#define BUS_1           SPI
+#define BUS_2           SPI1
+#else
+#define RST_PIN         9          // Configurable, see typical pin layout above
+#define SS_1_PIN        10         // Configurable, take a unused pin, only HIGH/LOW required, must be different to SS 2
+#define SS_2_PIN        8          // Configurable, take a unused pin, only HIGH/LOW required, must be different to SS 1
+#define BUS_1           SPI        // Only one SPI bus on this board
+#define BUS_2           SPI
+#endif
+
+#define NR_OF_READERS   2
+
+// Each reader may have its own clock, e.g. a slower one for a reader at the end of a long cable.
+MFRC522 mfrc522[NR_OF_READERS] = {
+  MFRC522(SS_1_PIN, RST_PIN, BUS_1, SPISettings(4000000u, MSBFIRST, SPI_MODE0)),
+  MFRC522(SS_2_PIN, RST_PIN, BUS_2, SPISettings(1000000u, MSBFIRST, SPI_MODE0)),
+};
+
+/**
+ * Initialize.
+ */
+void setup() {
+
+  Serial.begin(9600); // Initialize serial communications with the PC
+  while (!Serial);    // Do nothing if no serial port is opened (added for Arduinos based on ATMEGA32U4)
+
+  BUS_1.begin();      // Init both SPI buses, calling begin() twice on the same bus is harmless
+  BUS_2.begin();
+
+  for (uint8_t reader = 0; reader < NR_OF_READERS; reader++) {
+    mfrc522[reader].PCD_Init(); // Init each MFRC522 card on its bus
+    Serial.print(F("Reader "));
+    Serial.print(reader);
+    Serial.print(F(": "));
+    mfrc522[reader].PCD_DumpVersionToSerial();
+  }
+}
+
+/**
+ * Main loop.
+ */
+void loop() {
+
+  for (uint8_t reader = 0; reader < NR_OF_READERS; reader++) {
+    // Look for new cards
+
+    if (mfrc522[reader].PICC_IsNewCardPresent() && mfrc522[reader].PICC_ReadCardSerial()) {
+      Serial.print(F("Reader "));
+      Serial.print(reader);
+      // Show some details of the PICC (that is: the tag/card)
+      Serial.print(F(": Card UID:"));
+      dump_byte_array(mfrc522[reader].uid.uidByte, mfrc522[reader].uid.size);
+      Serial.println();
+      Serial.print(F("PICC type: "));
+      MFRC522::PICC_Type piccType = mfrc522[reader].PICC_GetType(mfrc522[reader].uid.sak);
+      Serial.println(mfrc522[reader].PICC_GetTypeName(piccType));
+
+      // Halt PICC
+      mfrc522[reader].PICC_HaltA();
+      // Stop encryption on PCD
+      mfrc522[reader].PCD_StopCrypto1();
+    } //if (mfrc522[reader].PICC_IsNewC
+  } //for(uint8_t reader
+}
+
+/**
+ * Helper routine to dump a byte array as hex values to Serial.
+ */
+void dump_byte_array(byte *buffer, byte bufferSize) {
+  for (byte i = 0; i < bufferSize; i++) {
+    Serial.print(buffer[i] < 0x10 ? " 0" : " ");
+    Serial.print(buffer[i], HEX);
+  }
+}
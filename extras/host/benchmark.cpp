@@ -0,0 +1,310 @@
+/**
+ * Benchmark of the library operations against the simulated MFRC522, see extras/host/README.rst.
+ *
+ *   ./benchmark [--iterations N] [--flow NAME]... [--format csv|json] [--spi-clock HZ]
+ *
+ * Every flow runs N times on reader 0 (SS 10, RST 9) with its PICC in the field. Per operation it reports
+ * the virtual time the MCU spends in the library, the SPI transactions and bytes, the register values read
+ * and written (FIFO bytes count one each), the frames and time on air, and the host CPU time of the
+ * simulation. Everything but the host time is deterministic, so the output of two commits can be diffed.
+ *
+ * Released into the public domain.
+ */
+#include <Arduino.h>
+#include <SPI.h>
+#include <MFRC522.h>
+#include <MFRC522Extended.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MFRC522Sim.h"
+#include "SimArduino.h"
+#include "SimClock.h"
+
+namespace {
+
+std::unique_ptr<MFRC522Sim> chip;
+std::unique_ptr<SimPicc> picc;
+std::unique_ptr<MFRC522> reader;
+std::unique_ptr<MFRC522Extended> readerExtended;
+MFRC522::MIFARE_Key defaultKey;
+
+// The PICC leaves and enters the field: back to IDLE, no session
+void resetPicc() {
+	reader->PCD_StopCrypto1();
+	picc->powerOff();
+	picc->powerOn();
+}
+
+bool selectPicc() {
+	resetPicc();
+	return reader->PICC_IsNewCardPresent() && reader->PICC_ReadCardSerial();
+}
+
+// REQA, anticollision and SELECT as PICC_IsNewCardPresent() and PICC_ReadCardSerial() do it
+bool runSelect() {
+	return reader->PICC_IsNewCardPresent() && reader->PICC_ReadCardSerial();
+}
+
+// Selects the PICC and sends it to HALT, for PICC_Reselect()
+bool haltPicc() {
+	return selectPicc() && reader->PICC_HaltA() == MFRC522::STATUS_OK;
+}
+
+// WUPA and SELECT of the known UID without anticollision
+bool runReselect() {
+	return reader->PICC_Reselect(reader->uid) == MFRC522::STATUS_OK;
+}
+
+bool runPollEmpty() {
+	return !reader->PICC_IsNewCardPresent();
+}
+
+bool runAuthRead() {
+	byte buffer[18];
+	byte size = sizeof(buffer);
+	return reader->PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, 7, &defaultKey, &reader->uid) == MFRC522::STATUS_OK
+			&& reader->MIFARE_Read(4, buffer, &size) == MFRC522::STATUS_OK;
+}
+
+// Authenticates every sector with key A and reads its blocks, trailer included
+bool runDumpClassic1K() {
+	byte buffer[18];
+	for (byte sector = 0; sector < 16; sector++) {
+		byte firstBlock = sector * 4;
+		if (reader->PCD_Authenticate(MFRC522::PICC_CMD_MF_AUTH_KEY_A, firstBlock + 3, &defaultKey, &reader->uid) != MFRC522::STATUS_OK) {
+			return false;
+		}
+		for (byte block = firstBlock; block < firstBlock + 4; block++) {
+			byte size = sizeof(buffer);
+			if (reader->MIFARE_Read(block, buffer, &size) != MFRC522::STATUS_OK) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// The 16 pages of a MIFARE Ultralight, READ returns 4 pages
+bool runDumpUltralight() {
+	byte buffer[18];
+	for (byte page = 0; page < 16; page += 4) {
+		byte size = sizeof(buffer);
+		if (reader->MIFARE_Read(page, buffer, &size) != MFRC522::STATUS_OK) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// REQA, SELECT, RATS, PPS, a SELECT APPLICATION APDU and DESELECT
+bool runRatsApdu() {
+	static byte apdu[] = { 0x00, 0xA4, 0x04, 0x00, 0x07, 0xD2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01, 0x00 };
+	MFRC522Extended::TagInfo tag;
+	byte response[64];
+	byte responseSize = sizeof(response);
+	return readerExtended->PICC_Activate(&tag) == MFRC522::STATUS_OK
+			&& readerExtended->TCL_Transceive(&tag, apdu, sizeof(apdu), response, &responseSize) == MFRC522::STATUS_OK
+			&& readerExtended->TCL_Deselect(&tag) == MFRC522::STATUS_OK;
+}
+
+struct Flow {
+	const char *name;
+	const char *picc;				// Type of the PICC in the field, nullptr for none
+	uint8_t uidSize;
+	bool (*prepare)();				// Not measured, e.g. brings the PICC into the ACTIVE state
+	bool (*run)();					// The measured operation
+};
+
+const Flow flows[] = {
+	{ "poll_empty",			nullptr,		0,	nullptr,		runPollEmpty },
+	{ "select_uid4",		"classic1k",	4,	nullptr,		runSelect },
+	{ "select_uid7",		"ultralight",	7,	nullptr,		runSelect },
+	{ "select_uid10",		"isodep",		10,	nullptr,		runSelect },
+	{ "reselect_uid4",		"classic1k",	4,	haltPicc,		runReselect },
+	{ "reselect_uid7",		"ultralight",	7,	haltPicc,		runReselect },
+	{ "auth_read",			"classic1k",	4,	selectPicc,		runAuthRead },
+	{ "dump_classic1k",		"classic1k",	4,	selectPicc,		runDumpClassic1K },
+	{ "dump_ultralight",	"ultralight",	7,	selectPicc,		runDumpUltralight },
+	{ "rats_apdu",			"isodep",		7,	nullptr,		runRatsApdu },
+};
+
+// Sums over the iterations of a flow
+struct Result {
+	const Flow *flow;
+	uint32_t iterations;
+	uint32_t failures;
+	uint64_t virtualNanos;
+	uint64_t hostNanos;
+	uint64_t spiTransactions;
+	uint64_t spiBytes;
+	uint64_t registerReads;
+	uint64_t registerWrites;
+	uint64_t rfNanos;
+	uint64_t rfFrames;
+};
+
+Result runFlow(const Flow &flow, uint32_t iterations) {
+	Result result;
+	memset(&result, 0, sizeof(result));
+	result.flow = &flow;
+	result.iterations = iterations;
+
+	if (flow.picc) {
+		static const uint8_t uid[] = { 0x04, 0x6B, 0x2A, 0x3C, 0x91, 0x5E, 0x80, 0x12, 0x34, 0x56 };
+		picc.reset(SimPicc::create(flow.picc, uid, flow.uidSize));
+		chip->addPicc(picc.get());
+	}
+	for (uint32_t i = 0; i < iterations; i++) {
+		if (picc) {
+			resetPicc();
+		}
+		if (flow.prepare && !flow.prepare()) {
+			result.failures++;
+			continue;
+		}
+		chip->resetStats();
+		SimArduino::resetCounters();
+		uint64_t virtualStart = SimClock::now();
+		auto hostStart = std::chrono::steady_clock::now();
+
+		if (!flow.run()) {
+			result.failures++;
+		}
+
+		result.hostNanos += (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - hostStart).count();
+		result.virtualNanos += SimClock::now() - virtualStart;
+		const MFRC522Sim::Stats &stats = chip->getStats();
+		result.spiTransactions += SimArduino::spiTransactions();
+		result.spiBytes += SimArduino::spiBytes();
+		result.registerReads += stats.registerReads;
+		result.registerWrites += stats.registerWrites;
+		result.rfNanos += stats.rfNanos;
+		result.rfFrames += stats.rfFrames;
+	}
+	if (picc) {
+		resetPicc();
+		chip->removePicc(picc.get());
+		picc.reset();
+	}
+	return result;
+}
+
+double average(uint64_t sum, const Result &result, double scale = 1.0) {
+	return result.iterations ? (double)sum / scale / result.iterations : 0.0;
+}
+
+void printCsv(const std::vector<Result> &results) {
+	printf("flow,iterations,failures,time_us,spi_transactions,spi_bytes,register_reads,register_writes,rf_frames,rf_us,host_us\n");
+	for (const Result &r : results) {
+		printf("%s,%u,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", r.flow->name, r.iterations, r.failures,
+				average(r.virtualNanos, r, 1000.0), average(r.spiTransactions, r), average(r.spiBytes, r),
+				average(r.registerReads, r), average(r.registerWrites, r), average(r.rfFrames, r),
+				average(r.rfNanos, r, 1000.0), average(r.hostNanos, r, 1000.0));
+	}
+}
+
+void printJson(const std::vector<Result> &results, uint32_t spiClock) {
+	printf("{\n  \"spi_clock\": %u,\n  \"flows\": [\n", spiClock);
+	for (size_t i = 0; i < results.size(); i++) {
+		const Result &r = results[i];
+		printf("    { \"flow\": \"%s\", \"iterations\": %u, \"failures\": %u, \"time_us\": %.1f, "
+				"\"spi_transactions\": %.1f, \"spi_bytes\": %.1f, \"register_reads\": %.1f, \"register_writes\": %.1f, "
+				"\"rf_frames\": %.1f, \"rf_us\": %.1f, \"host_us\": %.1f }%s\n", r.flow->name, r.iterations, r.failures,
+				average(r.virtualNanos, r, 1000.0), average(r.spiTransactions, r), average(r.spiBytes, r),
+				average(r.registerReads, r), average(r.registerWrites, r), average(r.rfFrames, r),
+				average(r.rfNanos, r, 1000.0), average(r.hostNanos, r, 1000.0), i + 1 < results.size() ? "," : "");
+	}
+	printf("  ]\n}\n");
+}
+
+void usage(const char *name) {
+	fprintf(stderr, "usage: %s [--iterations N] [--flow NAME]... [--format csv|json] [--spi-clock HZ]\nflows:", name);
+	for (const Flow &flow : flows) {
+		fprintf(stderr, " %s", flow.name);
+	}
+	fprintf(stderr, "\n");
+	exit(2);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	uint32_t iterations = 20;
+	uint32_t spiClock = MFRC522_SPICLOCK;
+	bool json = false;
+	std::vector<std::string> selected;
+
+	for (int i = 1; i < argc; i++) {
+		const char *option = argv[i];
+		const char *value = i + 1 < argc ? argv[++i] : nullptr;
+		if (!value) {
+			usage(argv[0]);
+		}
+		if (!strcmp(option, "--iterations")) {
+			iterations = (uint32_t)strtoul(value, nullptr, 0);
+		}
+		else if (!strcmp(option, "--flow")) {
+			selected.push_back(value);
+		}
+		else if (!strcmp(option, "--format") && (!strcmp(value, "csv") || !strcmp(value, "json"))) {
+			json = !strcmp(value, "json");
+		}
+		else if (!strcmp(option, "--spi-clock")) {
+			spiClock = (uint32_t)strtoul(value, nullptr, 0);
+		}
+		else {
+			usage(argv[0]);
+		}
+	}
+	for (const std::string &name : selected) {
+		bool known = false;
+		for (const Flow &flow : flows) {
+			known |= name == flow.name;
+		}
+		if (!known) {
+			usage(argv[0]);
+		}
+	}
+
+	SimArduino::begin();
+	chip.reset(new MFRC522Sim(10, 9));
+	SPISettings settings(spiClock, MSBFIRST, SPI_MODE0);
+	reader.reset(new MFRC522(10, 9, SPI, settings));
+	readerExtended.reset(new MFRC522Extended(MFRC522Transport(10, SPI, settings), 9));
+	for (byte i = 0; i < 6; i++) {
+		defaultKey.keyByte[i] = 0xFF;
+	}
+	SPI.begin();
+	readerExtended->PCD_Init();
+	reader->PCD_Init();
+
+	std::vector<Result> results;
+	for (const Flow &flow : flows) {
+		bool run = selected.empty();
+		for (const std::string &name : selected) {
+			run |= name == flow.name;
+		}
+		if (run) {
+			results.push_back(runFlow(flow, iterations));
+		}
+	}
+
+	if (json) {
+		printJson(results, spiClock);
+	}
+	else {
+		printCsv(results);
+	}
+	for (const Result &r : results) {
+		if (r.failures) {
+			fprintf(stderr, "%s: %u of %u iterations failed\n", r.flow->name, r.failures, r.iterations);
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,189 @@
+/**
+ * Host side model of MFRC522 readers spread over several SPI buses.
+ *
+ * Shows how the aggregate UID read rate scales with the number of SPI buses, see the
+ * ReadUidMultiBus example. Build and run on the PC:
+ *
+ *   g++ -std=c++11 -O2 -o bus_sim bus_sim.cpp && ./bus_sim [readersPerBus] [cores] [spiClockHz]
+ *
+ * Model, in steps of 1µs:
+ * - Every reader runs the frames of PICC_IsNewCardPresent(), PICC_ReadCardSerial() and PICC_HaltA().
+ *   A frame is a number of register accesses to set it up, the time on air, and register accesses
+ *   to read the result. Counts and times are taken from the register trace of the simulated MFRC522,
+ *   trace_record with ops init select halt decoded by trace_decode, every FIFO byte is one access.
+ *   The polls of ComIrqReg are part of the time on air. Setup and read accesses of the first three
+ *   frames plus their 27 polls are the 107 register reads and writes of select_uid4 in benchmark
+ *   --iterations 1.
+ * - A register access holds its bus and a CPU core for 16 SPI clocks plus a fixed overhead for
+ *   beginTransaction() and chip select.
+ * - While a frame is on air the library polls ComIrqReg, so the bus and a core stay busy ("polling").
+ *   With "yielding" the reader sleeps instead (IRQ pin or an RTOS delay) and leaves both free.
+ * - Each bus is served by its own task, the tasks share the given number of cores.
+ *
+ * Released into the public domain.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace {
+
+struct Frame {
+	uint16_t setupAccesses;		// Register accesses before StartSend
+	uint32_t airMicros;			// Time from StartSend until the IRQ
+	uint16_t readAccesses;		// Register accesses to fetch and check the answer
+};
+
+// One UID read of a 4 byte UID card, the HLTA waits for the 25ms timeout as no answer is expected
+const Frame uidRead[] = {
+	{ 12, 365, 5 },		// REQA/ATQA, incl. the baud rate and ModWidthReg writes of PICC_IsNewCardPresent()
+	{ 9, 724, 8 },		// Anticollision CL1
+	{ 31, 1148, 15 },	// SELECT CL1, incl. the CRC_A calculations by the MFRC522 for the frame and the SAK
+	{ 10, 25390, 0 },	// HLTA, until TimerIRq
+};
+const size_t uidReadFrames = sizeof(uidRead) / sizeof(uidRead[0]);
+
+struct Reader {
+	size_t bus;
+	size_t frame;
+	uint8_t phase;				// 0: setup, 1: on air, 2: read back
+	uint32_t remaining;			// Accesses left in phase 0/2, µs left in phase 1
+	uint32_t accessLeft;		// µs left of the current register access
+	uint32_t reads;
+};
+
+// The reader is done with its frame and sets up the next one
+void nextFrame(Reader &reader) {
+	reader.frame++;
+	if (reader.frame == uidReadFrames) {
+		reader.frame = 0;
+		reader.reads++;
+	}
+	reader.phase = 0;
+	reader.remaining = uidRead[reader.frame].setupAccesses;
+}
+
+struct Result {
+	double readsPerSecond;
+	double busUtilisation;
+};
+
+Result simulate(size_t buses, size_t readersPerBus, size_t cores, uint32_t spiClockHz, bool yielding, uint32_t durationMicros) {
+	const uint32_t accessMicros = 2 + (16u * 1000000u + spiClockHz - 1) / spiClockHz;
+	std::vector<Reader> readers;
+	for (size_t bus = 0; bus < buses; bus++) {
+		for (size_t index = 0; index < readersPerBus; index++) {
+			Reader reader = { bus, 0, 0, uidRead[0].setupAccesses, 0, 0 };
+			readers.push_back(reader);
+		}
+	}
+	std::vector<long> busOwner(buses, -1);	// Reader holding the bus during a register access
+	std::vector<size_t> busNext(buses, 0);	// Round robin of the bus task over its readers
+	uint64_t busBusy = 0;
+
+	for (uint32_t now = 0; now < durationMicros; now++) {
+		size_t freeCores = cores;
+		// Frames on air advance without a core when yielding
+		for (size_t index = 0; index < readers.size(); index++) {
+			Reader &reader = readers[index];
+			if (reader.phase == 1 && yielding && reader.remaining > 0) {
+				reader.remaining--;
+			}
+		}
+		for (size_t bus = 0; bus < buses && freeCores > 0; bus++) {
+			// The bus task runs the reader that owns the bus, or picks the next one that wants it
+			long selected = busOwner[bus];
+			for (size_t tries = 0; selected < 0 && tries < readersPerBus; tries++) {
+				size_t index = bus * readersPerBus + (busNext[bus] + tries) % readersPerBus;
+				Reader &reader = readers[index];
+				bool wantsBus = reader.phase != 1 || !yielding || reader.remaining == 0;
+				if (wantsBus) {
+					selected = (long)index;
+					busNext[bus] = (busNext[bus] + tries + 1) % readersPerBus;
+				}
+			}
+			if (selected < 0) {
+				continue;
+			}
+			freeCores--;
+			busBusy++;
+			Reader &reader = readers[(size_t)selected];
+			if (reader.phase == 1) {
+				// Poll ComIrqReg until the frame is done
+				if (reader.accessLeft == 0) {
+					reader.accessLeft = accessMicros;
+				}
+				reader.accessLeft--;
+				if (!yielding && reader.remaining > 0) {
+					reader.remaining--;
+				}
+				busOwner[bus] = reader.accessLeft ? selected : -1;
+				if (reader.accessLeft == 0 && reader.remaining == 0) {
+					reader.phase = 2;
+					reader.remaining = uidRead[reader.frame].readAccesses;
+					if (reader.remaining == 0) {
+						nextFrame(reader);
+					}
+				}
+				continue;
+			}
+			if (reader.accessLeft == 0) {
+				reader.accessLeft = accessMicros;
+			}
+			reader.accessLeft--;
+			busOwner[bus] = reader.accessLeft ? selected : -1;
+			if (reader.accessLeft > 0) {
+				continue;
+			}
+			if (--reader.remaining > 0) {
+				continue;
+			}
+			if (reader.phase == 0) {
+				reader.phase = 1;
+				reader.remaining = uidRead[reader.frame].airMicros;
+			}
+			else {
+				nextFrame(reader);
+			}
+		}
+	}
+
+	Result result;
+	uint32_t reads = 0;
+	for (size_t index = 0; index < readers.size(); index++) {
+		reads += readers[index].reads;
+	}
+	result.readsPerSecond = reads * 1e6 / durationMicros;
+	result.busUtilisation = (double)busBusy / ((double)durationMicros * buses);
+	return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	size_t readersPerBus = argc > 1 ? (size_t)atoi(argv[1]) : 2;
+	size_t cores = argc > 2 ? (size_t)atoi(argv[2]) : 2;
+	uint32_t spiClockHz = argc > 3 ? (uint32_t)atol(argv[3]) : 4000000u;
+	const uint32_t duration = 2000000;		// 2s simulated
+
+	if (readersPerBus < 1 || cores < 1 || spiClockHz < 1000) {
+		fprintf(stderr, "usage: %s [readersPerBus >= 1] [cores >= 1] [spiClockHz >= 1000]\n", argv[0]);
+		return 1;
+	}
+	printf("%u readers per bus, %u cores, SPI %u Hz\n", (unsigned)readersPerBus, (unsigned)cores, (unsigned)spiClockHz);
+	printf("%-6s %-8s %12s %8s %10s\n", "buses", "wait", "UID reads/s", "speedup", "bus busy");
+	const bool modes[] = { false, true };
+	for (size_t mode = 0; mode < 2; mode++) {
+		double base = 0;
+		for (size_t buses = 1; buses <= 4; buses++) {
+			Result result = simulate(buses, readersPerBus, cores, spiClockHz, modes[mode], duration);
+			if (buses == 1) {
+				base = result.readsPerSecond;
+			}
+			printf("%-6u %-8s %12.1f %7.2fx %9.1f%%\n", (unsigned)buses, modes[mode] ? "yielding" : "polling",
+				result.readsPerSecond, base > 0 ? result.readsPerSecond / base : 0.0, result.busUtilisation * 100);
+		}
+	}
+	return 0;
+}
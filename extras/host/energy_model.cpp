@@ -0,0 +1,100 @@
+/**
+ * Host side energy model of the duty-cycled card detection, see PCD_LowPowerBegin().
+ *
+ * Computes the average current, the energy per detected card and the detection latency for a range of
+ * periods, for soft power-down and for antenna-off sleeping. Build and run on the PC:
+ *
+ *   g++ -std=c++11 -O2 -o energy_model energy_model.cpp && ./energy_model [cardsPerHour] [wakeBudgetMicros]
+ *
+ * The check follows PCD_LowPowerCheck(): oscillator start-up (soft power-down only), field on for the
+ * wake budget and one REQA. A detected card adds a session of the given length with the field on.
+ * The currents are typical values for MFRC522 modules at 3.3V and differ a lot with the antenna
+ * matching; measure your board and change the table below.
+ *
+ * Released into the public domain.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+
+struct CurrentModel {
+	double softPowerDown;		// mA, soft power-down, oscillator off
+	double idleAntennaOff;		// mA, powered, antenna off
+	double oscillatorStart;		// mA, while the crystal starts after soft power-down
+	double fieldOn;				// mA, antenna on (transmitter current dominates)
+	double mcuActive;			// mA, MCU running the check
+	double mcuSleep;			// mA, MCU sleeping between checks
+};
+
+const CurrentModel model = {
+	0.010,		// softPowerDown
+	7.0,		// idleAntennaOff
+	7.0,		// oscillatorStart
+	60.0,		// fieldOn
+	5.0,		// mcuActive
+	0.005,		// mcuSleep
+};
+
+const double supplyVolts = 3.3;
+const double oscillatorStartMicros = 1500;	// Crystal start-up, see PCD_GetTimeToReady() on your board
+const double spiOverheadMicros = 150;		// Register accesses of one check
+const double cardSessionMicros = 50000;		// Reading a detected card, e.g. UID and one block
+
+struct Result {
+	double averageMilliamps;
+	double millijoulePerDetection;
+	double averageLatencyMillis;
+	double dutyCycle;
+};
+
+Result evaluate(double periodMillis, double wakeBudgetMicros, bool antennaOffOnly, double cardsPerHour) {
+	const double periodMicros = periodMillis * 1000.0;
+	// One check without a card
+	double wakeMicros = wakeBudgetMicros + spiOverheadMicros;
+	double chargeCheck = wakeBudgetMicros * (model.fieldOn + model.mcuActive) + spiOverheadMicros * (model.idleAntennaOff + model.mcuActive);	// mA*µs
+	if (!antennaOffOnly) {
+		wakeMicros += oscillatorStartMicros;
+		chargeCheck += oscillatorStartMicros * (model.oscillatorStart + model.mcuActive);
+	}
+	double sleepMicros = periodMicros > wakeMicros ? periodMicros - wakeMicros : 0;
+	double sleepCurrent = (antennaOffOnly ? model.idleAntennaOff : model.softPowerDown) + model.mcuSleep;
+	double chargePeriod = chargeCheck + sleepMicros * sleepCurrent;
+
+	// Detected cards per period and the extra charge to read them
+	double cardsPerPeriod = cardsPerHour * periodMicros / 3.6e9;
+	double chargeCard = cardSessionMicros * (model.fieldOn + model.mcuActive);
+
+	Result result;
+	result.averageMilliamps = (chargePeriod + cardsPerPeriod * chargeCard) / periodMicros;
+	double joulePerHour = result.averageMilliamps / 1000.0 * supplyVolts * 3600.0;
+	result.millijoulePerDetection = cardsPerHour > 0 ? joulePerHour / cardsPerHour * 1000.0 : 0;
+	// A card arrives at a random time, so it waits half a period on average before the next check
+	result.averageLatencyMillis = periodMillis / 2.0 + wakeMicros / 1000.0;
+	result.dutyCycle = wakeMicros / periodMicros;
+	return result;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	double cardsPerHour = argc > 1 ? atof(argv[1]) : 20;
+	double wakeBudgetMicros = argc > 2 ? atof(argv[2]) : 5000;
+	const double periods[] = { 50, 100, 250, 500, 1000, 2000 };
+
+	if (cardsPerHour < 0 || wakeBudgetMicros < 300) {
+		fprintf(stderr, "usage: %s [cardsPerHour >= 0] [wakeBudgetMicros >= 300]\n", argv[0]);
+		return 1;
+	}
+	printf("%.0f cards per hour, wake budget %.0fus, %.1fV\n", cardsPerHour, wakeBudgetMicros, supplyVolts);
+	printf("%-12s %8s %10s %12s %14s %12s\n", "sleep", "period", "duty", "avg current", "per detection", "latency");
+	for (int mode = 0; mode < 2; mode++) {
+		for (size_t i = 0; i < sizeof(periods) / sizeof(periods[0]); i++) {
+			Result result = evaluate(periods[i], wakeBudgetMicros, mode == 1, cardsPerHour);
+			printf("%-12s %6.0fms %9.3f%% %10.3fmA %12.1fmJ %10.1fms\n", mode ? "antenna off" : "power-down",
+				periods[i], result.dutyCycle * 100, result.averageMilliamps, result.millijoulePerDetection, result.averageLatencyMillis);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,310 @@
+/**
+ * Records register traces against the simulated MFRC522 and replays traces, e.g. from a reader in the field,
+ * with MFRC522TransportReplay. See extras/host/README.rst.
+ *
+ *   ./trace_record [--picc TYPE[:UID]] OUT OP...
+ *   ./replay [--tolerant] TRACE OP...
+ *
+ * OP is one of init, select, reselect, halt, auth:A|B:BLOCK[:KEY], stop, read:BLOCK, write:BLOCK:DATA, activate,
+ * apdu:DATA and deselect, KEY and DATA in hex. All operations run on reader 0 (SS 10, RST 9). The same
+ * source is built twice: against the simulator with MFRC522_TRACE and MFRC522_TRACE_PAYLOAD for trace_record,
+ * with MFRC522_TRANSPORT_REPLAY for replay. Run the operations the trace was recorded with, replay reports
+ * the first access that differs from the trace and how many accesses matched, were skipped or are new.
+ *
+ * Released into the public domain.
+ */
+#include <Arduino.h>
+#include <SPI.h>
+#include <MFRC522.h>
+#include <MFRC522Extended.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MFRC522Sim.h"
+#include "SimArduino.h"
+
+#if MFRC522_TRANSPORT != MFRC522_TRANSPORT_REPLAY && !(MFRC522_TRACE && MFRC522_TRACE_PAYLOAD)
+#error "Build with MFRC522_TRANSPORT_REPLAY to replay, or with MFRC522_TRACE and MFRC522_TRACE_PAYLOAD to record"
+#endif
+
+namespace {
+
+constexpr bool REPLAY = MFRC522_TRANSPORT == MFRC522_TRANSPORT_REPLAY;
+
+std::unique_ptr<MFRC522Extended> reader;
+MFRC522Extended::TagInfo tag;
+
+bool parseHex(const std::string &text, std::vector<byte> &bytes) {
+	if (text.size() % 2 != 0) {
+		return false;
+	}
+	bytes.clear();
+	for (size_t i = 0; i < text.size(); i += 2) {
+		char *end;
+		std::string pair = text.substr(i, 2);
+		bytes.push_back((byte)strtoul(pair.c_str(), &end, 16));
+		if (*end) {
+			return false;
+		}
+	}
+	return true;
+}
+
+std::vector<std::string> split(const std::string &text) {
+	std::vector<std::string> fields;
+	size_t start = 0;
+	size_t colon;
+	while ((colon = text.find(':', start)) != std::string::npos) {
+		fields.push_back(text.substr(start, colon - start));
+		start = colon + 1;
+	}
+	fields.push_back(text.substr(start));
+	return fields;
+}
+
+void printHex(const byte *bytes, size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		printf("%02X", bytes[i]);
+	}
+}
+
+// Runs one operation and prints its result. Returns false if the operation is not known.
+bool runOperation(const std::string &op) {
+	std::vector<std::string> args = split(op);
+	const std::string &name = args[0];
+	std::vector<byte> data;
+	byte buffer[64];
+	byte size = sizeof(buffer);
+	MFRC522::StatusCode status = MFRC522::STATUS_OK;
+	bool dump = false;
+
+	if (name == "init" && args.size() == 1) {
+		reader->PCD_Init();
+	}
+	else if (name == "select" && args.size() == 1) {
+		size = 2;
+		status = reader->PICC_WakeupA(buffer, &size);
+		if (status == MFRC522::STATUS_OK) {
+			status = reader->PICC_Select(&reader->uid);
+		}
+		memcpy(buffer, reader->uid.uidByte, reader->uid.size);
+		size = reader->uid.size;
+		dump = status == MFRC522::STATUS_OK;
+	}
+	else if (name == "reselect" && args.size() == 1) {
+		status = reader->PICC_Reselect(reader->uid);
+	}
+	else if (name == "halt" && args.size() == 1) {
+		status = reader->PICC_HaltA();
+	}
+	else if (name == "auth" && (args.size() == 3 || args.size() == 4) && (args[1] == "A" || args[1] == "B")) {
+		MFRC522::MIFARE_Key key;
+		memset(key.keyByte, 0xFF, sizeof(key.keyByte));
+		if (args.size() == 4) {
+			if (!parseHex(args[3], data) || data.size() != sizeof(key.keyByte)) {
+				return false;
+			}
+			memcpy(key.keyByte, data.data(), data.size());
+		}
+		byte command = args[1] == "A" ? MFRC522::PICC_CMD_MF_AUTH_KEY_A : MFRC522::PICC_CMD_MF_AUTH_KEY_B;
+		status = reader->PCD_Authenticate(command, (byte)strtoul(args[2].c_str(), nullptr, 0), &key, &reader->uid);
+	}
+	else if (name == "stop" && args.size() == 1) {
+		reader->PCD_StopCrypto1();
+	}
+	else if (name == "read" && args.size() == 2) {
+		size = 18;
+		status = reader->MIFARE_Read((byte)strtoul(args[1].c_str(), nullptr, 0), buffer, &size);
+		size = 16;
+		dump = status == MFRC522::STATUS_OK;
+	}
+	else if (name == "write" && args.size() == 3) {
+		if (!parseHex(args[2], data) || data.size() != 16) {
+			return false;
+		}
+		status = reader->MIFARE_Write((byte)strtoul(args[1].c_str(), nullptr, 0), data.data(), (byte)data.size());
+	}
+	else if (name == "activate" && args.size() == 1) {
+		status = reader->PICC_Activate(&tag);
+	}
+	else if (name == "apdu" && args.size() == 2) {
+		if (!parseHex(args[1], data) || data.empty() || data.size() > 255) {
+			return false;
+		}
+		status = reader->TCL_Transceive(&tag, data.data(), (byte)data.size(), buffer, &size);
+		dump = status == MFRC522::STATUS_OK;
+	}
+	else if (name == "deselect" && args.size() == 1) {
+		status = reader->TCL_Deselect(&tag);
+	}
+	else {
+		return false;
+	}
+
+	printf("%-24s %s", op.c_str(), reinterpret_cast<const char *>(MFRC522::GetStatusCodeName(status)));
+	if (dump) {
+		printf(" ");
+		printHex(buffer, size);
+	}
+	printf("\n");
+	return true;
+}
+
+void usage(const char *name) {
+	if (REPLAY) {
+		fprintf(stderr, "usage: %s [--tolerant] TRACE OP...\n", name);
+	}
+	else {
+		fprintf(stderr, "usage: %s [--picc TYPE[:UID]] OUT OP...\n", name);
+	}
+	fprintf(stderr, "OP: init select reselect halt auth:A|B:BLOCK[:KEY] stop read:BLOCK write:BLOCK:DATA activate apdu:DATA deselect\n");
+	exit(2);
+}
+
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_REPLAY
+// An address byte and value of the trace, see MFRC522::TraceRecord
+void printAccess(byte address, byte value) {
+	printf("%s register 0x%02X ", address & 0x80 ? "read" : "write", (address >> 1) & 0x3F);
+	if (address & 0x01) {
+		printf("%u bytes", value);
+	}
+	else {
+		printf("0x%02X", value);
+	}
+}
+
+// Prints the counts of the replay, returns false if the operations did not follow the trace
+bool report(const MFRC522TransportReplay &transport, bool tolerant) {
+	const MFRC522TransportReplay::Counts &counts = transport.counts();
+	printf("accesses %u (%u bytes), trace %u, matched %u, skipped %u, extra %u, missing payload %u\n",
+			counts.frames, counts.bytes, counts.traceFrames, counts.matched, counts.skipped, counts.extra, counts.missingPayload);
+	if (transport.diverged()) {
+		const MFRC522TransportReplay::Divergence &d = transport.divergence();
+		printf("first divergence at record %u: ", d.record);
+		printAccess(d.address, d.value);
+		printf(", trace ");
+		if (d.expectedAddress) {
+			printAccess(d.expectedAddress, d.expectedValue);
+			printf(d.address == d.expectedAddress && d.value == d.expectedValue ? ", other bytes\n" : "\n");
+		}
+		else {
+			printf("ended\n");
+		}
+	}
+	if (!transport.finished()) {
+		printf("trace not replayed to the end, stopped at record %u\n", transport.position());
+	}
+	return tolerant || (!transport.diverged() && transport.finished());
+}
+#else
+class FilePrint : public Print {
+public:
+	explicit FilePrint(FILE *file) : _file(file) {}
+	size_t write(uint8_t value) override { return fputc(value, _file) == EOF ? 0 : 1; }
+	size_t write(const uint8_t *buffer, size_t size) override { return fwrite(buffer, 1, size, _file); }
+
+private:
+	FILE *_file;
+};
+#endif
+
+} // namespace
+
+int main(int argc, char **argv) {
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_REPLAY
+	bool tolerant = false;
+#else
+	const char *piccSpec = "classic1k";
+#endif
+	int i = 1;
+	for (; i < argc && argv[i][0] == '-'; i++) {
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_REPLAY
+		if (!strcmp(argv[i], "--tolerant")) {
+			tolerant = true;
+			continue;
+		}
+#else
+		if (!strcmp(argv[i], "--picc") && i + 1 < argc) {
+			piccSpec = argv[++i];
+			continue;
+		}
+#endif
+		usage(argv[0]);
+	}
+	if (i + 1 >= argc) {
+		usage(argv[0]);
+	}
+	const char *path = argv[i++];
+	SimArduino::begin();
+
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_REPLAY
+	FILE *file = fopen(path, "rb");
+	if (!file) {
+		perror(path);
+		return 2;
+	}
+	std::vector<byte> trace;
+	byte chunk[4096];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+		trace.insert(trace.end(), chunk, chunk + read);
+	}
+	fclose(file);
+	MFRC522TransportReplay transport;
+	if (!transport.load(trace.data(), trace.size(), tolerant ? MFRC522TransportReplay::Tolerant : MFRC522TransportReplay::Strict)) {
+		fprintf(stderr, "%s: not a trace of PCD_DumpTrace()\n", path);
+		return 2;
+	}
+	// Without a simulated MFRC522 the reset pin reads LOW, so PCD_Init() would do a hard reset. Leave the pin out
+	// if the reader the trace comes from did a soft reset: the trace starts with the write of SoftReset to CommandReg.
+	bool softReset = trace.size() >= 16 && trace[12] == MFRC522::CommandReg && trace[13] == MFRC522::PCD_SoftReset;
+	reader.reset(new MFRC522Extended(transport, softReset ? MFRC522::UNUSED_PIN : 9));
+#else
+	std::string type(piccSpec);
+	std::vector<byte> uid;
+	size_t colon = type.find(':');
+	if (colon != std::string::npos && !parseHex(type.substr(colon + 1), uid)) {
+		usage(argv[0]);
+	}
+	std::unique_ptr<SimPicc> picc(SimPicc::create(type.substr(0, colon).c_str(), uid.data(), (uint8_t)uid.size()));
+	if (!picc) {
+		fprintf(stderr, "unknown PICC type or UID size: %s\n", piccSpec);
+		return 2;
+	}
+	MFRC522Sim chip(10, 9);
+	chip.addPicc(picc.get());
+	SPI.begin();
+	reader.reset(new MFRC522Extended(10, 9));
+#endif
+
+	for (; i < argc; i++) {
+		if (!runOperation(argv[i])) {
+			fprintf(stderr, "unknown operation: %s\n", argv[i]);
+			usage(argv[0]);
+		}
+	}
+
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_REPLAY
+	return report(reader->PCD_GetTransport(), tolerant) ? 0 : 1;
+#else
+	FILE *out = fopen(path, "wb");
+	if (!out) {
+		perror(path);
+		return 2;
+	}
+	FilePrint print(out);
+	size_t written = reader->PCD_DumpTrace(print);
+	fclose(out);
+	size_t records = (written - 8) / 8;
+	printf("%u records written to %s\n", (unsigned)records, path);
+	// Up to 7 continuation records are dropped when the oldest access is overwritten
+	if (records + 7 >= MFRC522_TRACE) {
+		fprintf(stderr, "the trace buffer may have overflowed, the oldest accesses may be missing\n");
+		return 1;
+	}
+	return 0;
+#endif
+}
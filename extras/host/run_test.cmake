@@ -0,0 +1,19 @@
+# Runs a host program for CTest, see CMakeLists.txt. Fails if it exits with another code than 0, or if
+# its output does not match PATTERN.
+#
+#   cmake -DPROGRAM=path "-DARGS=arg;arg" [-DPATTERN=regex] -P run_test.cmake
+#
+# Released into the public domain.
+execute_process(
+	COMMAND ${PROGRAM} ${ARGS}
+	RESULT_VARIABLE result
+	OUTPUT_VARIABLE output
+	ERROR_VARIABLE errors
+)
+message("${output}${errors}")
+if(NOT result EQUAL 0)
+	message(FATAL_ERROR "${PROGRAM} exited with ${result}")
+endif()
+if(DEFINED PATTERN AND NOT output MATCHES "${PATTERN}")
+	message(FATAL_ERROR "The output of ${PROGRAM} does not match \"${PATTERN}\"")
+endif()
@@ -0,0 +1,328 @@
+/**
+ * Minimal Arduino core for host builds of the library, see Arduino.h.
+ *
+ * Released into the public domain.
+ */
+#include <Arduino.h>
+#include <stdio.h>
+#include <string>
+#include "SimArduino.h"
+#include "SimClock.h"
+#include "MFRC522Sim.h"
+
+HardwareSerial Serial;
+
+namespace {
+
+struct Interrupt {
+	void (*handler)();
+	int mode;
+	uint8_t level;
+};
+
+uint8_t pinModes[NUM_DIGITAL_PINS];
+uint8_t pinLatches[NUM_DIGITAL_PINS];
+Interrupt pinInterrupts[NUM_DIGITAL_PINS];
+bool interruptsEnabled = true;
+bool inInterrupt = false;
+std::string serialInput;
+size_t serialOffset = 0;
+uint32_t randomState = 1;
+
+// Level on a pin the sketch does not drive: a simulated MFRC522 output, a pull-up or LOW
+uint8_t inputLevel(uint8_t pin) {
+	uint8_t level;
+	if (MFRC522Sim::inputLevel(pin, &level)) {
+		return level;
+	}
+	return pinModes[pin] == INPUT_PULLUP ? HIGH : LOW;
+}
+
+uint8_t pinLevel(uint8_t pin) {
+	return pinModes[pin] == OUTPUT ? pinLatches[pin] : inputLevel(pin);
+}
+
+} // namespace
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Shim control
+/////////////////////////////////////////////////////////////////////////////////////
+
+void SimArduino::begin() {
+	SimClock::setHook(checkInterrupts);
+	for (uint8_t pin = 0; pin < NUM_DIGITAL_PINS; pin++) {
+		pinModes[pin] = INPUT;
+		pinLatches[pin] = LOW;
+		pinInterrupts[pin].handler = nullptr;
+	}
+}
+
+void SimArduino::setSerialInput(const char *input) {
+	serialInput = input ? input : "";
+	serialOffset = 0;
+}
+
+/**
+ * Calls the handlers of pins whose level changed like the configured edge. Handlers run one at a time,
+ * time passing inside a handler does not call another one.
+ */
+void SimArduino::checkInterrupts() {
+	if (!interruptsEnabled || inInterrupt) {
+		return;
+	}
+	inInterrupt = true;
+	for (uint8_t pin = 0; pin < NUM_DIGITAL_PINS; pin++) {
+		Interrupt &interrupt = pinInterrupts[pin];
+		if (!interrupt.handler) {
+			continue;
+		}
+		uint8_t level = pinLevel(pin);
+		if (level == interrupt.level) {
+			continue;
+		}
+		interrupt.level = level;
+		if (interrupt.mode == CHANGE || (interrupt.mode == FALLING && level == LOW) || (interrupt.mode == RISING && level == HIGH)) {
+			interrupt.handler();
+		}
+	}
+	inInterrupt = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Time
+/////////////////////////////////////////////////////////////////////////////////////
+
+unsigned long millis() {
+	return (unsigned long)(SimClock::now() / 1000000);
+}
+
+unsigned long micros() {
+	return (unsigned long)(SimClock::now() / 1000);
+}
+
+void delay(unsigned long ms) {
+	SimClock::advance((uint64_t)ms * 1000000);
+}
+
+void delayMicroseconds(unsigned int us) {
+	SimClock::advance((uint64_t)us * 1000);
+}
+
+/**
+ * Busy loops call yield(), e.g. while the library polls ComIrqReg. Let time pass up to the next event of the
+ * simulated chips, at most 100µs and at least 1µs, so such loops end.
+ */
+void yield() {
+	uint64_t now = SimClock::now();
+	uint64_t next = MFRC522Sim::nextEventAll();
+	uint64_t step = next > now ? next - now : 0;
+	if (step > 100000) {
+		step = 100000;
+	}
+	if (step < 1000) {
+		step = 1000;
+	}
+	SimClock::advance(step);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Pins and interrupts
+/////////////////////////////////////////////////////////////////////////////////////
+
+void pinMode(uint8_t pin, uint8_t mode) {
+	if (pin >= NUM_DIGITAL_PINS) {
+		return;
+	}
+	uint8_t before = pinLevel(pin);
+	pinModes[pin] = mode;
+	uint8_t after = pinLevel(pin);
+	if (mode == OUTPUT || before != after) {
+		MFRC522Sim::pinWritten(pin, after);
+	}
+	SimArduino::checkInterrupts();
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+	if (pin >= NUM_DIGITAL_PINS) {
+		return;
+	}
+	if (pinModes[pin] != OUTPUT) {
+		pinModes[pin] = value ? INPUT_PULLUP : INPUT;		// As on AVR: HIGH on an input enables the pull-up
+		return;
+	}
+	pinLatches[pin] = value ? HIGH : LOW;
+	MFRC522Sim::pinWritten(pin, pinLatches[pin]);
+	SimArduino::checkInterrupts();
+}
+
+int digitalRead(uint8_t pin) {
+	if (pin >= NUM_DIGITAL_PINS) {
+		return LOW;
+	}
+	return pinLevel(pin);
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode) {
+	if (interrupt >= NUM_DIGITAL_PINS) {
+		return;
+	}
+	pinInterrupts[interrupt].handler = handler;
+	pinInterrupts[interrupt].mode = mode;
+	pinInterrupts[interrupt].level = pinLevel(interrupt);
+}
+
+void detachInterrupt(uint8_t interrupt) {
+	if (interrupt < NUM_DIGITAL_PINS) {
+		pinInterrupts[interrupt].handler = nullptr;
+	}
+}
+
+void interrupts() {
+	interruptsEnabled = true;
+	SimArduino::checkInterrupts();
+}
+
+void noInterrupts() {
+	interruptsEnabled = false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Random numbers, deterministic so runs can be compared
+/////////////////////////////////////////////////////////////////////////////////////
+
+void randomSeed(unsigned long seed) {
+	randomState = seed ? seed : 1;
+}
+
+long random(long howBig) {
+	if (howBig <= 0) {
+		return 0;
+	}
+	randomState = randomState * 1103515245u + 12345u;
+	return (long)((randomState >> 1) % (unsigned long)howBig);
+}
+
+long random(long howSmall, long howBig) {
+	if (howSmall >= howBig) {
+		return howSmall;
+	}
+	return howSmall + random(howBig - howSmall);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Print and Stream
+/////////////////////////////////////////////////////////////////////////////////////
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+	size_t n = 0;
+	while (size--) {
+		n += write(*buffer++);
+	}
+	return n;
+}
+
+size_t Print::printNumber(unsigned long n, int base) {
+	char buffer[8 * sizeof(long) + 1];
+	char *str = &buffer[sizeof(buffer) - 1];
+	*str = '\0';
+	if (base < 2) {
+		base = 10;
+	}
+	do {
+		char digit = n % base;
+		n /= base;
+		*--str = digit < 10 ? digit + '0' : digit + 'A' - 10;
+	} while (n);
+	return write(str);
+}
+
+size_t Print::printSigned(long n, int base) {
+	if (base == DEC && n < 0) {
+		return write((uint8_t)'-') + printNumber(-(unsigned long)n, DEC);
+	}
+	if (base != DEC) {
+		return printNumber((unsigned long)n, base);
+	}
+	return printNumber(n, base);
+}
+
+size_t Print::print(double n, int digits) {
+	char buffer[64];
+	snprintf(buffer, sizeof(buffer), "%.*f", digits, n);
+	return write(buffer);
+}
+
+int Stream::timedRead() {
+	unsigned long start = millis();
+	do {
+		int c = read();
+		if (c >= 0) {
+			return c;
+		}
+		yield();
+	} while (millis() - start < _timeout);
+	return -1;
+}
+
+size_t Stream::readBytes(char *buffer, size_t length) {
+	size_t count = 0;
+	while (count < length) {
+		int c = timedRead();
+		if (c < 0) {
+			break;
+		}
+		*buffer++ = (char)c;
+		count++;
+	}
+	return count;
+}
+
+size_t Stream::readBytesUntil(char terminator, char *buffer, size_t length) {
+	size_t count = 0;
+	while (count < length) {
+		int c = timedRead();
+		if (c < 0 || c == terminator) {
+			break;
+		}
+		*buffer++ = (char)c;
+		count++;
+	}
+	return count;
+}
+
+int HardwareSerial::available() {
+	return (int)(serialInput.size() - serialOffset);
+}
+
+int HardwareSerial::read() {
+	if (serialOffset >= serialInput.size()) {
+		return -1;
+	}
+	return (uint8_t)serialInput[serialOffset++];
+}
+
+int HardwareSerial::peek() {
+	if (serialOffset >= serialInput.size()) {
+		return -1;
+	}
+	return (uint8_t)serialInput[serialOffset];
+}
+
+void HardwareSerial::flush() {
+	fflush(stdout);
+}
+
+size_t HardwareSerial::write(uint8_t c) {
+	if (c != '\r') {					// println() ends lines with "\r\n"
+		putchar(c);
+	}
+	return 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+	size_t n = 0;
+	for (size_t i = 0; i < size; i++) {
+		n += write(buffer[i]);
+	}
+	return n;
+}
@@ -0,0 +1,57 @@
+/**
+ * SPI for host builds of the library, see SPI.h.
+ *
+ * Released into the public domain.
+ */
+#include <SPI.h>
+#include "SimArduino.h"
+#include "SimClock.h"
+#include "MFRC522Sim.h"
+
+SPIClass SPI;
+
+namespace {
+	constexpr uint64_t TransactionNanos = 500;	// Overhead of beginTransaction() and endTransaction() on a 16 MHz AVR
+	uint32_t transactions = 0;
+	uint32_t bytes = 0;
+}
+
+uint32_t SimArduino::spiTransactions() {
+	return transactions;
+}
+
+uint32_t SimArduino::spiBytes() {
+	return bytes;
+}
+
+void SimArduino::resetCounters() {
+	transactions = 0;
+	bytes = 0;
+}
+
+void SPIClass::beginTransaction(const SPISettings &settings) {
+	_clock = settings.clock ? settings.clock : 4000000u;
+	_inTransaction = true;
+	transactions++;
+	SimClock::advance(TransactionNanos);
+}
+
+void SPIClass::endTransaction() {
+	_inTransaction = false;
+	SimClock::advance(TransactionNanos);
+}
+
+uint8_t SPIClass::transfer(uint8_t data) {
+	SimClock::advance(8000000000ull / _clock);
+	bytes++;
+	uint8_t result = MFRC522Sim::spiTransfer(data);
+	SimArduino::checkInterrupts();
+	return result;
+}
+
+void SPIClass::transfer(void *buffer, size_t count) {
+	uint8_t *data = static_cast<uint8_t *>(buffer);
+	for (size_t i = 0; i < count; i++) {
+		data[i] = transfer(data[i]);
+	}
+}
@@ -0,0 +1,47 @@
+/**
+ * SPI for host builds of the library. Transfers go to the simulated MFRC522 whose chip select pin is LOW
+ * and advance the virtual clock by the transfer time at the clock of the current transaction.
+ *
+ * Released into the public domain.
+ */
+#ifndef SPI_h
+#define SPI_h
+
+#include <Arduino.h>
+
+#define SPI_HAS_TRANSACTION 1
+#define MSBFIRST 1
+#define LSBFIRST 0
+#define SPI_MODE0 0x00
+#define SPI_MODE1 0x04
+#define SPI_MODE2 0x08
+#define SPI_MODE3 0x0C
+
+class SPISettings {
+public:
+	SPISettings() : clock(4000000u), bitOrder(MSBFIRST), dataMode(SPI_MODE0) {}
+	SPISettings(uint32_t clock, uint8_t bitOrder, uint8_t dataMode) : clock(clock), bitOrder(bitOrder), dataMode(dataMode) {}
+	uint32_t clock;
+	uint8_t bitOrder;
+	uint8_t dataMode;
+};
+
+class SPIClass {
+public:
+	SPIClass() : _clock(4000000u), _inTransaction(false) {}
+	void begin() {}
+	void end() {}
+	void beginTransaction(const SPISettings &settings);
+	void endTransaction();
+	uint8_t transfer(uint8_t data);
+	void transfer(void *buffer, size_t count);
+	bool inTransaction() const { return _inTransaction; }
+
+private:
+	uint32_t _clock;
+	bool _inTransaction;
+};
+
+extern SPIClass SPI;
+
+#endif
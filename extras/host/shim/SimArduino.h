@@ -0,0 +1,20 @@
+/**
+ * Control of the Arduino shim for the runner of host builds, see extras/host/README.rst.
+ *
+ * Released into the public domain.
+ */
+#ifndef SimArduino_h
+#define SimArduino_h
+
+#include <stdint.h>
+
+namespace SimArduino {
+	void begin();								// Connects the shim to the virtual clock
+	void setSerialInput(const char *input);		// Bytes the sketch reads from Serial
+	void checkInterrupts();						// Runs handlers of attachInterrupt() whose pin changed
+	uint32_t spiTransactions();					// beginTransaction() calls so far
+	uint32_t spiBytes();						// Bytes transferred by all SPI buses so far
+	void resetCounters();
+}
+
+#endif
@@ -0,0 +1,8 @@
+/**
+ * Wire for host builds of the library, see Wire.h.
+ *
+ * Released into the public domain.
+ */
+#include <Wire.h>
+
+TwoWire Wire;
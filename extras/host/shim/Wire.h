@@ -0,0 +1,30 @@
+/**
+ * Wire for host builds of the library. No device is connected: every address is not acknowledged
+ * and nothing is received, so the I2C transport compiles but does not reach the simulated MFRC522.
+ *
+ * Released into the public domain.
+ */
+#ifndef Wire_h
+#define Wire_h
+
+#include <Arduino.h>
+
+class TwoWire : public Stream {
+public:
+	void begin() {}
+	void end() {}
+	void setClock(uint32_t) {}
+	void beginTransmission(uint8_t) {}
+	uint8_t endTransmission(bool = true) { return 2; }		// NACK on transmit of address
+	uint8_t requestFrom(uint8_t, uint8_t, bool = true) { return 0; }
+	size_t write(uint8_t) override { return 1; }
+	size_t write(const uint8_t *, size_t size) override { return size; }
+	using Print::write;
+	int available() override { return 0; }
+	int read() override { return -1; }
+	int peek() override { return -1; }
+};
+
+extern TwoWire Wire;
+
+#endif
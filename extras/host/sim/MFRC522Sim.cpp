@@ -0,0 +1,853 @@
+/**
+ * Behavioural model of the MFRC522, see MFRC522Sim.h. Section and table numbers refer to the MFRC522 datasheet.
+ *
+ * Released into the public domain.
+ */
+#include "MFRC522Sim.h"
+#include "SimClock.h"
+#include <MFRC522.h>
+#include <algorithm>
+#include <string.h>
+
+std::vector<MFRC522Sim *> MFRC522Sim::_instances;
+
+namespace {
+
+// Register addresses as on the bus, the PCD_Register enums are shifted for the SPI address byte
+constexpr uint8_t Command		= MFRC522::CommandReg >> 1;
+constexpr uint8_t ComIEn		= MFRC522::ComIEnReg >> 1;
+constexpr uint8_t DivIEn		= MFRC522::DivIEnReg >> 1;
+constexpr uint8_t ComIrq		= MFRC522::ComIrqReg >> 1;
+constexpr uint8_t DivIrq		= MFRC522::DivIrqReg >> 1;
+constexpr uint8_t Error			= MFRC522::ErrorReg >> 1;
+constexpr uint8_t Status1		= MFRC522::Status1Reg >> 1;
+constexpr uint8_t Status2		= MFRC522::Status2Reg >> 1;
+constexpr uint8_t FIFOData		= MFRC522::FIFODataReg >> 1;
+constexpr uint8_t FIFOLevel		= MFRC522::FIFOLevelReg >> 1;
+constexpr uint8_t WaterLevel	= MFRC522::WaterLevelReg >> 1;
+constexpr uint8_t Control		= MFRC522::ControlReg >> 1;
+constexpr uint8_t BitFraming	= MFRC522::BitFramingReg >> 1;
+constexpr uint8_t Coll			= MFRC522::CollReg >> 1;
+constexpr uint8_t Mode			= MFRC522::ModeReg >> 1;
+constexpr uint8_t TxMode		= MFRC522::TxModeReg >> 1;
+constexpr uint8_t RxMode		= MFRC522::RxModeReg >> 1;
+constexpr uint8_t TxControl		= MFRC522::TxControlReg >> 1;
+constexpr uint8_t TxSel			= MFRC522::TxSelReg >> 1;
+constexpr uint8_t RxSel			= MFRC522::RxSelReg >> 1;
+constexpr uint8_t RxThreshold	= MFRC522::RxThresholdReg >> 1;
+constexpr uint8_t Demod			= MFRC522::DemodReg >> 1;
+constexpr uint8_t MfTx			= MFRC522::MfTxReg >> 1;
+constexpr uint8_t SerialSpeed	= MFRC522::SerialSpeedReg >> 1;
+constexpr uint8_t CRCResultH	= MFRC522::CRCResultRegH >> 1;
+constexpr uint8_t CRCResultL	= MFRC522::CRCResultRegL >> 1;
+constexpr uint8_t ModWidth		= MFRC522::ModWidthReg >> 1;
+constexpr uint8_t RFCfg			= MFRC522::RFCfgReg >> 1;
+constexpr uint8_t GsN			= MFRC522::GsNReg >> 1;
+constexpr uint8_t CWGsP			= MFRC522::CWGsPReg >> 1;
+constexpr uint8_t ModGsP		= MFRC522::ModGsPReg >> 1;
+constexpr uint8_t TMode			= MFRC522::TModeReg >> 1;
+constexpr uint8_t TPrescaler	= MFRC522::TPrescalerReg >> 1;
+constexpr uint8_t TReloadH		= MFRC522::TReloadRegH >> 1;
+constexpr uint8_t TReloadL		= MFRC522::TReloadRegL >> 1;
+constexpr uint8_t TCounterH		= MFRC522::TCounterValueRegH >> 1;
+constexpr uint8_t TCounterL		= MFRC522::TCounterValueRegL >> 1;
+constexpr uint8_t TestPinEn		= MFRC522::TestPinEnReg >> 1;
+constexpr uint8_t AutoTest		= MFRC522::AutoTestReg >> 1;
+constexpr uint8_t Version		= MFRC522::VersionReg >> 1;
+
+// ComIrqReg bits, table 29
+constexpr uint8_t TxIRq		= 0x40;
+constexpr uint8_t RxIRq		= 0x20;
+constexpr uint8_t IdleIRq	= 0x10;
+constexpr uint8_t HiAlertIRq	= 0x08;
+constexpr uint8_t LoAlertIRq	= 0x04;
+constexpr uint8_t ErrIRq	= 0x02;
+constexpr uint8_t TimerIRq	= 0x01;
+
+// ErrorReg bits, table 35
+constexpr uint8_t BufferOvfl	= 0x10;
+constexpr uint8_t CollErr		= 0x08;
+constexpr uint8_t CRCErr		= 0x04;
+constexpr uint8_t ParityErr		= 0x02;
+
+constexpr double CarrierHz = 13.56e6;
+constexpr uint64_t FrameDelayNanos = 86430;	// FDT of an answer to a frame ending with 0, 1172/fc, ISO/IEC 14443-3 6.2.1.1
+constexpr uint64_t BitNanos106 = 9440;		// 128/fc
+
+} // namespace
+
+MFRC522Sim::MFRC522Sim(uint8_t chipSelectPin, uint8_t resetPowerDownPin, uint8_t irqPin)
+		: _chipSelectPin(chipSelectPin), _resetPowerDownPin(resetPowerDownPin), _irqPin(irqPin), _version(0x92),
+		  _resetMicros(40), _noise(0), _answers(0), _crcNoise(0), _crcAnswers(0), _selected(false), _frameStart(false), _frameRead(false),
+		  _frameAddress(0), _resetLevel(HIGH), _hardPowerDown(false), _booting(false), _random(0x2545F491) {
+	memset(&_stats, 0, sizeof(_stats));
+	memset(_internalBuffer, 0, sizeof(_internalBuffer));
+	reset();
+	_readyAt = FOREVER;				// Powered up long before the sketch starts
+	_instances.push_back(this);
+}
+
+MFRC522Sim::~MFRC522Sim() {
+	_instances.erase(std::remove(_instances.begin(), _instances.end(), this), _instances.end());
+}
+
+void MFRC522Sim::setVersion(uint8_t version) {
+	_version = version;
+	_regs[Version] = version;
+}
+
+void MFRC522Sim::setResetMicros(uint32_t micros) {
+	_resetMicros = micros;
+}
+
+void MFRC522Sim::addPicc(SimPicc *picc, uint64_t fromMicros, uint64_t untilMicros) {
+	PiccSlot slot;
+	slot.picc = picc;
+	slot.from = fromMicros * 1000;
+	slot.until = untilMicros == FOREVER ? FOREVER : untilMicros * 1000;
+	slot.powered = false;
+	_piccs.push_back(slot);
+	updateField(SimClock::now());
+}
+
+void MFRC522Sim::removePicc(SimPicc *picc) {
+	for (size_t i = 0; i < _piccs.size(); i++) {
+		if (_piccs[i].picc == picc) {
+			if (_piccs[i].powered) {
+				picc->powerOff();
+			}
+			_piccs.erase(_piccs.begin() + i);
+			return;
+		}
+	}
+}
+
+void MFRC522Sim::setNoise(uint32_t framesPerError) {
+	_noise = framesPerError;
+}
+
+void MFRC522Sim::setCrcNoise(uint32_t framesPerError) {
+	_crcNoise = framesPerError;
+}
+
+uint8_t MFRC522Sim::peekRegister(uint8_t address) const {
+	address &= 0x3F;
+	if (address == FIFOLevel) {
+		return _fifoLevel;
+	}
+	return _regs[address];
+}
+
+void MFRC522Sim::resetStats() {
+	memset(&_stats, 0, sizeof(_stats));
+}
+
+/**
+ * Register values after a reset, section 9.3. The RcvOff bit in CommandReg is set, the antenna is off.
+ */
+void MFRC522Sim::reset() {
+	memset(_regs, 0, sizeof(_regs));
+	_regs[Command] = 0x20;
+	_regs[ComIEn] = 0x80;
+	_regs[ComIrq] = 0x14;
+	_regs[Status1] = 0x21;
+	_regs[WaterLevel] = 0x08;
+	_regs[Control] = 0x10;
+	_regs[Coll] = 0xA0;
+	_regs[Mode] = 0x3F;
+	_regs[TxControl] = 0x80;
+	_regs[TxSel] = 0x10;
+	_regs[RxSel] = 0x84;
+	_regs[RxThreshold] = 0x84;
+	_regs[Demod] = 0x4D;
+	_regs[MfTx] = 0x62;
+	_regs[SerialSpeed] = 0xEB;
+	_regs[CRCResultH] = 0xFF;
+	_regs[CRCResultL] = 0xFF;
+	_regs[ModWidth] = 0x26;
+	_regs[RFCfg] = 0x48;
+	_regs[GsN] = 0x88;
+	_regs[CWGsP] = 0x20;
+	_regs[ModGsP] = 0x20;
+	_regs[TestPinEn] = 0x80;
+	_regs[AutoTest] = 0x40;
+	_regs[Version] = _version;
+	_fifoLevel = 0;
+	_crypto1 = false;
+	_txEnd = _rxEnd = _authEnd = FOREVER;
+	_timerStart = _timerEnd = _timerStop = FOREVER;
+	_answer.bits = 0;
+	_answerError = 0;
+	_answerCollPos = 0;
+	_rxAlign = 0;
+	updateIrqPin();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Hooks of the Arduino shim
+/////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t MFRC522Sim::spiTransfer(uint8_t data) {
+	uint8_t result = 0;					// MISO is pulled low without a selected chip
+	for (MFRC522Sim *chip : _instances) {
+		if (!chip->_selected) {
+			continue;
+		}
+		uint64_t now = SimClock::now();
+		chip->update(now);
+		chip->_stats.bytes++;
+		if (chip->_hardPowerDown || chip->_booting) {
+			chip->_frameStart = false;	// The frame is lost, the rest of it reads the reserved register 00h
+			chip->_frameRead = true;
+			chip->_frameAddress = 0;
+			continue;
+		}
+		if (chip->_frameStart) {		// Address byte, section 8.1.2.3
+			chip->_frameStart = false;
+			chip->_frameRead = data & 0x80;
+			chip->_frameAddress = (data >> 1) & 0x3F;
+			continue;
+		}
+		if (chip->_frameRead) {			// Every byte returns the register addressed by the byte before
+			result |= chip->readRegister(chip->_frameAddress);
+			chip->_stats.registerReads++;
+			chip->_frameAddress = (data >> 1) & 0x3F;
+		}
+		else {							// All data bytes go to the register of the address byte
+			chip->writeRegister(chip->_frameAddress, data);
+			chip->_stats.registerWrites++;
+		}
+	}
+	return result;
+}
+
+void MFRC522Sim::pinWritten(uint8_t pin, uint8_t level) {
+	uint64_t now = SimClock::now();
+	for (MFRC522Sim *chip : _instances) {
+		if (pin == chip->_chipSelectPin) {
+			bool select = level == LOW;
+			if (select && !chip->_selected) {
+				chip->_frameStart = true;
+				chip->_stats.frames++;
+			}
+			chip->_selected = select;
+		}
+		if (pin == chip->_resetPowerDownPin && level != chip->_resetLevel) {
+			chip->update(now);
+			chip->_resetLevel = level;
+			if (level == LOW) {			// Hard power-down, section 8.6.1
+				chip->_hardPowerDown = true;
+				chip->_booting = false;
+				chip->_readyAt = FOREVER;
+				chip->updateField(now);
+			}
+			else {						// Rising edge: hard reset, the oscillator starts up
+				chip->_hardPowerDown = false;
+				chip->reset();
+				chip->_booting = true;
+				chip->_readyAt = now + (uint64_t)chip->_resetMicros * 1000;
+			}
+		}
+	}
+}
+
+void MFRC522Sim::updateAll() {
+	uint64_t now = SimClock::now();
+	for (MFRC522Sim *chip : _instances) {
+		chip->update(now);
+	}
+}
+
+uint64_t MFRC522Sim::nextEventAll() {
+	uint64_t next = FOREVER;
+	for (MFRC522Sim *chip : _instances) {
+		next = std::min(next, chip->nextEvent());
+		for (const PiccSlot &slot : chip->_piccs) {
+			uint64_t change = slot.powered ? slot.until : slot.from;
+			if (change > SimClock::now()) {
+				next = std::min(next, change);
+			}
+		}
+	}
+	return next;
+}
+
+bool MFRC522Sim::inputLevel(uint8_t pin, uint8_t *level) {
+	for (MFRC522Sim *chip : _instances) {
+		if (pin == chip->_irqPin) {
+			uint8_t active = (chip->_regs[ComIrq] & chip->_regs[ComIEn] & 0x7F) || (chip->_regs[DivIrq] & chip->_regs[DivIEn] & 0x14);
+			bool inverted = chip->_regs[ComIEn] & 0x80;			// IRqInv
+			*level = (active != 0) != inverted ? HIGH : LOW;
+			return true;
+		}
+		if (pin == chip->_resetPowerDownPin) {
+			*level = HIGH;				// Pull-up on the module
+			return true;
+		}
+	}
+	return false;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Events
+/////////////////////////////////////////////////////////////////////////////////////
+
+uint64_t MFRC522Sim::nextEvent() const {
+	uint64_t next = std::min(std::min(_readyAt, _txEnd), std::min(_rxEnd, _authEnd));
+	return std::min(next, _timerEnd);
+}
+
+void MFRC522Sim::update(uint64_t now) {
+	for (uint64_t next = nextEvent(); next <= now; next = nextEvent()) {
+		updateField(next);
+		handleEvent(next);
+	}
+	updateField(now);
+}
+
+/**
+ * Handles the earliest event, which is due at now. On a tie the end of a transmission comes first and the timer
+ * expires before an answer completes.
+ */
+void MFRC522Sim::handleEvent(uint64_t now) {
+	if (_readyAt == now) {
+		_readyAt = FOREVER;
+		_booting = false;
+		_regs[Command] &= ~0x10;		// Oscillator running, PowerDown reads 0
+		if ((_regs[Command] & 0x0F) == MFRC522::PCD_SoftReset) {
+			_regs[Command] &= 0xF0;
+		}
+		updateField(now);
+	}
+	else if (_txEnd == now) {
+		_txEnd = FOREVER;
+		setComIrq(TxIRq);
+		if ((_regs[Command] & 0x0F) == MFRC522::PCD_Transmit) {
+			_regs[Command] &= 0xF0;
+			setComIrq(IdleIRq);
+		}
+	}
+	else if (_timerEnd == now) {
+		setComIrq(TimerIRq);
+		if (_regs[TMode] & 0x10) {		// TAutoRestart
+			_timerStart = _timerEnd;
+			_timerEnd += timerPeriod();
+		}
+		else {
+			_timerStop = _timerEnd;
+			_timerEnd = FOREVER;
+		}
+	}
+	else if (_rxEnd == now) {
+		_rxEnd = FOREVER;
+		deliverAnswer();
+	}
+	else if (_authEnd == now) {
+		_authEnd = FOREVER;
+		_crypto1 = true;
+		_regs[Status2] |= 0x08;			// MFCrypto1On
+		_regs[Command] &= 0xF0;
+		setComIrq(IdleIRq);
+	}
+}
+
+bool MFRC522Sim::fieldOn() const {
+	return !_hardPowerDown && !_booting && !(_regs[Command] & 0x10) && (_regs[TxControl] & 0x03);
+}
+
+/**
+ * Powers the PICCs in the field on and off: the antenna changed, or a PICC entered or left.
+ */
+void MFRC522Sim::updateField(uint64_t now) {
+	bool field = fieldOn();
+	for (PiccSlot &slot : _piccs) {
+		bool powered = field && now >= slot.from && now < slot.until;
+		if (powered != slot.powered) {
+			slot.powered = powered;
+			if (powered) {
+				slot.picc->powerOn();
+			}
+			else {
+				slot.picc->powerOff();
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Registers
+/////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t MFRC522Sim::readRegister(uint8_t address) {
+	uint64_t now = SimClock::now();
+	switch (address) {
+		case Command:
+			if (_readyAt != FOREVER && (_regs[Command] & 0x0F) != MFRC522::PCD_SoftReset) {
+				return _regs[Command] | 0x10;		// Waking up, PowerDown still reads 1
+			}
+			return _regs[Command];
+		case Status1: {
+			uint8_t value = _regs[Status1] & 0x60;	// CRCOk, CRCReady
+			if ((_regs[ComIrq] & _regs[ComIEn] & 0x7F) || (_regs[DivIrq] & _regs[DivIEn] & 0x14)) {
+				value |= 0x10;						// IRq
+			}
+			if (timerRunning(now)) {
+				value |= 0x08;
+			}
+			uint8_t water = _regs[WaterLevel] & 0x3F;
+			if (64 - _fifoLevel <= water) {
+				value |= 0x02;						// HiAlert
+			}
+			if (_fifoLevel <= water) {
+				value |= 0x01;						// LoAlert
+			}
+			return value;
+		}
+		case FIFOData:
+			return fifoPop();
+		case FIFOLevel:
+			return _fifoLevel;
+		case TCounterH:
+		case TCounterL: {
+			uint16_t counter = 0;
+			if (timerRunning(now)) {
+				uint16_t reload = (_regs[TReloadH] << 8) | _regs[TReloadL];
+				uint16_t prescaler = ((_regs[TMode] & 0x0F) << 8) | _regs[TPrescaler];
+				uint64_t tick = (uint64_t)((2 * prescaler + 1) * 1e9 / CarrierHz);
+				counter = reload - (uint16_t)((now - _timerStart) / (tick ? tick : 1));
+			}
+			return address == TCounterH ? counter >> 8 : counter & 0xFF;
+		}
+		default:
+			return _regs[address];
+	}
+}
+
+void MFRC522Sim::writeRegister(uint8_t address, uint8_t value) {
+	uint64_t now = SimClock::now();
+	switch (address) {
+		case Command: {
+			bool powerDown = _regs[Command] & 0x10;
+			uint8_t command = value & 0x0F;
+			if (command == MFRC522::PCD_NoCmdChange) {
+				command = _regs[Command] & 0x0F;
+			}
+			if (powerDown && !(value & 0x10)) {		// Wake up, section 8.6.2
+				_readyAt = now + (uint64_t)_resetMicros * 1000;
+				_regs[Command] = (value & 0x20) | 0x10 | command;
+				return;
+			}
+			_regs[Command] = (value & 0x30) | (_regs[Command] & 0x0F);
+			if (value & 0x10) {						// Soft power-down, the running command stops
+				_regs[Command] = (value & 0x30);
+				_txEnd = _rxEnd = _authEnd = FOREVER;
+				updateField(now);
+				return;
+			}
+			if (!powerDown && (value & 0x0F) != MFRC522::PCD_NoCmdChange) {
+				startCommand(command);
+			}
+			break;
+		}
+		case ComIrq:
+		case DivIrq:
+			if (value & 0x80) {						// Set1/Set2: the marked bits are set
+				_regs[address] |= value & 0x7F;
+			}
+			else {
+				_regs[address] &= ~value;
+			}
+			updateIrqPin();
+			break;
+		case Status2:
+			// TempSensClear and I2CForceHS are writable, MFCrypto1On can only be cleared
+			_regs[Status2] = (value & 0xC0) | (_regs[Status2] & value & 0x08) | (_regs[Status2] & 0x07);
+			if (!(_regs[Status2] & 0x08)) {
+				_crypto1 = false;
+			}
+			break;
+		case FIFOData:
+			fifoPush(value);
+			break;
+		case FIFOLevel:
+			if (value & 0x80) {
+				fifoFlush();
+			}
+			break;
+		case Control:
+			if (value & 0x80) {						// TStopNow
+				_timerStop = now;
+				_timerEnd = FOREVER;
+			}
+			if (value & 0x40) {						// TStartNow
+				startTimer(now, FOREVER);
+			}
+			break;
+		case BitFraming:
+			_regs[BitFraming] = value & 0x7F;
+			if ((value & 0x80) && (_regs[Command] & 0x0F) == MFRC522::PCD_Transceive && _txEnd == FOREVER) {
+				startTransmission(now);
+			}
+			break;
+		case Coll:
+			_regs[Coll] = (value & 0x80) | (_regs[Coll] & 0x7F);
+			break;
+		case TxControl:
+			_regs[TxControl] = value;
+			updateField(now);
+			break;
+		case Error:
+		case Status1:
+		case CRCResultH:
+		case CRCResultL:
+		case TCounterH:
+		case TCounterL:
+		case Version:
+			break;									// Read only
+		default:
+			_regs[address] = value;
+			break;
+	}
+}
+
+void MFRC522Sim::setComIrq(uint8_t bits) {
+	_regs[ComIrq] |= bits;
+	updateIrqPin();
+}
+
+/**
+ * The IRQ pin follows the registers, the shim reads it with inputLevel(). Keeps Status1Reg's IRq bit
+ * consistent for peekRegister().
+ */
+void MFRC522Sim::updateIrqPin() {
+	bool active = (_regs[ComIrq] & _regs[ComIEn] & 0x7F) || (_regs[DivIrq] & _regs[DivIEn] & 0x14);
+	_regs[Status1] = (_regs[Status1] & ~0x10) | (active ? 0x10 : 0x00);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// FIFO
+/////////////////////////////////////////////////////////////////////////////////////
+
+void MFRC522Sim::fifoPush(uint8_t value) {
+	if (_fifoLevel >= sizeof(_fifo)) {
+		_regs[Error] |= BufferOvfl;
+		return;
+	}
+	_fifo[_fifoLevel++] = value;
+	if (64 - _fifoLevel <= (_regs[WaterLevel] & 0x3F)) {
+		setComIrq(HiAlertIRq);
+	}
+}
+
+uint8_t MFRC522Sim::fifoPop() {
+	if (_fifoLevel == 0) {
+		return 0;
+	}
+	uint8_t value = _fifo[0];
+	memmove(_fifo, _fifo + 1, --_fifoLevel);
+	if (_fifoLevel <= (_regs[WaterLevel] & 0x3F)) {
+		setComIrq(LoAlertIRq);
+	}
+	return value;
+}
+
+void MFRC522Sim::fifoFlush() {
+	_fifoLevel = 0;
+	_regs[Error] &= ~BufferOvfl;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Commands, chapter 10
+/////////////////////////////////////////////////////////////////////////////////////
+
+void MFRC522Sim::startCommand(uint8_t command) {
+	uint64_t now = SimClock::now();
+	// Every command stops the one running
+	_txEnd = _rxEnd = _authEnd = FOREVER;
+	_regs[Command] = (_regs[Command] & 0xF0) | command;
+	switch (command) {
+		case MFRC522::PCD_Idle:
+			break;
+		case MFRC522::PCD_Mem:
+			if (_fifoLevel >= sizeof(_internalBuffer)) {	// FIFO to the internal buffer
+				for (uint8_t i = 0; i < sizeof(_internalBuffer); i++) {
+					_internalBuffer[i] = fifoPop();
+				}
+			}
+			else if (_fifoLevel == 0) {						// And back
+				for (uint8_t i = 0; i < sizeof(_internalBuffer); i++) {
+					fifoPush(_internalBuffer[i]);
+				}
+			}
+			_regs[Command] &= 0xF0;
+			setComIrq(IdleIRq);
+			break;
+		case MFRC522::PCD_GenerateRandomID:
+			for (uint8_t i = 0; i < 10; i++) {
+				_random = _random * 1103515245u + 12345u;
+				_internalBuffer[i] = _random >> 16;
+			}
+			_regs[Command] &= 0xF0;
+			setComIrq(IdleIRq);
+			break;
+		case MFRC522::PCD_CalcCRC:
+			if ((_regs[AutoTest] & 0x0F) == 0x09) {
+				selfTest();
+			}
+			else {
+				calculateCRC();
+			}
+			break;
+		case MFRC522::PCD_Transmit:
+			startTransmission(now);
+			break;
+		case MFRC522::PCD_Transceive:
+			_regs[Error] = 0;
+			if (_regs[BitFraming] & 0x80) {
+				startTransmission(now);
+			}
+			break;
+		case MFRC522::PCD_MFAuthent:
+			startAuthentication(now);
+			break;
+		case MFRC522::PCD_SoftReset:
+			reset();
+			_regs[Command] = 0x20 | MFRC522::PCD_SoftReset;
+			_readyAt = now + (uint64_t)_resetMicros * 1000;
+			updateField(now);
+			break;
+		default:						// Receive alone is not modelled, nothing to receive without a request
+			break;
+	}
+}
+
+/**
+ * CalcCRC over the FIFO content with the preset of ModeReg, section 10.3.1.4. The coprocessor is fast
+ * compared to the bus, so the result is ready at once.
+ */
+void MFRC522Sim::calculateCRC() {
+	static const uint16_t presets[] = { 0x0000, 0x6363, 0xA671, 0xFFFF };
+	uint16_t crc = presets[_regs[Mode] & 0x03];
+	while (_fifoLevel > 0) {
+		uint8_t b = fifoPop() ^ (crc & 0xFF);
+		b ^= b << 4;
+		crc = (crc >> 8) ^ ((uint16_t)b << 8) ^ ((uint16_t)b << 3) ^ (b >> 4);
+	}
+	_regs[CRCResultH] = crc >> 8;
+	_regs[CRCResultL] = crc & 0xFF;
+	_regs[Status1] = (_regs[Status1] & ~0x40) | 0x20 | (crc == 0 ? 0x40 : 0x00);	// CRCReady, CRCOk
+	_regs[DivIrq] |= 0x04;				// CRCIRq
+	updateIrqPin();
+}
+
+/**
+ * Digital self test, section 16.1.1: the FIFO gets the reference bytes of the chip version.
+ */
+void MFRC522Sim::selfTest() {
+	const uint8_t *reference;
+	switch (_version) {
+		case 0x88:	reference = FM17522_firmware_reference;		break;
+		case 0x90:	reference = MFRC522_firmware_referenceV0_0;	break;
+		case 0x91:	reference = MFRC522_firmware_referenceV1_0;	break;
+		default:	reference = MFRC522_firmware_referenceV2_0;	break;
+	}
+	fifoFlush();
+	for (uint8_t i = 0; i < 64; i++) {
+		fifoPush(reference[i]);
+	}
+	_regs[DivIrq] |= 0x04;
+	updateIrqPin();
+}
+
+uint64_t MFRC522Sim::bitNanos(uint8_t modeReg) const {
+	return BitNanos106 >> ((modeReg >> 4) & 0x03);
+}
+
+/**
+ * Time on air of a frame: start of communication, 8 data bits and a parity bit per byte, end of communication.
+ */
+uint64_t MFRC522Sim::airNanos(uint32_t bits, uint8_t modeReg) const {
+	return ((bits / 8) * 9 + bits % 8 + 2) * bitNanos(modeReg);
+}
+
+uint64_t MFRC522Sim::timerPeriod() const {
+	uint16_t prescaler = ((_regs[TMode] & 0x0F) << 8) | _regs[TPrescaler];
+	uint32_t reload = (_regs[TReloadH] << 8) | _regs[TReloadL];
+	return (uint64_t)((reload + 1.0) * (2 * prescaler + 1) * 1e9 / CarrierHz);
+}
+
+/**
+ * Starts the timer at start, e.g. the end of a transmission with TAuto. It stops at stop, the start of an answer,
+ * unless it expires before.
+ */
+void MFRC522Sim::startTimer(uint64_t start, uint64_t stop) {
+	_timerStart = start;
+	_timerEnd = start + timerPeriod();
+	_timerStop = FOREVER;
+	if (stop < _timerEnd) {
+		_timerStop = stop;
+		_timerEnd = FOREVER;
+	}
+}
+
+bool MFRC522Sim::timerRunning(uint64_t now) const {
+	return _timerStart != FOREVER && now >= _timerStart && now < std::min(_timerEnd, _timerStop);
+}
+
+/**
+ * Sends the PICCs the frame and merges their answers. Returns false if none answered.
+ * With several answers the first bit they differ in is a collision, section 9.3.1.15.
+ */
+bool MFRC522Sim::collect(const SimFrame &in, SimFrame &answer, uint8_t *error, uint8_t *collPos) {
+	answer.bits = 0;
+	answer.delayMicros = 0;
+	*error = 0;
+	*collPos = 0;
+	int32_t collision = -1;
+	bool any = false;
+	SimFrame out;
+	for (PiccSlot &slot : _piccs) {
+		if (!slot.powered || !slot.picc->transceive(in, _crypto1, out)) {
+			continue;
+		}
+		if (!any) {
+			answer = out;
+			any = true;
+			continue;
+		}
+		uint16_t common = std::min(answer.bits, out.bits);
+		for (uint16_t bit = 0; bit < common && collision < 0; bit++) {
+			if (((answer.data[bit / 8] ^ out.data[bit / 8]) >> (bit % 8)) & 1) {
+				collision = bit;
+			}
+		}
+		if (collision < 0 && answer.bits != out.bits) {
+			collision = common;
+		}
+		for (uint16_t i = 0; i < out.size(); i++) {
+			answer.data[i] = i < answer.size() ? answer.data[i] | out.data[i] : out.data[i];
+		}
+		answer.bits = std::max(answer.bits, out.bits);
+		answer.delayMicros = std::max(answer.delayMicros, out.delayMicros);
+	}
+	if (!any) {
+		return false;
+	}
+	if (collision >= 0) {
+		*error |= CollErr;
+		uint16_t position = _rxAlign + collision + 1;
+		*collPos = position > 32 ? 0x20 : (position & 0x1F);
+		if (!(_regs[Coll] & 0x80)) {	// ValuesAfterColl = 0: bits after the collision are cleared
+			for (uint16_t bit = collision + 1; bit < answer.bits; bit++) {
+				answer.data[bit / 8] &= ~(1 << (bit % 8));
+			}
+		}
+	}
+	else {
+		*collPos = 0x20;				// CollPosNotValid
+	}
+	if (_noise && ++_answers % _noise == 0) {
+		*error |= ParityErr;
+	}
+	if (_crcNoise && ++_crcAnswers % _crcNoise == 0 && answer.bits >= 8) {
+		answer.data[answer.bits / 8 - 1] ^= 0x01;	// A bit error the parity misses, only a CRC_A catches it
+	}
+	return true;
+}
+
+void MFRC522Sim::startTransmission(uint64_t now) {
+	uint8_t lastBits = _regs[BitFraming] & 0x07;
+	_rxAlign = (_regs[BitFraming] >> 4) & 0x07;
+	_regs[Error] = 0;
+	SimFrame in;
+	uint8_t count = _fifoLevel;
+	for (uint8_t i = 0; i < count; i++) {
+		in.data[i] = fifoPop();
+	}
+	in.bits = lastBits && count ? (count - 1) * 8 + lastBits : count * 8;
+	if ((_regs[TxMode] & 0x80) && lastBits == 0 && count > 0) {		// TxCRCEn
+		in.appendCRC();
+	}
+	_txEnd = now + airNanos(in.bits, _regs[TxMode]);
+	_stats.rfFrames++;
+	_stats.rfNanos += _txEnd - now;
+
+	bool answered = !(_regs[Command] & 0x20) && (_regs[Command] & 0x0F) == MFRC522::PCD_Transceive &&
+			collect(in, _answer, &_answerError, &_answerCollPos);
+	uint64_t rxStart = FOREVER;
+	if (answered) {
+		rxStart = _txEnd + FrameDelayNanos + (uint64_t)_answer.delayMicros * 1000;
+		_rxEnd = rxStart + airNanos(_answer.bits, _regs[RxMode]);
+		_stats.rfNanos += _rxEnd - rxStart;
+		if ((_regs[RxMode] & 0x80) && !(_answerError & CollErr)) {		// RxCRCEn: check and remove the CRC
+			if (_answer.bits % 8 != 0 || !_answer.checkCRC()) {
+				_answerError |= CRCErr;
+			}
+			else {
+				_answer.bits -= 16;
+			}
+		}
+	}
+	if (_regs[TMode] & 0x80) {			// TAuto
+		startTimer(_txEnd, rxStart);
+	}
+}
+
+/**
+ * MFAuthent, section 10.3.1.9. The FIFO holds the authentication command, the block address, the key and
+ * the UID. The frames on air are the command, the PICC's nonce, the reader's answer and the PICC's answer.
+ */
+void MFRC522Sim::startAuthentication(uint64_t now) {
+	uint8_t data[12];
+	memset(data, 0, sizeof(data));
+	for (uint8_t i = 0; i < sizeof(data) && _fifoLevel > 0; i++) {
+		data[i] = fifoPop();
+	}
+	_regs[Error] = 0;
+	bool active = false;
+	bool success = false;
+	for (PiccSlot &slot : _piccs) {
+		if (slot.powered && slot.picc->state() == SimPicc::Active) {
+			active = true;
+			success = slot.picc->authenticate(data[0], data[1], &data[2], &data[8]) || success;
+		}
+	}
+	uint8_t mode = _regs[TxMode];
+	uint64_t end = now + airNanos(32, mode);						// Command and CRC
+	if (active) {
+		end += FrameDelayNanos + airNanos(32, mode);				// Nonce of the PICC
+		end += FrameDelayNanos + airNanos(64, mode);				// Reader nonce and answer
+	}
+	_stats.rfFrames += active ? 2 : 1;
+	_stats.rfNanos += end - now;
+	if (success) {
+		_authEnd = end + FrameDelayNanos + airNanos(32, mode);	// Answer of the PICC
+		_stats.rfNanos += _authEnd - end;
+	}
+	else if (_regs[TMode] & 0x80) {
+		startTimer(end, FOREVER);		// The PICC stays silent, the timer ends the command
+	}
+}
+
+/**
+ * The answer arrives in the FIFO, starting at bit RxAlign of the first byte, section 9.3.1.14.
+ */
+void MFRC522Sim::deliverAnswer() {
+	uint16_t total = _rxAlign + _answer.bits;
+	uint16_t bytes = (total + 7) / 8;
+	for (uint16_t i = 0; i < bytes; i++) {
+		uint16_t value = i < _answer.size() ? _answer.data[i] << _rxAlign : 0;
+		if (i > 0 && _rxAlign) {
+			value |= _answer.data[i - 1] >> (8 - _rxAlign);
+		}
+		fifoPush(value & 0xFF);
+	}
+	_regs[Control] = (_regs[Control] & 0xF8) | (total % 8);		// RxLastBits
+	_regs[Error] |= _answerError;
+	_regs[Coll] = (_regs[Coll] & 0x80) | _answerCollPos;
+	uint8_t irq = RxIRq;
+	if (_regs[Error] & 0x1F) {
+		irq |= ErrIRq;
+	}
+	setComIrq(irq);
+}
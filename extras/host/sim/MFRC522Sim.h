@@ -0,0 +1,141 @@
+/**
+ * Behavioural model of the MFRC522 for host builds, see extras/host/README.rst.
+ *
+ * Models the SPI protocol of section 8.1.2, the register file, the 64 byte FIFO, the commands of chapter 10,
+ * the timer with TAuto, the interrupt request bits and the IRQ pin, soft and hard reset and power-down.
+ * Frames sent by Transceive, Transmit and MFAuthent go to the virtual PICCs in the field of the reader,
+ * their answers come back after the time on air computed for the bit rates in TxModeReg/RxModeReg.
+ * Several answers at once collide bit by bit, as during anticollision.
+ *
+ * Not modelled: the analog part (gain, thresholds, modulation only change the registers), the UART and
+ * I2C interfaces, Receive without Transmit, parity bits on the wire and real Crypto1 encryption.
+ * MFAuthent checks the key against the PICC and marks both as authenticated instead.
+ *
+ * Released into the public domain.
+ */
+#ifndef MFRC522Sim_h
+#define MFRC522Sim_h
+
+#include <stdint.h>
+#include <vector>
+#include "SimPicc.h"
+
+class MFRC522Sim {
+public:
+	static constexpr uint8_t UNUSED_PIN = 0xFF;
+	static constexpr uint64_t FOREVER = UINT64_MAX;
+
+	// A struct used for counting the bus and RF activity, see getStats()
+	struct Stats {
+		uint32_t	frames;				// SPI frames, i.e. chip select cycles
+		uint32_t	bytes;				// Bytes transferred on SPI, address bytes included
+		uint32_t	registerReads;		// Register values read, every FIFO byte counts
+		uint32_t	registerWrites;		// Register values written, every FIFO byte counts
+		uint64_t	rfNanos;			// Time the reader transmitted or received on RF
+		uint32_t	rfFrames;			// Frames sent to the PICCs
+	};
+
+	MFRC522Sim(uint8_t chipSelectPin, uint8_t resetPowerDownPin = UNUSED_PIN, uint8_t irqPin = UNUSED_PIN);
+	~MFRC522Sim();
+	MFRC522Sim(const MFRC522Sim &) = delete;
+	MFRC522Sim &operator=(const MFRC522Sim &) = delete;
+
+	void setVersion(uint8_t version);				// VersionReg, 0x91 and 0x92 are genuine MFRC522, 0x88 the FM17522
+	void setResetMicros(uint32_t micros);			// Time from a reset or wake-up until the MFRC522 answers
+	void addPicc(SimPicc *picc, uint64_t fromMicros = 0, uint64_t untilMicros = FOREVER);
+	void removePicc(SimPicc *picc);
+	void setNoise(uint32_t framesPerError);			// Every n-th answer gets a parity error, 0 for none
+	void setCrcNoise(uint32_t framesPerError);		// Every n-th answer gets a flipped bit in its last byte, 0 for none
+
+	uint8_t peekRegister(uint8_t address) const;	// Register value without side effects, address 0x00 to 0x3F
+	const Stats &getStats() const { return _stats; }
+	void resetStats();
+
+	// Hooks of the Arduino shim
+	static uint8_t spiTransfer(uint8_t data);		// Byte to and from the chip whose chip select is LOW
+	static void pinWritten(uint8_t pin, uint8_t level);
+	static void updateAll();						// Processes everything due at SimClock::now()
+	static uint64_t nextEventAll();					// Time of the next internal event of any chip, FOREVER if none
+	static bool inputLevel(uint8_t pin, uint8_t *level);	// Level the chips drive on a pin: IRQ, and RST pulled up
+
+private:
+	struct PiccSlot {
+		SimPicc		*picc;
+		uint64_t	from;					// Virtual time in ns the PICC enters the field
+		uint64_t	until;					// ... and leaves it
+		bool		powered;
+	};
+
+	static std::vector<MFRC522Sim *> _instances;
+
+	uint8_t _chipSelectPin;
+	uint8_t _resetPowerDownPin;
+	uint8_t _irqPin;
+	uint8_t _version;
+	uint32_t _resetMicros;
+	uint32_t _noise;
+	uint32_t _answers;
+	uint32_t _crcNoise;
+	uint32_t _crcAnswers;
+	Stats _stats;
+	std::vector<PiccSlot> _piccs;
+
+	uint8_t _regs[64];
+	uint8_t _fifo[64];
+	uint8_t _fifoLevel;
+	uint8_t _internalBuffer[25];
+	bool _crypto1;					// MFCrypto1On after a successful MFAuthent
+
+	// SPI frame state
+	bool _selected;
+	bool _frameStart;
+	bool _frameRead;
+	uint8_t _frameAddress;			// Register of a write frame, or to read with the next byte
+
+	// Power and reset
+	uint8_t _resetLevel;			// Level on the NRSTPD pin
+	bool _hardPowerDown;
+	bool _booting;					// Hard reset running, SPI is not answering yet
+	uint64_t _readyAt;				// End of a reset or wake-up, FOREVER if none is running
+	uint32_t _random;				// State of GenerateRandomID
+
+	// Command engine, times in ns, FOREVER if not pending
+	uint64_t _txEnd;
+	uint64_t _rxEnd;
+	uint64_t _timerStart;
+	uint64_t _timerEnd;				// Next TimerIRq
+	uint64_t _timerStop;			// Timer stopped by TStopNow, an expiry or the start of an answer
+	uint64_t _authEnd;
+	SimFrame _answer;				// Answer delivered at _rxEnd
+	uint8_t _answerError;			// ErrorReg bits of the answer
+	uint8_t _answerCollPos;			// CollReg of the answer
+	uint8_t _rxAlign;
+
+	void reset();
+	void update(uint64_t now);
+	uint64_t nextEvent() const;
+	void handleEvent(uint64_t now);
+	void updateField(uint64_t now);
+	bool fieldOn() const;
+	uint8_t readRegister(uint8_t address);
+	void writeRegister(uint8_t address, uint8_t value);
+	void startCommand(uint8_t command);
+	void startTransmission(uint64_t now);
+	void startAuthentication(uint64_t now);
+	void deliverAnswer();
+	void startTimer(uint64_t start, uint64_t stop);
+	uint64_t timerPeriod() const;
+	bool timerRunning(uint64_t now) const;
+	uint64_t bitNanos(uint8_t modeReg) const;
+	uint64_t airNanos(uint32_t bits, uint8_t modeReg) const;
+	void setComIrq(uint8_t bits);
+	void updateIrqPin();
+	void fifoPush(uint8_t value);
+	uint8_t fifoPop();
+	void fifoFlush();
+	void calculateCRC();
+	void selfTest();
+	bool collect(const SimFrame &in, SimFrame &answer, uint8_t *error, uint8_t *collPos);
+};
+
+#endif
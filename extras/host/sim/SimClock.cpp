@@ -0,0 +1,42 @@
+/**
+ * Virtual clock of the host simulator, see SimClock.h.
+ *
+ * Released into the public domain.
+ */
+#include "SimClock.h"
+#include "MFRC522Sim.h"
+
+namespace {
+	uint64_t current = 0;
+	void (*afterAdvance)() = nullptr;
+}
+
+uint64_t SimClock::now() {
+	return current;
+}
+
+/**
+ * Moves the clock event by event, so every chip sees its interrupts at the right time.
+ */
+void SimClock::advanceTo(uint64_t nanos) {
+	while (current < nanos) {
+		uint64_t next = MFRC522Sim::nextEventAll();
+		current = next > current && next < nanos ? next : nanos;
+		MFRC522Sim::updateAll();
+		if (afterAdvance) {
+			afterAdvance();
+		}
+	}
+}
+
+void SimClock::advance(uint64_t nanos) {
+	advanceTo(current + nanos);
+}
+
+void SimClock::reset() {
+	current = 0;
+}
+
+void SimClock::setHook(void (*hook)()) {
+	afterAdvance = hook;
+}
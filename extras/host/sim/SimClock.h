@@ -0,0 +1,20 @@
+/**
+ * Virtual clock of the host simulator. millis(), micros(), delay() and the simulated MFRC522 use it,
+ * time only passes when the sketch waits, transfers on the bus or yields.
+ *
+ * Released into the public domain.
+ */
+#ifndef SimClock_h
+#define SimClock_h
+
+#include <stdint.h>
+
+namespace SimClock {
+	uint64_t now();						// Nanoseconds since the start
+	void advance(uint64_t nanos);		// Lets time pass and updates the simulated chips
+	void advanceTo(uint64_t nanos);
+	void reset();
+	void setHook(void (*hook)());		// Called after each advance, e.g. to run interrupt handlers
+}
+
+#endif
@@ -0,0 +1,216 @@
+/**
+ * Runs an unmodified sketch against simulated MFRC522 readers and PICCs, see extras/host/README.rst.
+ *
+ *   ./DumpInfo [--run MS] [--picc SPEC]... [--input TEXT] [--version HEX] [--noise N] [--wall S] [--stats]
+ *
+ * SPEC is TYPE[:UID][,from=MS][,until=MS][,reader=N], TYPE one of classic1k, classic4k, magic1k, ultralight,
+ * ntag213, ntag215, ntag216 and isodep, UID in hex. Without --picc a MIFARE Classic 1K with UID DEADBEEF is in
+ * the field of every reader from 500ms to 3500ms.
+ *
+ * Released into the public domain.
+ */
+#include <Arduino.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <vector>
+#include "MFRC522Sim.h"
+#include "SimArduino.h"
+#include "SimClock.h"
+
+namespace {
+
+// The pins of the examples: SS 10 with RST 9, a second reader on SS 8, MinimalInterrupt on SS 3 with IRQ 2
+struct ReaderPins {
+	uint8_t chipSelect;
+	uint8_t resetPowerDown;
+	uint8_t irq;
+};
+const ReaderPins readerPins[] = {
+	{ 10, 9, MFRC522Sim::UNUSED_PIN },
+	{ 8, 9, MFRC522Sim::UNUSED_PIN },
+	{ 3, 9, 2 },
+};
+constexpr size_t READERS = sizeof(readerPins) / sizeof(readerPins[0]);
+
+struct PiccSpec {
+	std::string type;
+	std::vector<uint8_t> uid;
+	uint64_t fromMillis = 500;
+	uint64_t untilMillis = 3500;
+	int reader = -1;					// -1 for every reader
+};
+
+void usage(const char *name) {
+	fprintf(stderr, "usage: %s [--run MS] [--picc TYPE[:UID][,from=MS][,until=MS][,reader=N]]... [--input TEXT]\n"
+			"          [--version HEX] [--noise N] [--wall S] [--stats]\n"
+			"TYPE: classic1k classic4k magic1k ultralight ntag213 ntag215 ntag216 isodep\n", name);
+	exit(2);
+}
+
+void timeout(int) {
+	static const char message[] = "\n[sim] wall clock limit reached, the sketch waits for something the simulation does not provide\n";
+	fflush(stdout);
+	if (write(STDERR_FILENO, message, sizeof(message) - 1) < 0) {
+		// Nothing left to report to
+	}
+	_exit(3);
+}
+
+bool parseHex(const std::string &text, std::vector<uint8_t> &bytes) {
+	if (text.size() % 2 != 0) {
+		return false;
+	}
+	bytes.clear();
+	for (size_t i = 0; i < text.size(); i += 2) {
+		char *end;
+		std::string pair = text.substr(i, 2);
+		bytes.push_back((uint8_t)strtoul(pair.c_str(), &end, 16));
+		if (*end) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool parsePicc(const char *text, PiccSpec &spec) {
+	std::string rest(text);
+	size_t comma = rest.find(',');
+	std::string head = rest.substr(0, comma);
+	rest = comma == std::string::npos ? "" : rest.substr(comma + 1);
+	size_t colon = head.find(':');
+	spec.type = head.substr(0, colon);
+	if (colon != std::string::npos && !parseHex(head.substr(colon + 1), spec.uid)) {
+		return false;
+	}
+	while (!rest.empty()) {
+		comma = rest.find(',');
+		std::string option = rest.substr(0, comma);
+		rest = comma == std::string::npos ? "" : rest.substr(comma + 1);
+		size_t equals = option.find('=');
+		if (equals == std::string::npos) {
+			return false;
+		}
+		std::string key = option.substr(0, equals);
+		unsigned long value = strtoul(option.c_str() + equals + 1, nullptr, 0);
+		if (key == "from") {
+			spec.fromMillis = value;
+		}
+		else if (key == "until") {
+			spec.untilMillis = value;
+		}
+		else if (key == "reader") {
+			spec.reader = (int)value;
+		}
+		else {
+			return false;
+		}
+	}
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	uint64_t runMillis = 5000;
+	unsigned wallSeconds = 10;
+	bool stats = false;
+	int version = -1;
+	uint32_t noise = 0;
+	std::vector<PiccSpec> specs;
+
+	for (int i = 1; i < argc; i++) {
+		const char *option = argv[i];
+		const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+		if (!strcmp(option, "--stats")) {
+			stats = true;
+			continue;
+		}
+		if (!value) {
+			usage(argv[0]);
+		}
+		i++;
+		if (!strcmp(option, "--run")) {
+			runMillis = strtoull(value, nullptr, 0);
+		}
+		else if (!strcmp(option, "--picc")) {
+			PiccSpec spec;
+			if (!parsePicc(value, spec)) {
+				usage(argv[0]);
+			}
+			specs.push_back(spec);
+		}
+		else if (!strcmp(option, "--input")) {
+			SimArduino::setSerialInput(value);
+		}
+		else if (!strcmp(option, "--version")) {
+			version = (int)strtoul(value, nullptr, 16);
+		}
+		else if (!strcmp(option, "--noise")) {
+			noise = (uint32_t)strtoul(value, nullptr, 0);
+		}
+		else if (!strcmp(option, "--wall")) {
+			wallSeconds = (unsigned)strtoul(value, nullptr, 0);
+		}
+		else {
+			usage(argv[0]);
+		}
+	}
+	if (specs.empty()) {
+		specs.push_back(PiccSpec());
+		specs.back().type = "classic1k";
+	}
+
+	SimArduino::begin();
+	std::vector<std::unique_ptr<MFRC522Sim>> readers;
+	for (size_t r = 0; r < READERS; r++) {
+		readers.emplace_back(new MFRC522Sim(readerPins[r].chipSelect, readerPins[r].resetPowerDown, readerPins[r].irq));
+		if (version >= 0) {
+			readers.back()->setVersion((uint8_t)version);
+		}
+		readers.back()->setNoise(noise);
+	}
+	// Every reader gets its own PICC, a PICC can only be in one field
+	std::vector<std::unique_ptr<SimPicc>> piccs;
+	for (const PiccSpec &spec : specs) {
+		for (size_t r = 0; r < READERS; r++) {
+			if (spec.reader >= 0 && (size_t)spec.reader != r) {
+				continue;
+			}
+			SimPicc *picc = SimPicc::create(spec.type.c_str(), spec.uid.data(), (uint8_t)spec.uid.size());
+			if (!picc) {
+				fprintf(stderr, "unknown PICC type or UID size: %s\n", spec.type.c_str());
+				return 2;
+			}
+			piccs.emplace_back(picc);
+			readers[r]->addPicc(picc, spec.fromMillis * 1000, spec.untilMillis * 1000);
+		}
+	}
+
+	if (wallSeconds > 0) {
+		signal(SIGALRM, timeout);
+		alarm(wallSeconds);
+	}
+	setup();
+	while (SimClock::now() < runMillis * 1000000) {
+		loop();
+		SimClock::advance(10000);		// The Arduino core's main() does a little work between two loop() calls
+	}
+	fflush(stdout);
+
+	if (stats) {
+		fprintf(stderr, "[sim] %llu ms virtual time, %u SPI transactions, %u SPI bytes\n",
+				(unsigned long long)(SimClock::now() / 1000000), SimArduino::spiTransactions(), SimArduino::spiBytes());
+		for (size_t r = 0; r < READERS; r++) {
+			const MFRC522Sim::Stats &s = readers[r]->getStats();
+			fprintf(stderr, "[sim] reader %u: %u frames, %u bytes, %u register reads, %u writes, %u RF frames, %llu us on air\n",
+					(unsigned)r, s.frames, s.bytes, s.registerReads, s.registerWrites, s.rfFrames,
+					(unsigned long long)(s.rfNanos / 1000));
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,879 @@
+/**
+ * Virtual PICCs for the host simulator, see SimPicc.h.
+ *
+ * Released into the public domain.
+ */
+#include "SimPicc.h"
+#include <string.h>
+
+/////////////////////////////////////////////////////////////////////////////////////
+// SimFrame
+/////////////////////////////////////////////////////////////////////////////////////
+
+void SimFrame::set(const uint8_t *bytes, uint16_t count) {
+	memcpy(data, bytes, count);
+	bits = count * 8;
+}
+
+void SimFrame::setBits(uint8_t value, uint8_t count) {
+	data[0] = value & ((1 << count) - 1);
+	bits = count;
+}
+
+void SimFrame::append(uint8_t value) {
+	data[bits / 8] = value;
+	bits += 8;
+}
+
+void SimFrame::appendCRC() {
+	uint16_t value = crc(data, size());
+	append(value & 0xFF);
+	append(value >> 8);
+}
+
+bool SimFrame::checkCRC() const {
+	if ((bits % 8) != 0 || bits < 24) {
+		return false;
+	}
+	uint16_t value = crc(data, size() - 2);
+	return data[size() - 2] == (value & 0xFF) && data[size() - 1] == (value >> 8);
+}
+
+/**
+ * CRC_A of ISO/IEC 14443-3 annex B, low byte first on the wire.
+ */
+uint16_t SimFrame::crc(const uint8_t *bytes, uint16_t count) {
+	uint16_t crc = 0x6363;
+	for (uint16_t i = 0; i < count; i++) {
+		uint8_t b = bytes[i] ^ (crc & 0xFF);
+		b ^= b << 4;
+		crc = (crc >> 8) ^ ((uint16_t)b << 8) ^ ((uint16_t)b << 3) ^ (b >> 4);
+	}
+	return crc;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// SimPicc: ISO/IEC 14443-3 type A
+/////////////////////////////////////////////////////////////////////////////////////
+
+SimPicc::SimPicc(const uint8_t *uid, uint8_t uidSize, uint16_t atqa, uint8_t sak)
+		: _state(Off), _uidSize(uidSize), _atqa(atqa), _sak(sak), _level(0), _halted(false), _authenticated(false) {
+	memset(_uid, 0, sizeof(_uid));
+	memcpy(_uid, uid, uidSize);
+}
+
+void SimPicc::powerOn() {
+	_state = Idle;
+	_halted = false;
+	_authenticated = false;
+	leave();
+}
+
+void SimPicc::powerOff() {
+	_state = Off;
+	_authenticated = false;
+	leave();
+}
+
+void SimPicc::fail() {
+	_state = _halted ? Halt : Idle;
+	_authenticated = false;
+	leave();
+}
+
+void SimPicc::ack(SimFrame &out, uint8_t nibble) {
+	out.setBits(nibble, 4);
+}
+
+bool SimPicc::authenticate(uint8_t command, uint8_t block, const uint8_t *key, const uint8_t *uid) {
+	(void)command;
+	(void)block;
+	(void)key;
+	(void)uid;
+	return false;
+}
+
+bool SimPicc::transceive(const SimFrame &in, bool encrypted, SimFrame &out) {
+	out.bits = 0;
+	out.delayMicros = 0;
+	if (_state == Off || in.bits == 0) {
+		return false;
+	}
+	if (!encrypted && intercept(in, out)) {
+		return out.bits > 0;
+	}
+	// Without the same Crypto1 session on both sides the frame is noise to the PICC
+	if (encrypted != _authenticated) {
+		if (_state == Active) {
+			fail();
+		}
+		return false;
+	}
+
+	// Short frames
+	if (in.bits == 7) {
+		uint8_t command = in.data[0] & 0x7F;
+		bool wakeUp = command == 0x52;
+		if ((command == 0x26 && _state == Idle) || (wakeUp && (_state == Idle || _state == Halt))) {
+			_halted = _state == Halt;
+			_state = Ready;
+			_level = 0;
+			out.set(reinterpret_cast<const uint8_t *>("\0\0"), 2);
+			out.data[0] = _atqa & 0xFF;
+			out.data[1] = _atqa >> 8;
+			return true;
+		}
+		if ((command == 0x26 || wakeUp) && (_state == Ready || _state == Active || _state == Protocol)) {
+			fail();
+		}
+		return false;
+	}
+
+	Result result;
+	switch (_state) {
+		case Ready:
+			result = anticollision(in, out);
+			break;
+		case Active:
+			if (in.bits == 32 && in.data[0] == 0x50 && in.data[1] == 0x00 && in.checkCRC()) {
+				_state = Halt;
+				_authenticated = false;
+				leave();
+				return false;
+			}
+			result = process(in, out);
+			break;
+		case Protocol:
+			result = process(in, out);
+			break;
+		default:
+			return false;				// IDLE and HALT only answer REQA/WUPA
+	}
+	if (result == Fail) {
+		fail();
+	}
+	return result == Reply;
+}
+
+void SimPicc::cascadeBytes(uint8_t level, uint8_t *bytes) const {
+	uint8_t levels = cascadeLevels();
+	if (level + 1 < levels) {
+		bytes[0] = 0x88;				// Cascade tag
+		memcpy(&bytes[1], &_uid[level * 3], 3);
+	}
+	else {
+		memcpy(bytes, &_uid[level * 3], 4);
+	}
+	bytes[4] = bytes[0] ^ bytes[1] ^ bytes[2] ^ bytes[3];
+}
+
+SimPicc::Result SimPicc::anticollision(const SimFrame &in, SimFrame &out) {
+	if (in.bits < 16 || in.data[0] != 0x93 + 2 * _level) {
+		return Fail;
+	}
+	uint8_t cascade[5];
+	cascadeBytes(_level, cascade);
+	uint8_t nvb = in.data[1];
+
+	if (nvb == 0x70) {					// SELECT
+		if (in.bits != 9 * 8 || !in.checkCRC() || memcmp(&in.data[2], cascade, 5) != 0) {
+			return Fail;
+		}
+		if (_level + 1 < cascadeLevels()) {
+			_level++;
+			out.set(reinterpret_cast<const uint8_t *>("\x04"), 1);	// Cascade bit, UID not complete
+		}
+		else {
+			_state = Active;
+			out.set(&_sak, 1);
+		}
+		out.appendCRC();
+		return Reply;
+	}
+
+	// ANTICOLLISION: answer the bits of UID CLn after the ones the PCD knows, if those match
+	uint16_t known = ((nvb >> 4) - 2) * 8 + (nvb & 0x0F);
+	if (known > 40 || in.bits != 16 + known) {
+		return Fail;
+	}
+	for (uint16_t bit = 0; bit < known; bit++) {
+		bool sent = (in.data[2 + bit / 8] >> (bit % 8)) & 1;
+		bool mine = (cascade[bit / 8] >> (bit % 8)) & 1;
+		if (sent != mine) {
+			return Silent;
+		}
+	}
+	memset(out.data, 0, 5);
+	for (uint16_t bit = known; bit < 40; bit++) {
+		uint16_t index = bit - known;
+		if ((cascade[bit / 8] >> (bit % 8)) & 1) {
+			out.data[index / 8] |= 1 << (index % 8);
+		}
+	}
+	out.bits = 40 - known;
+	return Reply;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// SimMifareClassic
+/////////////////////////////////////////////////////////////////////////////////////
+
+SimMifareClassic::SimMifareClassic(const uint8_t *uid, uint8_t uidSize, bool is4K, bool magic)
+		: SimPicc(uid, uidSize, (uint16_t)((uidSize == 7 ? 0x0040 : 0x0000) | (is4K ? 0x0002 : 0x0004)), is4K ? 0x18 : 0x08),
+		  _memory(is4K ? 4096 : 1024, 0), _magic(magic), _backdoor(0), _authBlock(0), _authKeyB(false),
+		  _pendingCommand(0), _pendingBlock(0), _transferValid(false), _transferValue(0), _transferAddress(0) {
+	// Manufacturer block: UID, BCC for 4 byte UIDs, SAK, ATQA
+	uint8_t *manufacturer = block(0);
+	memcpy(manufacturer, uid, uidSize);
+	uint8_t offset = uidSize;
+	if (uidSize == 4) {
+		manufacturer[4] = uid[0] ^ uid[1] ^ uid[2] ^ uid[3];
+		offset = 5;
+	}
+	manufacturer[offset] = _sak;
+	manufacturer[offset + 1] = _atqa & 0xFF;
+	manufacturer[offset + 2] = _atqa >> 8;
+	// Transport configuration: keys FF..FF, access bits FF 07 80, GPB 69
+	static const uint8_t trailer[16] = {
+		0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x07, 0x80, 0x69, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+	};
+	for (uint16_t b = 0; b < blocks(); b++) {
+		if (trailerOf(b) == b) {
+			memcpy(block(b), trailer, 16);
+		}
+	}
+}
+
+void SimMifareClassic::leave() {
+	_backdoor = 0;
+	_pendingCommand = 0;
+	_transferValid = false;
+}
+
+uint8_t SimMifareClassic::sectorOf(uint8_t blockAddr) const {
+	return blockAddr < 128 ? blockAddr / 4 : 32 + (blockAddr - 128) / 16;
+}
+
+uint8_t SimMifareClassic::trailerOf(uint8_t blockAddr) const {
+	return blockAddr < 128 ? (blockAddr | 0x03) : blockAddr - (blockAddr - 128) % 16 + 15;
+}
+
+uint8_t SimMifareClassic::accessBits(uint8_t blockAddr) const {
+	uint8_t group;
+	if (blockAddr < 128) {
+		group = blockAddr % 4;
+	}
+	else {
+		uint8_t offset = (blockAddr - 128) % 16;
+		group = offset == 15 ? 3 : offset / 5;
+	}
+	const uint8_t *trailer = &_memory[trailerOf(blockAddr) * 16];
+	uint8_t c1 = (trailer[7] >> (4 + group)) & 1;
+	uint8_t c2 = (trailer[8] >> group) & 1;
+	uint8_t c3 = (trailer[8] >> (4 + group)) & 1;
+	return (c1 << 2) | (c2 << 1) | c3;
+}
+
+bool SimMifareClassic::keyBReadable(uint8_t blockAddr) const {
+	uint8_t bits = accessBits(trailerOf(blockAddr));
+	return bits == 0 || bits == 2 || bits == 1;
+}
+
+/**
+ * Access conditions for data blocks, MF1S50 datasheet table 8.
+ */
+bool SimMifareClassic::allowed(uint8_t blockAddr, Access access) const {
+	if (_backdoor == 2) {
+		return true;
+	}
+	if (_authKeyB && keyBReadable(blockAddr)) {
+		return false;					// Key B is data then, it cannot grant access
+	}
+	bool a = !_authKeyB;
+	switch (accessBits(blockAddr)) {
+		case 0: return true;
+		case 2: return access == AccessRead;
+		case 4: return access == AccessRead || (access == AccessWrite && !a);
+		case 6: return access == AccessRead || access == AccessDecrement || !a;
+		case 1: return access == AccessRead || access == AccessDecrement;
+		case 3: return !a && (access == AccessRead || access == AccessWrite);
+		case 5: return !a && access == AccessRead;
+		default: return false;
+	}
+}
+
+bool SimMifareClassic::valueBlock(uint8_t blockAddr, int32_t *value) const {
+	const uint8_t *data = &_memory[blockAddr * 16];
+	for (uint8_t i = 0; i < 4; i++) {
+		if (data[i] != data[8 + i] || data[i] != (uint8_t)~data[4 + i]) {
+			return false;
+		}
+	}
+	if (data[12] != data[14] || data[13] != data[15] || data[12] != (uint8_t)~data[13]) {
+		return false;
+	}
+	*value = (int32_t)((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+	return true;
+}
+
+/**
+ * Writes the parts of a sector trailer the access conditions allow, MF1S50 datasheet table 7.
+ */
+void SimMifareClassic::writeTrailer(uint8_t blockAddr, const uint8_t *data) {
+	uint8_t *trailer = block(blockAddr);
+	if (_backdoor == 2) {
+		memcpy(trailer, data, 16);
+		return;
+	}
+	bool b = _authKeyB && !keyBReadable(blockAddr);
+	bool keys = false;
+	bool access = false;
+	switch (accessBits(blockAddr)) {
+		case 0: keys = !_authKeyB; break;
+		case 4: keys = b; break;
+		case 1: keys = access = !_authKeyB; break;
+		case 3: keys = access = b; break;
+		case 5: access = b; break;
+		default: break;
+	}
+	if (keys) {
+		memcpy(trailer, data, 6);
+		memcpy(trailer + 10, data + 10, 6);
+	}
+	if (access) {
+		memcpy(trailer + 6, data + 6, 4);
+	}
+}
+
+bool SimMifareClassic::authenticate(uint8_t command, uint8_t blockAddr, const uint8_t *key, const uint8_t *uid) {
+	if (_state != Active || memcmp(uid, &_uid[_uidSize - 4], 4) != 0) {
+		return false;
+	}
+	if (blockAddr >= blocks() || (command != 0x60 && command != 0x61)) {
+		fail();
+		return false;
+	}
+	const uint8_t *trailer = block(trailerOf(blockAddr));
+	if (memcmp(key, command == 0x60 ? trailer : trailer + 10, 6) != 0) {
+		fail();
+		return false;
+	}
+	_authenticated = true;
+	_authBlock = blockAddr;
+	_authKeyB = command == 0x61;
+	_pendingCommand = 0;
+	return true;
+}
+
+bool SimMifareClassic::intercept(const SimFrame &in, SimFrame &out) {
+	if (!_magic) {
+		return false;
+	}
+	if (in.bits == 7 && (in.data[0] & 0x7F) == 0x40) {
+		_backdoor = 1;
+		ack(out);
+		return true;
+	}
+	if (_backdoor == 1 && in.bits == 8 && in.data[0] == 0x43) {
+		_backdoor = 2;
+		_state = Active;
+		_authenticated = false;
+		ack(out);
+		return true;
+	}
+	return false;
+}
+
+SimMifareClassic::Result SimMifareClassic::process(const SimFrame &in, SimFrame &out) {
+	if (!_authenticated && _backdoor != 2) {
+		return Fail;
+	}
+	if (!in.checkCRC()) {
+		ack(out, 0x01);					// NAK: parity or CRC error
+		return Reply;
+	}
+	const uint8_t *data = in.data;
+	uint8_t command = _pendingCommand;
+
+	// Second step of a two step command
+	if (command) {
+		_pendingCommand = 0;
+		uint8_t blockAddr = _pendingBlock;
+		if (command == 0xA0) {
+			if (in.bits != 18 * 8) {
+				return Fail;
+			}
+			if (trailerOf(blockAddr) == blockAddr) {
+				writeTrailer(blockAddr, data);
+			}
+			else {
+				memcpy(block(blockAddr), data, 16);
+				if (blockAddr == 0 && _backdoor == 2) {
+					memcpy(_uid, data, _uidSize);		// The new UID answers from the next anticollision on
+				}
+			}
+			ack(out);
+			out.delayMicros = 2500;
+			return Reply;
+		}
+		if (in.bits != 6 * 8) {
+			return Fail;
+		}
+		int32_t value;
+		valueBlock(blockAddr, &value);
+		int32_t operand = (int32_t)((uint32_t)data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24));
+		if (command == 0xC1) {
+			value += operand;
+		}
+		else if (command == 0xC0) {
+			value -= operand;
+		}
+		_transferValue = value;
+		_transferAddress = block(blockAddr)[12];
+		_transferValid = true;
+		return Silent;					// No answer, the PCD waits for the timeout
+	}
+
+	uint8_t blockAddr = data[1];
+	if (in.bits != 4 * 8 || blockAddr >= blocks() ||
+			(_backdoor != 2 && sectorOf(blockAddr) != sectorOf(_authBlock))) {
+		ack(out, 0x04);					// NAK: not allowed
+		fail();
+		return Reply;
+	}
+	bool trailer = trailerOf(blockAddr) == blockAddr;
+	int32_t value;
+	switch (data[0]) {
+		case 0x30:						// READ
+			if (!trailer && !allowed(blockAddr, AccessRead)) {
+				break;
+			}
+			out.set(block(blockAddr), 16);
+			if (trailer && _backdoor != 2) {
+				memset(out.data, 0, 6);						// Key A is never readable
+				if (_authKeyB || !keyBReadable(blockAddr)) {
+					memset(out.data + 10, 0, 6);
+				}
+			}
+			out.appendCRC();
+			return Reply;
+		case 0xA0:						// WRITE
+			if (blockAddr == 0 && _backdoor != 2) {
+				break;
+			}
+			if (!trailer && !allowed(blockAddr, AccessWrite)) {
+				break;
+			}
+			_pendingCommand = 0xA0;
+			_pendingBlock = blockAddr;
+			ack(out);
+			return Reply;
+		case 0xC0:						// DECREMENT
+		case 0xC1:						// INCREMENT
+		case 0xC2:						// RESTORE
+			if (trailer || !valueBlock(blockAddr, &value) ||
+					!allowed(blockAddr, data[0] == 0xC1 ? AccessIncrement : AccessDecrement)) {
+				break;
+			}
+			_pendingCommand = data[0];
+			_pendingBlock = blockAddr;
+			ack(out);
+			return Reply;
+		case 0xB0:						// TRANSFER
+			if (trailer || !_transferValid || !allowed(blockAddr, AccessDecrement)) {
+				break;
+			}
+			{
+				uint8_t *target = block(blockAddr);
+				uint32_t v = (uint32_t)_transferValue;
+				for (uint8_t i = 0; i < 4; i++) {
+					target[i] = target[8 + i] = (v >> (8 * i)) & 0xFF;
+					target[4 + i] = ~target[i];
+				}
+				target[12] = target[14] = _transferAddress;
+				target[13] = target[15] = ~_transferAddress;
+			}
+			_transferValid = false;
+			ack(out);
+			out.delayMicros = 2500;
+			return Reply;
+		default:
+			break;
+	}
+	ack(out, 0x04);
+	fail();
+	return Reply;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// SimUltralight
+/////////////////////////////////////////////////////////////////////////////////////
+
+SimUltralight::SimUltralight(const uint8_t *uid, Type type)
+		: SimPicc(uid, 7, 0x0044, 0x00), _type(type), _pendingPage(0xFF), _passwordOk(false) {
+	static const uint16_t sizes[] = { 16, 45, 135, 231 };
+	static const uint8_t capability[] = { 0x00, 0x12, 0x3E, 0x6D };
+	_memory.assign(sizes[type] * 4, 0);
+	uint8_t *p = page(0);
+	memcpy(p, uid, 3);
+	p[3] = 0x88 ^ uid[0] ^ uid[1] ^ uid[2];
+	memcpy(p + 4, uid + 3, 4);
+	p[8] = uid[3] ^ uid[4] ^ uid[5] ^ uid[6];
+	if (type != Ultralight) {
+		p[9] = 0x48;
+		p[12] = 0xE1;					// NFC Forum capability container
+		p[13] = 0x10;
+		p[14] = capability[type];
+		uint8_t *config = page(configPage());
+		config[3] = 0xFF;				// AUTH0: no password protection
+		memset(page(configPage() + 2), 0xFF, 4);	// PWD
+	}
+}
+
+void SimUltralight::setPassword(const uint8_t *password, const uint8_t *pack, uint8_t auth0, bool protectRead) {
+	if (_type == Ultralight) {
+		return;
+	}
+	page(configPage())[3] = auth0;
+	page(configPage() + 1)[0] = protectRead ? 0x80 : 0x00;
+	memcpy(page(configPage() + 2), password, 4);
+	memcpy(page(configPage() + 3), pack, 2);
+}
+
+void SimUltralight::leave() {
+	_pendingPage = 0xFF;
+	_passwordOk = false;
+}
+
+bool SimUltralight::protectedPage(uint8_t pageAddr, bool write) const {
+	if (_type == Ultralight || _passwordOk) {
+		return false;
+	}
+	uint8_t auth0 = _memory[configPage() * 4 + 3];
+	bool readProtection = _memory[(configPage() + 1) * 4] & 0x80;
+	return pageAddr >= auth0 && (write || readProtection);
+}
+
+bool SimUltralight::hiddenPage(uint8_t pageAddr) const {
+	return _type != Ultralight && pageAddr >= configPage() + 2;		// PWD and PACK read as 0
+}
+
+bool SimUltralight::writePage(uint8_t pageAddr, const uint8_t *data) {
+	if (pageAddr < 2 || pageAddr >= pages() || protectedPage(pageAddr, true)) {
+		return false;
+	}
+	uint8_t *p = page(pageAddr);
+	// Static lock bits: lock 0 bits 3..7 for pages 3..7, lock 1 for pages 8..15
+	if (pageAddr >= 3 && pageAddr < 16) {
+		uint8_t lock = pageAddr < 8 ? _memory[10] : _memory[11];
+		if (lock & (1 << (pageAddr < 8 ? pageAddr : pageAddr - 8))) {
+			return false;
+		}
+	}
+	if (pageAddr == 2) {
+		p[2] |= data[2];				// Lock bits can only be set
+		p[3] |= data[3];
+	}
+	else if (pageAddr == 3) {
+		for (uint8_t i = 0; i < 4; i++) {
+			p[i] |= data[i];			// One time programmable
+		}
+	}
+	else {
+		memcpy(p, data, 4);
+	}
+	return true;
+}
+
+SimUltralight::Result SimUltralight::process(const SimFrame &in, SimFrame &out) {
+	if (!in.checkCRC()) {
+		ack(out, 0x01);
+		return Reply;
+	}
+	const uint8_t *data = in.data;
+	uint16_t length = in.size() - 2;
+
+	if (_pendingPage != 0xFF) {			// Second step of COMPATIBILITY WRITE
+		uint8_t pageAddr = _pendingPage;
+		_pendingPage = 0xFF;
+		if (length != 16 || !writePage(pageAddr, data)) {
+			ack(out, 0x00);
+			return Reply;
+		}
+		ack(out);
+		out.delayMicros = 4100;
+		return Reply;
+	}
+
+	switch (data[0]) {
+		case 0x30:						// READ, 4 pages with roll over
+			if (length != 2 || data[1] >= pages() || protectedPage(data[1], false)) {
+				break;
+			}
+			out.bits = 0;
+			for (uint8_t i = 0; i < 4; i++) {
+				uint8_t pageAddr = (data[1] + i) % pages();
+				for (uint8_t j = 0; j < 4; j++) {
+					out.append(hiddenPage(pageAddr) ? 0 : _memory[pageAddr * 4 + j]);
+				}
+			}
+			out.appendCRC();
+			return Reply;
+		case 0x3A:						// FAST_READ
+			if (_type == Ultralight || length != 3 || data[1] > data[2] || data[2] >= pages() || (data[2] - data[1] + 1) * 4 > SimFrame::SIZE - 2) {
+				break;
+			}
+			out.bits = 0;
+			for (uint16_t pageAddr = data[1]; pageAddr <= data[2]; pageAddr++) {
+				for (uint8_t j = 0; j < 4; j++) {
+					out.append(hiddenPage(pageAddr) ? 0 : _memory[pageAddr * 4 + j]);
+				}
+			}
+			out.appendCRC();
+			return Reply;
+		case 0xA2:						// WRITE
+			if (length != 6 || !writePage(data[1], &data[2])) {
+				break;
+			}
+			ack(out);
+			out.delayMicros = 4100;
+			return Reply;
+		case 0xA0:						// COMPATIBILITY WRITE
+			if (length != 2 || data[1] < 2 || data[1] >= pages()) {
+				break;
+			}
+			_pendingPage = data[1];
+			ack(out);
+			return Reply;
+		case 0x60:						// GET_VERSION
+			if (_type == Ultralight || length != 1) {
+				return Fail;
+			}
+			{
+				static const uint8_t storage[] = { 0x00, 0x0F, 0x11, 0x13 };
+				const uint8_t version[8] = { 0x00, 0x04, 0x04, 0x02, 0x01, 0x00, storage[_type], 0x03 };
+				out.set(version, 8);
+			}
+			out.appendCRC();
+			return Reply;
+		case 0x1B:						// PWD_AUTH
+			if (_type == Ultralight || length != 5) {
+				return Fail;
+			}
+			if (memcmp(&data[1], page(configPage() + 2), 4) != 0) {
+				ack(out, 0x04);
+				fail();
+				return Reply;
+			}
+			_passwordOk = true;
+			out.set(page(configPage() + 3), 2);
+			out.appendCRC();
+			return Reply;
+		default:
+			return Fail;
+	}
+	ack(out, 0x00);						// NAK: invalid argument
+	return Reply;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// SimIsoDep: ISO/IEC 14443-4
+/////////////////////////////////////////////////////////////////////////////////////
+
+SimIsoDep::SimIsoDep(const uint8_t *uid, uint8_t uidSize, Responder responder)
+		: SimPicc(uid, uidSize, (uint16_t)(uidSize == 7 ? 0x0344 : 0x0304), 0x20), _responder(responder),
+		  _processingMicros(0), _cid(0), _cidSupported(true), _fsd(16), _blockNumber(true), _ppsAllowed(false),
+		  _bitRates(0), _cidInBlock(false), _responseOffset(0) {
+	static const uint8_t desfire[] = { 0x06, 0x75, 0x77, 0x81, 0x02, 0x80 };
+	setATS(desfire, sizeof(desfire));
+}
+
+void SimIsoDep::setATS(const uint8_t *ats, uint8_t size) {
+	_ats.assign(ats, ats + size);
+	// TC1 follows TA1 and TB1 if present, bit 2 of TC1 is "CID supported"
+	uint8_t t0 = size > 1 ? ats[1] : 0;
+	uint8_t index = 2 + ((t0 & 0x10) ? 1 : 0) + ((t0 & 0x20) ? 1 : 0);
+	_cidSupported = (t0 & 0x40) && index < size && (ats[index] & 0x02);
+}
+
+void SimIsoDep::leave() {
+	_command.clear();
+	_response.clear();
+	_responseOffset = 0;
+	_ppsAllowed = false;
+	_last.bits = 0;
+}
+
+SimIsoDep::Result SimIsoDep::process(const SimFrame &in, SimFrame &out) {
+	if (_state == Active) {
+		return rats(in, out);
+	}
+	if (!in.checkCRC()) {
+		return Silent;					// Transmission error, the PCD recovers with R(NAK)
+	}
+	if ((in.data[0] & 0xF0) == 0xD0 && _ppsAllowed) {
+		// PPS: PPSS, PPS0, optional PPS1
+		if ((in.data[0] & 0x0F) != _cid) {
+			return Silent;
+		}
+		if ((in.data[1] & 0x10) && in.size() == 5) {
+			_bitRates = in.data[2];
+		}
+		_ppsAllowed = false;
+		out.set(in.data, 1);
+		out.appendCRC();
+		return Reply;
+	}
+	_ppsAllowed = false;
+	return block(in, out);
+}
+
+SimIsoDep::Result SimIsoDep::rats(const SimFrame &in, SimFrame &out) {
+	if (in.bits != 4 * 8 || in.data[0] != 0xE0 || !in.checkCRC()) {
+		return Fail;
+	}
+	static const uint16_t fsdTable[] = { 16, 24, 32, 40, 48, 64, 96, 128, 256 };
+	uint8_t fsdi = in.data[1] >> 4;
+	_fsd = fsdTable[fsdi < 8 ? fsdi : 8];
+	_cid = in.data[1] & 0x0F;
+	_blockNumber = true;				// Rule B: the PICC block number is 1 after activation
+	_ppsAllowed = true;
+	_bitRates = 0;
+	_state = Protocol;
+	out.set(_ats.data(), (uint16_t)_ats.size());
+	out.appendCRC();
+	return Reply;
+}
+
+void SimIsoDep::prologue(SimFrame &out, uint8_t pcb) {
+	out.bits = 0;
+	out.append(pcb | (_cidInBlock ? 0x08 : 0x00));
+	if (_cidInBlock) {
+		out.append(_cid);
+	}
+}
+
+void SimIsoDep::nextResponseBlock(SimFrame &out) {
+	uint16_t room = _fsd - 3 - (_cidInBlock ? 1 : 0);		// PCB, CRC_A and CID
+	size_t left = _response.size() - _responseOffset;
+	bool chaining = left > room;
+	size_t size = chaining ? room : left;
+	prologue(out, (chaining ? 0x12 : 0x02) | (_blockNumber ? 0x01 : 0x00));
+	for (size_t i = 0; i < size; i++) {
+		out.append(_response[_responseOffset + i]);
+	}
+	_responseOffset += size;
+	out.appendCRC();
+	_last = out;
+}
+
+SimIsoDep::Result SimIsoDep::block(const SimFrame &in, SimFrame &out) {
+	uint16_t length = in.size() - 2;
+	uint8_t pcb = in.data[0];
+	uint16_t offset = 1;
+	_cidInBlock = pcb & 0x08;
+	if (_cidInBlock) {
+		if (length < 2 || !_cidSupported || (in.data[1] & 0x0F) != _cid) {
+			return Silent;				// Addressed to another PICC
+		}
+		offset++;
+	}
+	else if (_cid != 0 && _cidSupported) {
+		return Silent;
+	}
+	if (pcb & 0x04) {
+		offset++;						// NAD
+	}
+	if (offset > length) {
+		return Silent;
+	}
+	bool blockNumber = pcb & 0x01;
+
+	if ((pcb & 0xE2) == 0x02) {			// I-block
+		if (blockNumber == _blockNumber) {
+			out = _last;				// Already answered, the answer got lost
+			return _last.bits ? Reply : Silent;
+		}
+		_blockNumber = blockNumber;		// Rule 10
+		_command.insert(_command.end(), &in.data[offset], &in.data[length]);
+		if (pcb & 0x10) {				// The PCD is chaining, acknowledge
+			prologue(out, 0xA2 | (_blockNumber ? 0x01 : 0x00));
+			out.appendCRC();
+			_last = out;
+			return Reply;
+		}
+		if (_responder) {
+			_response = _responder(_command);
+		}
+		else {
+			_response.assign(1, 0x90);
+			_response.push_back(0x00);
+		}
+		_command.clear();
+		_responseOffset = 0;
+		nextResponseBlock(out);
+		out.delayMicros = _processingMicros;
+		_last = out;
+		return Reply;
+	}
+	if ((pcb & 0xE6) == 0xA2) {			// R-block
+		bool nak = pcb & 0x10;
+		if (blockNumber == _blockNumber) {
+			if (!_last.bits) {
+				return Silent;
+			}
+			out = _last;				// Rules 11 and 12: send the last block again
+			return Reply;
+		}
+		if (nak) {
+			prologue(out, 0xA2 | (_blockNumber ? 0x01 : 0x00));	// Rule 12: R(ACK), no toggle
+			out.appendCRC();
+			return Reply;
+		}
+		_blockNumber = blockNumber;		// Rule 10
+		if (_responseOffset >= _response.size()) {
+			return Silent;				// Nothing to chain
+		}
+		nextResponseBlock(out);
+		return Reply;
+	}
+	if ((pcb & 0xF7) == 0xC2) {			// S(DESELECT)
+		prologue(out, 0xC2);
+		out.appendCRC();
+		_state = Halt;
+		_authenticated = false;
+		leave();
+		return Reply;
+	}
+	return Silent;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Factory
+/////////////////////////////////////////////////////////////////////////////////////
+
+SimPicc *SimPicc::create(const char *type, const uint8_t *uid, uint8_t uidSize) {
+	static const uint8_t uid4[] = { 0xDE, 0xAD, 0xBE, 0xEF };
+	static const uint8_t uid7[] = { 0x04, 0x6B, 0x2A, 0x3C, 0x91, 0x5E, 0x80 };
+	bool classic = !strcmp(type, "classic1k") || !strcmp(type, "classic4k") || !strcmp(type, "magic1k");
+	if (!uid || uidSize == 0) {
+		uid = classic ? uid4 : uid7;
+		uidSize = classic ? 4 : 7;
+	}
+	if (uidSize != 4 && uidSize != 7 && uidSize != 10) {
+		return nullptr;
+	}
+	if (classic) {
+		return uidSize == 10 ? nullptr : new SimMifareClassic(uid, uidSize, !strcmp(type, "classic4k"), !strcmp(type, "magic1k"));
+	}
+	if (!strcmp(type, "ultralight") || !strcmp(type, "ntag213") || !strcmp(type, "ntag215") || !strcmp(type, "ntag216")) {
+		SimUltralight::Type ultralight = !strcmp(type, "ultralight") ? SimUltralight::Ultralight :
+				!strcmp(type, "ntag213") ? SimUltralight::NTAG213 :
+				!strcmp(type, "ntag215") ? SimUltralight::NTAG215 : SimUltralight::NTAG216;
+		return uidSize == 7 ? new SimUltralight(uid, ultralight) : nullptr;
+	}
+	if (!strcmp(type, "isodep")) {
+		return new SimIsoDep(uid, uidSize);
+	}
+	return nullptr;
+}
@@ -0,0 +1,197 @@
+/**
+ * Virtual PICCs for the host simulator, see MFRC522Sim.h.
+ *
+ * SimPicc implements the ISO/IEC 14443-3 type A states (IDLE, READY, ACTIVE, HALT), REQA/WUPA,
+ * anticollision and SELECT over up to three cascade levels, and HLTA. Subclasses answer the frames
+ * of the ACTIVE state:
+ * - SimMifareClassic: MIFARE Classic 1K/4K with authentication, access conditions, value blocks and
+ *   optionally the UID backdoor of "magic" cards.
+ * - SimUltralight: MIFARE Ultralight and NTAG213/215/216 with READ, WRITE, COMPATIBILITY WRITE,
+ *   GET_VERSION, FAST_READ and PWD_AUTH.
+ * - SimIsoDep: ISO/IEC 14443-4 PICC with RATS, PPS, block numbering, chaining in both directions,
+ *   R(NAK)/R(ACK) recovery and DESELECT. APDUs go to a responder function.
+ *
+ * Released into the public domain.
+ */
+#ifndef SimPicc_h
+#define SimPicc_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <vector>
+
+// A frame on the RF interface, bits in transmission order: LSB of data[0] first
+struct SimFrame {
+	static constexpr uint16_t SIZE = 272;	// FSD 256 plus prologue and CRC_A
+
+	uint8_t		data[SIZE];
+	uint16_t	bits;
+	uint32_t	delayMicros;				// Processing time of the PICC added to the frame delay time
+
+	SimFrame() : bits(0), delayMicros(0) {}
+	uint16_t size() const { return (bits + 7) / 8; }
+	void set(const uint8_t *bytes, uint16_t count);
+	void setBits(uint8_t value, uint8_t count);		// Short frame or 4 bit ACK/NAK
+	void append(uint8_t value);
+	void appendCRC();								// Appends CRC_A over the frame
+	bool checkCRC() const;							// Whole bytes ending with a valid CRC_A
+	static uint16_t crc(const uint8_t *bytes, uint16_t count);
+};
+
+class SimPicc {
+public:
+	enum State : uint8_t { Off, Idle, Ready, Active, Halt, Protocol };
+
+	SimPicc(const uint8_t *uid, uint8_t uidSize, uint16_t atqa, uint8_t sak);
+	virtual ~SimPicc() {}
+
+	// A PICC by name: classic1k, classic4k, magic1k, ultralight, ntag213, ntag215, ntag216 or isodep. Without uid
+	// DEADBEEF for MIFARE Classic and 046B2A3C915E80 for the others. nullptr if the type or UID size is not supported.
+	static SimPicc *create(const char *type, const uint8_t *uid = nullptr, uint8_t uidSize = 0);
+
+	// Handles a frame sent while the PICC is in the field. Returns false if it stays silent.
+	bool transceive(const SimFrame &in, bool encrypted, SimFrame &out);
+	// MFAuthent of the MFRC522: true if the PICC is ACTIVE, the UID matches and the key is right
+	virtual bool authenticate(uint8_t command, uint8_t block, const uint8_t *key, const uint8_t *uid);
+	void powerOn();
+	void powerOff();
+
+	State state() const { return _state; }
+	const uint8_t *uid() const { return _uid; }
+	uint8_t uidSize() const { return _uidSize; }
+	bool authenticated() const { return _authenticated; }
+
+protected:
+	enum Result : uint8_t {
+		Reply,			// Send out
+		Silent,			// No answer, stay in the state
+		Fail			// No answer, back to IDLE or HALT
+	};
+
+	State _state;
+	uint8_t _uid[10];
+	uint8_t _uidSize;
+	uint16_t _atqa;
+	uint8_t _sak;
+	uint8_t _level;				// Cascade level during anticollision, 0 to 2
+	bool _halted;				// Woken up from HALT, errors go back to HALT
+	bool _authenticated;		// Crypto1 session running
+
+	// Frames of the ACTIVE and PROTOCOL state
+	virtual Result process(const SimFrame &in, SimFrame &out) = 0;
+	// Plain frames the PICC answers in every state, e.g. the backdoor of magic cards. Returns true if handled.
+	virtual bool intercept(const SimFrame &in, SimFrame &out) { (void)in; (void)out; return false; }
+	// The PICC lost its session: power off, HLTA or an error
+	virtual void leave() {}
+	void fail();
+	static void ack(SimFrame &out, uint8_t nibble = 0x0A);
+
+private:
+	uint8_t cascadeLevels() const { return _uidSize == 4 ? 1 : (_uidSize == 7 ? 2 : 3); }
+	void cascadeBytes(uint8_t level, uint8_t *bytes) const;		// The 5 bytes UID CLn including BCC
+	Result anticollision(const SimFrame &in, SimFrame &out);
+};
+
+class SimMifareClassic : public SimPicc {
+public:
+	// 4 or 7 byte UID; 1K has 16 sectors of 4 blocks, 4K 32 of 4 and 8 of 16 blocks
+	SimMifareClassic(const uint8_t *uid, uint8_t uidSize, bool is4K = false, bool magic = false);
+
+	uint8_t *block(uint8_t blockAddr) { return &_memory[blockAddr * 16]; }
+	uint16_t blocks() const { return (uint16_t)(_memory.size() / 16); }
+	bool authenticate(uint8_t command, uint8_t block, const uint8_t *key, const uint8_t *uid) override;
+
+protected:
+	Result process(const SimFrame &in, SimFrame &out) override;
+	bool intercept(const SimFrame &in, SimFrame &out) override;
+	void leave() override;
+
+private:
+	enum Access : uint8_t { AccessRead, AccessWrite, AccessIncrement, AccessDecrement };
+
+	std::vector<uint8_t> _memory;
+	bool _magic;
+	uint8_t _backdoor;				// 1 after 0x40, 2 after 0x43 of the UID backdoor
+	uint8_t _authBlock;				// Block the authentication was for
+	bool _authKeyB;
+	uint8_t _pendingCommand;		// Second step of WRITE, INCREMENT, DECREMENT, RESTORE
+	uint8_t _pendingBlock;
+	bool _transferValid;
+	int32_t _transferValue;			// Transfer buffer of the value operations
+	uint8_t _transferAddress;
+
+	uint8_t sectorOf(uint8_t blockAddr) const;
+	uint8_t trailerOf(uint8_t blockAddr) const;
+	uint8_t accessBits(uint8_t blockAddr) const;	// C1 C2 C3 of the block as bits 2..0
+	bool allowed(uint8_t blockAddr, Access access) const;
+	bool keyBReadable(uint8_t blockAddr) const;
+	bool valueBlock(uint8_t blockAddr, int32_t *value) const;
+	void writeTrailer(uint8_t blockAddr, const uint8_t *data);
+};
+
+class SimUltralight : public SimPicc {
+public:
+	enum Type : uint8_t { Ultralight, NTAG213, NTAG215, NTAG216 };
+
+	SimUltralight(const uint8_t *uid, Type type = Ultralight);
+
+	uint8_t *page(uint8_t pageAddr) { return &_memory[pageAddr * 4]; }
+	uint16_t pages() const { return (uint16_t)(_memory.size() / 4); }
+	void setPassword(const uint8_t *password, const uint8_t *pack, uint8_t auth0, bool protectRead);
+
+protected:
+	Result process(const SimFrame &in, SimFrame &out) override;
+	void leave() override;
+
+private:
+	Type _type;
+	std::vector<uint8_t> _memory;
+	uint8_t _pendingPage;			// Second step of COMPATIBILITY WRITE, 0xFF if none
+	bool _passwordOk;
+
+	uint16_t configPage() const { return pages() - 4; }		// CFG0 of NTAG, AUTH0 in byte 3
+	bool protectedPage(uint8_t pageAddr, bool write) const;
+	bool hiddenPage(uint8_t pageAddr) const;
+	bool writePage(uint8_t pageAddr, const uint8_t *data);
+};
+
+class SimIsoDep : public SimPicc {
+public:
+	typedef std::function<std::vector<uint8_t>(const std::vector<uint8_t> &apdu)> Responder;
+
+	// The default ATS is the one of a MIFARE DESFire EV1: FSC 64, all bit rates, FWI 8, CID supported
+	SimIsoDep(const uint8_t *uid, uint8_t uidSize = 7, Responder responder = Responder());
+
+	void setATS(const uint8_t *ats, uint8_t size);		// ats[0] is TL
+	void setResponder(Responder responder) { _responder = responder; }
+	void setProcessingMicros(uint32_t micros) { _processingMicros = micros; }
+	uint8_t bitRates() const { return _bitRates; }		// PPS1 accepted last, DSI in bits 3..2, DRI in bits 1..0
+
+protected:
+	Result process(const SimFrame &in, SimFrame &out) override;
+	void leave() override;
+
+private:
+	std::vector<uint8_t> _ats;
+	Responder _responder;
+	uint32_t _processingMicros;
+	uint8_t _cid;
+	bool _cidSupported;
+	uint16_t _fsd;					// Frame size the PCD accepts, from RATS
+	bool _blockNumber;
+	bool _ppsAllowed;
+	uint8_t _bitRates;
+	bool _cidInBlock;				// The last block carried a CID, answers carry it too
+	std::vector<uint8_t> _command;	// APDU received so far with chaining
+	std::vector<uint8_t> _response;	// APDU answer not yet sent
+	size_t _responseOffset;
+	SimFrame _last;					// Last block sent, for retransmission
+
+	Result rats(const SimFrame &in, SimFrame &out);
+	Result block(const SimFrame &in, SimFrame &out);
+	void prologue(SimFrame &out, uint8_t pcb);
+	void nextResponseBlock(SimFrame &out);
+};
+
+#endif
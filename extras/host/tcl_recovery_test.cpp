@@ -0,0 +1,65 @@
+/**
+ * Tests of the ISO/IEC 14443-4 error recovery against the simulated MFRC522, see extras/host/README.rst.
+ *
+ *   ./tcl_recovery_test
+ *
+ * An ISO/IEC 14443-4 PICC is activated with PICC_Activate(), so the MFRC522 checks the CRC_A (RxCRCEn). Then
+ * answers of the PICC are corrupted and TCL_Transceive() has to recover with R(NAK). Exits with 1 if a check fails.
+ *
+ * Released into the public domain.
+ */
+#include <Arduino.h>
+#include <SPI.h>
+#include <MFRC522.h>
+#include <MFRC522Extended.h>
+#include <stdio.h>
+#include "MFRC522Sim.h"
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+	printf("%s: %s\n", condition ? "ok  " : "FAIL", what);
+	if (!condition) {
+		failures++;
+	}
+}
+
+} // namespace
+
+void setup() {}
+void loop() {}
+
+int main() {
+	static byte apdu[] = { 0x00, 0xA4, 0x04, 0x00, 0x07, 0xD2, 0x76, 0x00, 0x00, 0x85, 0x01, 0x01, 0x00 };
+	MFRC522Sim chip(10, 9, MFRC522Sim::UNUSED_PIN);
+	chip.addPicc(SimPicc::create("isodep"));
+	SPI.begin();
+	MFRC522Extended reader(10, 9);
+	reader.PCD_Init();
+
+	MFRC522Extended::TagInfo tag;
+	check(reader.PICC_Activate(&tag, 1) == MFRC522::STATUS_OK, "PICC_Activate()");
+	check(reader.PCD_ReadField<MFRC522::RxModeReg_RxCRCEn>(), "The MFRC522 checks the CRC_A");
+
+	// Every second answer has a bit error: the first I-Block is answered, from the second on each I-Block gets a
+	// corrupted answer and the answer to the R(NAK) is good
+	chip.setCrcNoise(2);
+	const uint16_t exchanges = 4;
+	bool answered = true;
+	for (uint16_t i = 0; i < exchanges; i++) {
+		byte response[64];
+		byte responseSize = sizeof(response);
+		answered &= reader.TCL_Transceive(&tag, apdu, sizeof(apdu), response, &responseSize) == MFRC522::STATUS_OK
+				&& responseSize >= 2 && response[responseSize - 2] == 0x90 && response[responseSize - 1] == 0x00;
+	}
+	chip.setCrcNoise(0);
+	check(answered, "TCL_Transceive() returns the answers despite CRC errors");
+	check(reader.tclRecovery.recovered == exchanges - 1, "Every exchange after the first is recovered with R(NAK)");
+	check(reader.tclRecovery.failed == 0, "No exchange failed");
+	check(reader.TCL_Deselect(&tag) == MFRC522::STATUS_OK, "TCL_Deselect()");
+
+	printf("%d failed\n", failures);
+	return failures ? 1 : 0;
+}
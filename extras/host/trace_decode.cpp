@@ -0,0 +1,388 @@
+/**
+ * Decoder for the register trace of the library, see MFRC522::PCD_DumpTrace().
+ *
+ * Build the sketch with -DMFRC522_TRACE=<records>, write the trace with mfrc522.PCD_DumpTrace(Serial),
+ * capture the binary output on the PC and decode it:
+ *
+ *   g++ -std=c++11 -O2 -o trace_decode trace_decode.cpp && ./trace_decode [--frames] [trace.bin]
+ *
+ * Every register access is printed with the names of the PCD_Register, PCD_Command and PICC_Command enums
+ * and its bits decoded where it helps. From the accesses the RF frames are reconstructed: FIFO writes
+ * since the last flush, the start of Transmit/Transceive/MFAuthent, and the answer read from the FIFO,
+ * or the timer expiring. --frames only prints the frames. Traces written with -DMFRC522_TRACE_PAYLOAD=1
+ * (version 2) also carry the bytes of multi-byte accesses, they are printed after the access.
+ *
+ * Released into the public domain.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Record {
+	uint32_t micros;
+	uint8_t address;		// Bit 7 read, bits 6..1 register, bit 0 multi-byte access
+	uint8_t value;			// Value, or number of bytes of a multi-byte access
+	uint8_t first;			// First byte of a multi-byte access
+	uint8_t digest;			// CRC-8 of a multi-byte access
+	std::vector<uint8_t> payload;	// All bytes of a multi-byte access, from the continuation records of version 2
+
+	bool read() const { return address & 0x80; }
+	bool multi() const { return address & 0x01; }
+	uint8_t reg() const { return (address >> 1) & 0x3F; }
+};
+
+// Registers of chapter 9 of the datasheet, unshifted addresses
+enum : uint8_t {
+	CommandReg = 0x01, ComIrqReg = 0x04, DivIrqReg = 0x05, ErrorReg = 0x06, FIFODataReg = 0x09,
+	FIFOLevelReg = 0x0A, ControlReg = 0x0C, BitFramingReg = 0x0D, CollReg = 0x0E
+};
+
+const char *const registerNames[64] = {
+	"Reserved00", "CommandReg", "ComIEnReg", "DivIEnReg", "ComIrqReg", "DivIrqReg", "ErrorReg", "Status1Reg",
+	"Status2Reg", "FIFODataReg", "FIFOLevelReg", "WaterLevelReg", "ControlReg", "BitFramingReg", "CollReg", "Reserved0F",
+	"Reserved10", "ModeReg", "TxModeReg", "RxModeReg", "TxControlReg", "TxASKReg", "TxSelReg", "RxSelReg",
+	"RxThresholdReg", "DemodReg", "Reserved1A", "Reserved1B", "MfTxReg", "MfRxReg", "Reserved1E", "SerialSpeedReg",
+	"Reserved20", "CRCResultRegH", "CRCResultRegL", "Reserved23", "ModWidthReg", "Reserved25", "RFCfgReg", "GsNReg",
+	"CWGsPReg", "ModGsPReg", "TModeReg", "TPrescalerReg", "TReloadRegH", "TReloadRegL", "TCounterValueRegH", "TCounterValueRegL",
+	"Reserved30", "TestSel1Reg", "TestSel2Reg", "TestPinEnReg", "TestPinValueReg", "TestBusReg", "AutoTestReg", "VersionReg",
+	"AnalogTestReg", "TestDAC1Reg", "TestDAC2Reg", "TestADCReg", "Reserved3C", "Reserved3D", "Reserved3E", "Reserved3F"
+};
+
+enum : uint8_t {
+	PCD_Idle = 0x00, PCD_CalcCRC = 0x03, PCD_Transmit = 0x04, PCD_Transceive = 0x0C, PCD_MFAuthent = 0x0E
+};
+
+const char *const commandNames[16] = {
+	"PCD_Idle", "PCD_Mem", "PCD_GenerateRandomID", "PCD_CalcCRC", "PCD_Transmit", "Reserved5", "Reserved6", "PCD_NoCmdChange",
+	"PCD_Receive", "Reserved9", "ReservedA", "ReservedB", "PCD_Transceive", "ReservedD", "PCD_MFAuthent", "PCD_SoftReset"
+};
+
+struct Name {
+	uint8_t value;
+	const char *name;
+};
+
+const Name piccCommands[] = {
+	{ 0x26, "PICC_CMD_REQA" }, { 0x52, "PICC_CMD_WUPA" }, { 0x93, "PICC_CMD_SEL_CL1" }, { 0x95, "PICC_CMD_SEL_CL2" },
+	{ 0x97, "PICC_CMD_SEL_CL3" }, { 0x50, "PICC_CMD_HLTA" }, { 0xE0, "PICC_CMD_RATS" }, { 0x60, "PICC_CMD_MF_AUTH_KEY_A" },
+	{ 0x61, "PICC_CMD_MF_AUTH_KEY_B" }, { 0x30, "PICC_CMD_MF_READ" }, { 0xA0, "PICC_CMD_MF_WRITE" },
+	{ 0xC0, "PICC_CMD_MF_DECREMENT" }, { 0xC1, "PICC_CMD_MF_INCREMENT" }, { 0xC2, "PICC_CMD_MF_RESTORE" },
+	{ 0xB0, "PICC_CMD_MF_TRANSFER" }, { 0xA2, "PICC_CMD_UL_WRITE" }, { 0x40, "backdoor 0x40" }, { 0x43, "backdoor 0x43" },
+	{ 0x1B, "PWD_AUTH" }, { 0x3A, "FAST_READ" }, { 0xD0, "PPS" },
+};
+
+// Name of the first byte of a frame to the PICC. ISO/IEC 14443-4 blocks share values with MIFARE commands.
+std::string piccCommandName(uint8_t first) {
+	for (const Name &name : piccCommands) {
+		if (name.value == first) {
+			return name.name;
+		}
+	}
+	if ((first & 0xE2) == 0x02) {
+		return "I-block";
+	}
+	if ((first & 0xE6) == 0xA2) {
+		return (first & 0x10) ? "R(NAK)" : "R(ACK)";
+	}
+	if ((first & 0xC7) == 0xC2) {
+		return (first & 0x30) == 0x30 ? "S(WTX)" : "S(DESELECT)";
+	}
+	return "?";
+}
+
+std::string bitNames(uint8_t value, const char *const names[8]) {
+	std::string text;
+	for (int bit = 7; bit >= 0; bit--) {
+		if ((value & (1 << bit)) && names[bit]) {
+			text += text.empty() ? "" : " ";
+			text += names[bit];
+		}
+	}
+	return text;
+}
+
+const char *const comIrqBits[8] = { "TimerIRq", "ErrIRq", "LoAlertIRq", "HiAlertIRq", "IdleIRq", "RxIRq", "TxIRq", "Set1" };
+const char *const divIrqBits[8] = { nullptr, nullptr, "CRCIRq", nullptr, "MfinActIRq", nullptr, nullptr, "Set2" };
+const char *const errorBits[8] = { "ProtocolErr", "ParityErr", "CRCErr", "CollErr", "BufferOvfl", nullptr, "TempErr", "WrErr" };
+
+// What the register value means, empty if nothing to add
+std::string annotate(const Record &record) {
+	char text[96];
+	uint8_t value = record.value;
+	if (record.multi()) {
+		snprintf(text, sizeof(text), "%u bytes, first 0x%02X, digest 0x%02X", value, record.first, record.digest);
+		return text;
+	}
+	switch (record.reg()) {
+		case CommandReg:
+			snprintf(text, sizeof(text), "%s%s%s", commandNames[value & 0x0F], (value & 0x20) ? " RcvOff" : "",
+					(value & 0x10) ? " PowerDown" : "");
+			return text;
+		case ComIrqReg:
+			return bitNames(value & 0x7F, comIrqBits) + ((record.read() || !(value & 0x80)) ? "" : " set");
+		case DivIrqReg:
+			return bitNames(value & 0x7F, divIrqBits) + ((record.read() || !(value & 0x80)) ? "" : " set");
+		case ErrorReg:
+			return bitNames(value, errorBits);
+		case FIFOLevelReg:
+			if (!record.read()) {
+				return (value & 0x80) ? "FlushBuffer" : "";
+			}
+			snprintf(text, sizeof(text), "%u bytes in the FIFO", value & 0x7F);
+			return text;
+		case BitFramingReg:
+			snprintf(text, sizeof(text), "%sRxAlign %u, TxLastBits %u", (value & 0x80) ? "StartSend, " : "",
+					(value >> 4) & 0x07, value & 0x07);
+			return text;
+		case ControlReg:
+			snprintf(text, sizeof(text), "RxLastBits %u", value & 0x07);
+			return text;
+		case CollReg:
+			if (!record.read()) {
+				return (value & 0x80) ? "ValuesAfterColl" : "";
+			}
+			if (value & 0x20) {
+				return "CollPosNotValid";
+			}
+			snprintf(text, sizeof(text), "CollPos %u", (value & 0x1F) ? (value & 0x1F) : 32);
+			return text;
+		default:
+			return "";
+	}
+}
+
+// Follows the accesses of PCD_CommunicateWithPICC() and PCD_CalculateCRC() and prints the frames
+class FrameTracker {
+public:
+	explicit FrameTracker(bool framesOnly) : _framesOnly(framesOnly) {}
+
+	void process(const Record &r) {
+		if (!r.read()) {
+			written(r);
+		}
+		else {
+			readBack(r);
+		}
+	}
+
+private:
+	bool _framesOnly;
+	uint8_t _command = PCD_Idle;
+	uint16_t _txBytes = 0;			// FIFO content written since the last flush
+	uint8_t _txFirst = 0;
+	uint8_t _txDigest = 0;
+	uint8_t _txLastBits = 0;
+	bool _onAir = false;			// Frame sent, waiting for the end of the command
+	uint32_t _txMicros = 0;
+	uint32_t _polls = 0;
+	uint8_t _error = 0;
+	uint8_t _rxBytes = 0;
+	uint8_t _rxFirst = 0;
+	uint8_t _rxDigest = 0;
+	bool _rxPending = false;
+
+	void frame(uint32_t micros, const char *format, ...) __attribute__((format(printf, 3, 4))) {
+		va_list args;
+		va_start(args, format);
+		printf(_framesOnly ? "%10u  " : "%10u  ---- ", micros);
+		vprintf(format, args);
+		printf("\n");
+		va_end(args);
+	}
+
+	void startFrame(uint32_t micros) {
+		const char *kind = _command == PCD_MFAuthent ? "MFAuthent" : (_command == PCD_Transmit ? "TX" : "TX/RX");
+		if (_txBytes == 0) {
+			frame(micros, ">> %s, empty FIFO", kind);
+		}
+		else {
+			frame(micros, ">> %s %s: %u bytes%s, first 0x%02X, digest 0x%02X", kind,
+					piccCommandName(_txFirst).c_str(), _txBytes,
+					_txLastBits ? (std::string(", last byte ") + std::to_string(_txLastBits) + " bits").c_str() : "",
+					_txFirst, _txDigest);
+		}
+		_onAir = true;
+		_txMicros = micros;
+		_polls = 0;
+		_error = 0;
+		_rxPending = false;
+	}
+
+	void written(const Record &r) {
+		switch (r.reg()) {
+			case FIFOLevelReg:
+				if (r.value & 0x80) {
+					_txBytes = 0;
+				}
+				break;
+			case FIFODataReg:
+				if (_txBytes == 0) {
+					_txFirst = r.multi() ? r.first : r.value;
+					_txDigest = r.multi() ? r.digest : 0;
+				}
+				_txBytes += r.multi() ? r.value : 1;
+				break;
+			case BitFramingReg:
+				_txLastBits = r.value & 0x07;
+				if ((r.value & 0x80) && _command == PCD_Transceive) {
+					startFrame(r.micros);
+				}
+				break;
+			case CommandReg:
+				if ((r.value & 0x0F) == 0x07) {		// PCD_NoCmdChange
+					break;
+				}
+				_command = r.value & 0x0F;
+				if (_command == PCD_Transmit || _command == PCD_MFAuthent) {
+					startFrame(r.micros);
+				}
+				else if (_command == PCD_CalcCRC) {
+					frame(r.micros, "   CRC_A over %u bytes", _txBytes);
+				}
+				else if (_command == PCD_Idle) {
+					_onAir = false;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	void readBack(const Record &r) {
+		if (!_onAir) {
+			return;
+		}
+		switch (r.reg()) {
+			case ComIrqReg:
+				_polls++;
+				if (r.value & 0x30) {					// RxIRq or IdleIRq: the command finished
+					if (_command == PCD_MFAuthent) {
+						frame(r.micros, "<< authenticated after %u us, %u polls", r.micros - _txMicros, _polls);
+						_onAir = false;
+					}
+					_rxPending = true;
+				}
+				else if ((r.value & 0x01) && !_rxPending) {	// TimerIRq
+					frame(r.micros, "<< timeout after %u us, %u polls", r.micros - _txMicros, _polls);
+					_onAir = false;
+				}
+				break;
+			case ErrorReg:
+				_error = r.value;
+				if (_error & 0x13) {
+					frame(r.micros, "<< error %s after %u us", bitNames(_error, errorBits).c_str(), r.micros - _txMicros);
+					_onAir = false;
+				}
+				break;
+			case FIFODataReg:
+				_rxBytes = r.multi() ? r.value : 1;
+				_rxFirst = r.multi() ? r.first : r.value;
+				_rxDigest = r.multi() ? r.digest : 0;
+				break;
+			case ControlReg:
+				if (_rxPending) {
+					uint8_t lastBits = r.value & 0x07;
+					frame(r.micros, "<< %u bytes%s, first 0x%02X, digest 0x%02X%s%s after %u us, %u polls", _rxBytes,
+							lastBits ? (std::string(", last byte ") + std::to_string(lastBits) + " bits").c_str() : "",
+							_rxFirst, _rxDigest, (_error & 0x08) ? ", collision" : "",
+							(_rxBytes == 1 && lastBits == 4) ? ((_rxFirst & 0x0F) == 0x0A ? " (ACK)" : " (NAK)") : "",
+							r.micros - _txMicros, _polls);
+					_onAir = false;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+};
+
+bool readTrace(FILE *file, std::vector<Record> &records) {
+	uint8_t header[8];
+	if (fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, "MFTR", 4) != 0) {
+		fprintf(stderr, "not a trace of PCD_DumpTrace()\n");
+		return false;
+	}
+	if (header[4] < 1 || header[4] > 2 || header[5] != 8) {
+		fprintf(stderr, "unknown trace version %u or record size %u\n", header[4], header[5]);
+		return false;
+	}
+	uint16_t count = header[6] | (header[7] << 8);
+	for (uint16_t i = 0; i < count; i++) {
+		uint8_t bytes[8];
+		if (fread(bytes, 1, sizeof(bytes), file) != sizeof(bytes)) {
+			fprintf(stderr, "trace ends after %u of %u records\n", i, count);
+			return false;
+		}
+		if (bytes[4] == 0x7F) {		// Continuation: 7 more bytes of the multi-byte access before
+			if (!records.empty() && records.back().multi()) {
+				Record &access = records.back();
+				const uint8_t payload[7] = { bytes[0], bytes[1], bytes[2], bytes[3], bytes[5], bytes[6], bytes[7] };
+				for (uint8_t j = 0; j < 7 && access.payload.size() < access.value; j++) {
+					access.payload.push_back(payload[j]);
+				}
+			}
+			continue;
+		}
+		Record record;
+		record.micros = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+		record.address = bytes[4];
+		record.value = bytes[5];
+		record.first = bytes[6];
+		record.digest = bytes[7];
+		records.push_back(record);
+	}
+	return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+	bool framesOnly = false;
+	const char *path = nullptr;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "--frames")) {
+			framesOnly = true;
+		}
+		else if (!path && argv[i][0] != '-') {
+			path = argv[i];
+		}
+		else {
+			fprintf(stderr, "usage: %s [--frames] [trace.bin]\n", argv[0]);
+			return 2;
+		}
+	}
+	FILE *file = path ? fopen(path, "rb") : stdin;
+	if (!file) {
+		perror(path);
+		return 1;
+	}
+	std::vector<Record> records;
+	bool complete = readTrace(file, records);
+	if (path) {
+		fclose(file);
+	}
+
+	FrameTracker tracker(framesOnly);
+	uint32_t previous = records.empty() ? 0 : records[0].micros;
+	for (const Record &r : records) {
+		if (!framesOnly) {
+			printf("%10u %+6d %s %-17s 0x%02X  %s\n", r.micros, (int32_t)(r.micros - previous), r.read() ? "R" : "W",
+					registerNames[r.reg()], r.value, annotate(r).c_str());
+			if (!r.payload.empty()) {
+				printf("%18s", "");
+				for (uint8_t byte : r.payload) {
+					printf(" %02X", byte);
+				}
+				printf("\n");
+			}
+		}
+		tracker.process(r);
+		previous = r.micros;
+	}
+	return complete ? 0 : 1;
+}
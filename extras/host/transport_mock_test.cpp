@@ -0,0 +1,105 @@
+/**
+ * Tests of the library against MFRC522TransportMock, built with MFRC522_TRANSPORT_MOCK. See extras/host/README.rst.
+ *
+ *   ./transport_mock_test
+ *
+ * The mock answers from its register file and from queued reads, without a simulated chip, and logs the
+ * accesses. Exits with 1 if a check fails.
+ *
+ * Released into the public domain.
+ */
+#include <Arduino.h>
+#include <MFRC522.h>
+#include <stdio.h>
+
+#if MFRC522_TRANSPORT != MFRC522_TRANSPORT_MOCK
+#error "Build with MFRC522_TRANSPORT_MOCK"
+#endif
+
+namespace {
+
+int failures = 0;
+
+void check(bool condition, const char *what) {
+	printf("%s: %s\n", condition ? "ok  " : "FAIL", what);
+	if (!condition) {
+		failures++;
+	}
+}
+
+// The last value written to reg since clearLog(), -1 if none
+int lastWrite(const MFRC522TransportMock &mock, byte reg) {
+	uint16_t first = mock.logCount > MFRC522TransportMock::LOG_SIZE ? mock.logCount - MFRC522TransportMock::LOG_SIZE : 0;
+	for (uint16_t i = mock.logCount; i > first; i--) {
+		const MFRC522TransportMock::Access &access = mock.accesses[(i - 1) % MFRC522TransportMock::LOG_SIZE];
+		if (access.write && access.reg == reg) {
+			return access.value;
+		}
+	}
+	return -1;
+}
+
+// Index in the log of the first read of reg since clearLog(), -1 if none
+int firstRead(const MFRC522TransportMock &mock, byte reg) {
+	for (uint16_t i = 0; i < mock.logCount && i < MFRC522TransportMock::LOG_SIZE; i++) {
+		if (!mock.accesses[i].write && mock.accesses[i].reg == reg) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+} // namespace
+
+
+int main() {
+	MFRC522TransportMock mock;
+	mock.queueRead(0x00);		// CommandReg after the soft reset: Idle, not powered down
+	mock.queueRead(0x92);		// VersionReg: MFRC522 v2.0
+	MFRC522 reader(mock, MFRC522::UNUSED_PIN);
+	MFRC522TransportMock &transport = reader.PCD_GetTransport();
+
+	reader.PCD_Init();
+	check(lastWrite(transport, MFRC522::CommandReg) == MFRC522::PCD_SoftReset, "PCD_Init() issues a soft reset");
+	check(transport.registers[MFRC522::TxASKReg >> 1] == 0x40, "PCD_Init() forces 100 % ASK");
+	check(transport.registers[MFRC522::ModeReg >> 1] == 0x3D, "PCD_Init() sets the CRC preset 0x6363");
+	check(transport.registers[MFRC522::TModeReg >> 1] & 0x80, "PCD_Init() sets TAuto");
+	check((transport.registers[MFRC522::TxControlReg >> 1] & 0x03) == 0x03, "PCD_Init() switches the antenna on");
+
+	transport.clearLog();
+	transport.queueRead(0x91);
+	check(reader.PCD_ReadRegister(MFRC522::VersionReg) == 0x91, "A queued read is returned");
+	check(reader.PCD_ReadRegister(MFRC522::VersionReg) == 0x00, "Without a queued read the register file is returned");
+	check(transport.logCount == 2 && !transport.accesses[0].write && transport.accesses[0].reg == MFRC522::VersionReg,
+			"Reads are logged");
+
+	// Find the reads before the first poll of ComIrqReg, then answer them alike and the poll with TimerIRq
+	byte bufferATQA[2];
+	byte bufferSize = sizeof(bufferATQA);
+	transport.clearLog();
+	reader.PICC_RequestA(bufferATQA, &bufferSize);
+	int poll = firstRead(transport, MFRC522::ComIrqReg);
+	check(poll >= 0, "PICC_RequestA() polls ComIrqReg");
+	if (poll >= 0) {
+		MFRC522TransportMock::Access before[MFRC522TransportMock::LOG_SIZE];
+		for (int i = 0; i < poll; i++) {
+			before[i] = transport.accesses[i];
+		}
+		transport.clearLog();
+		for (int i = 0; i < poll; i++) {
+			if (!before[i].write) {
+				transport.queueRead(before[i].value);
+			}
+		}
+		transport.queueRead(0x01);		// TimerIRq
+		bufferSize = sizeof(bufferATQA);
+		MFRC522::StatusCode status = reader.PICC_RequestA(bufferATQA, &bufferSize);
+		check(status == MFRC522::STATUS_TIMEOUT, "PICC_RequestA() times out on TimerIRq");
+		check(lastWrite(transport, MFRC522::FIFODataReg) == MFRC522::PICC_CMD_REQA, "PICC_RequestA() sends REQA");
+		check(lastWrite(transport, MFRC522::BitFramingReg) >= 0 && (lastWrite(transport, MFRC522::BitFramingReg) & 0x07) == 7,
+				"REQA is a short frame of 7 bits");
+	}
+
+	printf("%d failed\n", failures);
+	return failures ? 1 : 0;
+}
@@ -13,7 +13,7 @@
 /**
  * Constructor.
  */
-MFRC522::MFRC522(): MFRC522(SS, UINT8_MAX) { // SS is defined in pins_arduino.h, UINT8_MAX means there is no connection from Arduino to MFRC522's reset and power down input
+MFRC522::MFRC522(): MFRC522(MFRC522Transport(), UINT8_MAX) { // UINT8_MAX means there is no connection from Arduino to MFRC522's reset and power down input
 } // End constructor
 
 /**
@@ -21,76 +21,139 @@ MFRC522::MFRC522(): MFRC522(SS, UINT8_MAX) { // SS is defined in pins_arduino.h,
  * Prepares the output pins.
  */
 MFRC522::MFRC522(	byte resetPowerDownPin	///< Arduino pin connected to MFRC522's reset and power down input (Pin 6, NRSTPD, active low). If there is no connection from the CPU to NRSTPD, set this to UINT8_MAX. In this case, only soft reset will be used in PCD_Init().
-				): MFRC522(SS, resetPowerDownPin) { // SS is defined in pins_arduino.h
+				): MFRC522(MFRC522Transport(), resetPowerDownPin) { // The default transport uses SS, which is defined in pins_arduino.h
 } // End constructor
 
 /**
  * Constructor.
  * Prepares the output pins.
  */
-MFRC522::MFRC522(	byte chipSelectPin,		///< Arduino pin connected to MFRC522's SPI slave select input (Pin 24, NSS, active low)
+MFRC522::MFRC522(	byte chipSelectPin,		///< Arduino pin connected to MFRC522's SPI slave select input (Pin 24, NSS, active low). With the I2C transport this is the I2C address.
 					byte resetPowerDownPin	///< Arduino pin connected to MFRC522's reset and power down input (Pin 6, NRSTPD, active low). If there is no connection from the CPU to NRSTPD, set this to UINT8_MAX. In this case, only soft reset will be used in PCD_Init().
-				) {
-	_chipSelectPin = chipSelectPin;
+				): MFRC522(MFRC522Transport(chipSelectPin), resetPowerDownPin) {
+} // End constructor
+
+/**
+ * Constructor.
+ * Uses the given transport, e.g. an I2C transport with another TwoWire bus.
+ */
+MFRC522::MFRC522(	const MFRC522Transport &transport,	///< Bus the MFRC522 is connected to, see MFRC522Transport.h
+					byte resetPowerDownPin				///< Arduino pin connected to MFRC522's reset and power down input (Pin 6, NRSTPD, active low). If there is no connection from the CPU to NRSTPD, set this to UINT8_MAX. In this case, only soft reset will be used in PCD_Init().
+				): _transport(transport) {
 	_resetPowerDownPin = resetPowerDownPin;
+	_timeoutMicros = DEFAULT_TIMEOUT;
+	_timeToReady = 0;
+#if MFRC522_LOW_POWER
+	_lowPowerPeriod = 0;
+	_lowPowerBudget = 0;
+	_lowPowerLastWake = 0;
+	_lowPowerAntennaOnly = false;
+	_lowPowerStats = LowPowerStats();
+#endif
+#if MFRC522_LINK_QUALITY
+	_linkQuality = LinkQuality();
+	_linkAdaptation = false;
+	_linkBaseGain = RxGain_avg;
+	_linkBaseThreshold = 0x84;
+#endif
+#if MFRC522_HEALTH
+	_healthStats = HealthStats();
+	_healthLastCheck = 0;
+	_healthStalls = 0;
+#endif
+	PCD_InvalidateShadow();
+#if MFRC522_STATS
+	_perfStats = PerfStats();
+#endif
+#if MFRC522_TRACE
+	_traceNext = 0;
+	_traceCount = 0;
+	_tracing = true;
+#endif
 } // End constructor
 
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_SPI
+/**
+ * Constructor.
+ * Uses its own SPI bus and settings, so readers can be spread over the hardware SPI controllers of the MCU.
+ */
+MFRC522::MFRC522(	byte chipSelectPin,			///< Arduino pin connected to MFRC522's SPI slave select input (Pin 24, NSS, active low)
+					byte resetPowerDownPin,		///< Arduino pin connected to MFRC522's reset and power down input (Pin 6, NRSTPD, active low). If there is no connection from the CPU to NRSTPD, set this to UINT8_MAX. In this case, only soft reset will be used in PCD_Init().
+					SPIClass &spi,				///< SPI bus the MFRC522 is connected to, e.g. SPI1. Call begin() on it before PCD_Init().
+					const SPISettings &settings	///< Settings for every transaction, the MFRC522 accepts up to 10MHz in SPI_MODE0 with MSBFIRST.
+				): MFRC522(MFRC522Transport(chipSelectPin, spi, settings), resetPowerDownPin) {
+} // End constructor
+#endif
+
 /////////////////////////////////////////////////////////////////////////////////////
 // Basic interface functions for communicating with the MFRC522
 /////////////////////////////////////////////////////////////////////////////////////
 
 /**
  * Writes a byte to the specified register in the MFRC522 chip.
- * The interface is described in the datasheet section 8.1.2.
+ * The interface is described in the datasheet section 8.1.
  */
 void MFRC522::PCD_WriteRegister(	PCD_Register reg,	///< The register to write to. One of the PCD_Register enums.
 									byte value			///< The value to write.
 								) {
-	SPI.beginTransaction(SPISettings(MFRC522_SPICLOCK, MSBFIRST, SPI_MODE0));	// Set the settings to work with SPI bus
-	digitalWrite(_chipSelectPin, LOW);		// Select slave
-	SPI.transfer(reg);						// MSB == 0 is for writing. LSB is not used in address. Datasheet section 8.1.2.3.
-	SPI.transfer(value);
-	digitalWrite(_chipSelectPin, HIGH);		// Release slave again
-	SPI.endTransaction(); // Stop using the SPI bus
+	MFRC522_STATS_ADD(busFrames, 1);
+	MFRC522_STATS_ADD(busBytes, 2);
+	_transport.writeRegister(reg, value);
+#if MFRC522_SHADOW
+	if (PCD_IsShadowed(reg)) {
+		byte address = reg >> 1;
+		_shadow[address] = value & ~PCD_StrobeBits(reg);
+		_shadowValid[address >> 3] |= 1 << (address & 7);
+	}
+#endif
+#if MFRC522_TRACE
+	PCD_TraceAccess(reg, value, nullptr);
+#endif
 } // End PCD_WriteRegister()
 
 /**
  * Writes a number of bytes to the specified register in the MFRC522 chip.
- * The interface is described in the datasheet section 8.1.2.
+ * The interface is described in the datasheet section 8.1.
  */
 void MFRC522::PCD_WriteRegister(	PCD_Register reg,	///< The register to write to. One of the PCD_Register enums.
 									byte count,			///< The number of bytes to write to the register
 									byte *values		///< The values to write. Byte array.
 								) {
-	SPI.beginTransaction(SPISettings(MFRC522_SPICLOCK, MSBFIRST, SPI_MODE0));	// Set the settings to work with SPI bus
-	digitalWrite(_chipSelectPin, LOW);		// Select slave
-	SPI.transfer(reg);						// MSB == 0 is for writing. LSB is not used in address. Datasheet section 8.1.2.3.
-	for (byte index = 0; index < count; index++) {
-		SPI.transfer(values[index]);
-	}
-	digitalWrite(_chipSelectPin, HIGH);		// Release slave again
-	SPI.endTransaction(); // Stop using the SPI bus
+	MFRC522_STATS_ADD(busFrames, 1);
+	MFRC522_STATS_ADD(busBytes, 1 + count);
+	_transport.writeRegister(reg, count, values);
+#if MFRC522_SHADOW
+	if (PCD_IsShadowed(reg) && count > 0) {		// The last byte written stays
+		byte address = reg >> 1;
+		_shadow[address] = values[count - 1] & ~PCD_StrobeBits(reg);
+		_shadowValid[address >> 3] |= 1 << (address & 7);
+	}
+#endif
+#if MFRC522_TRACE
+	PCD_TraceAccess(reg | 0x01, count, values);
+#endif
 } // End PCD_WriteRegister()
 
 /**
  * Reads a byte from the specified register in the MFRC522 chip.
- * The interface is described in the datasheet section 8.1.2.
+ * The interface is described in the datasheet section 8.1.
  */
 byte MFRC522::PCD_ReadRegister(	PCD_Register reg	///< The register to read from. One of the PCD_Register enums.
 								) {
-	byte value;
-	SPI.beginTransaction(SPISettings(MFRC522_SPICLOCK, MSBFIRST, SPI_MODE0));	// Set the settings to work with SPI bus
-	digitalWrite(_chipSelectPin, LOW);			// Select slave
-	SPI.transfer(0x80 | reg);					// MSB == 1 is for reading. LSB is not used in address. Datasheet section 8.1.2.3.
-	value = SPI.transfer(0);					// Read the value back. Send 0 to stop reading.
-	digitalWrite(_chipSelectPin, HIGH);			// Release slave again
-	SPI.endTransaction(); // Stop using the SPI bus
+	MFRC522_STATS_ADD(busFrames, 1);
+	MFRC522_STATS_ADD(busBytes, 2);
+#if MFRC522_TRACE
+	byte value = _transport.readRegister(reg);
+	PCD_TraceAccess(0x80 | reg, value, nullptr);
 	return value;
+#else
+	return _transport.readRegister(reg);
+#endif
 } // End PCD_ReadRegister()
 
 /**
  * Reads a number of bytes from the specified register in the MFRC522 chip.
- * The interface is described in the datasheet section 8.1.2.
+ * The interface is described in the datasheet section 8.1.
  */
 void MFRC522::PCD_ReadRegister(	PCD_Register reg,	///< The register to read from. One of the PCD_Register enums.
 								byte count,			///< The number of bytes to read
@@ -101,28 +164,19 @@ void MFRC522::PCD_ReadRegister(	PCD_Register reg,	///< The register to read from
 		return;
 	}
 	//Serial.print(F("Reading ")); 	Serial.print(count); Serial.println(F(" bytes from register."));
-	byte address = 0x80 | reg;				// MSB == 1 is for reading. LSB is not used in address. Datasheet section 8.1.2.3.
-	byte index = 0;							// Index in values array.
-	SPI.beginTransaction(SPISettings(MFRC522_SPICLOCK, MSBFIRST, SPI_MODE0));	// Set the settings to work with SPI bus
-	digitalWrite(_chipSelectPin, LOW);		// Select slave
-	count--;								// One read is performed outside of the loop
-	SPI.transfer(address);					// Tell MFRC522 which address we want to read
+	byte first = values[0];
+	MFRC522_STATS_ADD(busFrames, 1);
+	MFRC522_STATS_ADD(busBytes, 1 + count);
+	_transport.readRegister(reg, count, values);
+#if MFRC522_TRACE
+	PCD_TraceAccess(0x80 | reg | 0x01, count, values);
+#endif
 	if (rxAlign) {		// Only update bit positions rxAlign..7 in values[0]
 		// Create bit mask for bit positions rxAlign..7
 		byte mask = (0xFF << rxAlign) & 0xFF;
-		// Read value and tell that we want to read the same address again.
-		byte value = SPI.transfer(address);
-		// Apply mask to both current value of values[0] and the new data in value.
-		values[0] = (values[0] & ~mask) | (value & mask);
-		index++;
-	}
-	while (index < count) {
-		values[index] = SPI.transfer(address);	// Read value and tell that we want to read the same address again.
-		index++;
-	}
-	values[index] = SPI.transfer(0);			// Read the final byte. Send 0 to stop reading.
-	digitalWrite(_chipSelectPin, HIGH);			// Release slave again
-	SPI.endTransaction(); // Stop using the SPI bus
+		// Apply mask to both the previous value of values[0] and the new data.
+		values[0] = (first & ~mask) | (values[0] & mask);
+	}
 } // End PCD_ReadRegister()
 
 /**
@@ -131,9 +185,7 @@ void MFRC522::PCD_ReadRegister(	PCD_Register reg,	///< The register to read from
 void MFRC522::PCD_SetRegisterBitMask(	PCD_Register reg,	///< The register to update. One of the PCD_Register enums.
 										byte mask			///< The bits to set.
 									) { 
-	byte tmp;
-	tmp = PCD_ReadRegister(reg);
-	PCD_WriteRegister(reg, tmp | mask);			// set bit mask
+	PCD_UpdateRegister(reg, mask, mask);
 } // End PCD_SetRegisterBitMask()
 
 /**
@@ -142,11 +194,189 @@ void MFRC522::PCD_SetRegisterBitMask(	PCD_Register reg,	///< The register to upd
 void MFRC522::PCD_ClearRegisterBitMask(	PCD_Register reg,	///< The register to update. One of the PCD_Register enums.
 										byte mask			///< The bits to clear.
 									  ) {
-	byte tmp;
-	tmp = PCD_ReadRegister(reg);
-	PCD_WriteRegister(reg, tmp & (~mask));		// clear bit mask
+	PCD_UpdateRegister(reg, mask, 0);
 } // End PCD_ClearRegisterBitMask()
 
+/**
+ * Sets the bits given in mask in register reg to the bits of value, the other bits keep their value.
+ * Registers in SHADOW_REGISTERS are taken from the shadow instead of read, and not written if they already
+ * have the value, unless a strobe bit like StartSend is set. Combine fields of one register to one update:
+ * 		PCD_UpdateRegister(TxControlReg, TxControlReg_Tx2RFEn::mask | TxControlReg_Tx1RFEn::mask, 0);
+ */
+void MFRC522::PCD_UpdateRegister(	PCD_Register reg,	///< The register to update. One of the PCD_Register enums.
+									byte mask,			///< The bits to change.
+									byte value			///< The new value of the bits in mask.
+								) {
+	byte current = PCD_ReadShadow(reg);
+	byte updated = (current & ~mask) | (value & mask);
+	if (PCD_IsShadowed(reg) && updated == current && !(updated & PCD_StrobeBits(reg))) {
+		return;
+	}
+	PCD_WriteRegister(reg, updated);
+} // End PCD_UpdateRegister()
+
+/**
+ * Forgets the values kept in the shadow, so the registers are read from the MFRC522 again.
+ * The library calls it after a reset. Call it after writing registers through PCD_GetTransport().
+ */
+void MFRC522::PCD_InvalidateShadow() {
+#if MFRC522_SHADOW
+	memset(_shadowValid, 0, sizeof(_shadowValid));
+#endif
+} // End PCD_InvalidateShadow()
+
+/**
+ * Reads a register, from the shadow if it is in SHADOW_REGISTERS and its value is known.
+ * Read-only bits of such a register, e.g. CollPos in CollReg, are not up to date in the shadow.
+ */
+byte MFRC522::PCD_ReadShadow(	PCD_Register reg	///< The register to read from. One of the PCD_Register enums.
+								) {
+#if MFRC522_SHADOW
+	if (PCD_IsShadowed(reg)) {
+		byte address = reg >> 1;
+		if (_shadowValid[address >> 3] & (1 << (address & 7))) {
+			MFRC522_STATS_ADD(shadowHits, 1);
+			return _shadow[address];
+		}
+		byte value = PCD_ReadRegister(reg);
+		_shadow[address] = value & ~PCD_StrobeBits(reg);
+		_shadowValid[address >> 3] |= 1 << (address & 7);
+		return value;
+	}
+#endif
+	return PCD_ReadRegister(reg);
+} // End PCD_ReadShadow()
+
+#if MFRC522_TRACE
+/**
+ * Records one register access in the trace. With MFRC522_TRACE_PAYLOAD the bytes of a multi-byte access
+ * follow in continuation records, so MFRC522TransportReplay can feed them back.
+ */
+void MFRC522::PCD_TraceAccess(	byte address,			///< Address byte as on SPI, bit 0 set for a multi-byte access.
+								byte value,				///< The value, or the number of bytes of a multi-byte access.
+								const byte *payload		///< The bytes of a multi-byte access, nullptr otherwise.
+							) {
+	if (!_tracing) {
+		return;
+	}
+	byte first = 0;
+	byte digest = 0;
+	if (payload && value > 0) {
+		first = payload[0];
+		digest = MFRC522TransportReplay::digest(payload, value);
+	}
+	PCD_TraceAppend(micros(), address, value, first, digest);
+#if MFRC522_TRACE_PAYLOAD
+	// The bytes themselves, 7 per continuation record
+	if (payload && (address & 0x01)) {
+		for (byte i = 0; i < value; i += 7) {
+			byte bytes[7] = { 0, 0, 0, 0, 0, 0, 0 };
+			for (byte j = 0; j < 7 && i + j < value; j++) {
+				bytes[j] = payload[i + j];
+			}
+			PCD_TraceAppend((uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24),
+							MFRC522TransportReplay::CONTINUATION, bytes[4], bytes[5], bytes[6]);
+		}
+	}
+#endif
+} // End PCD_TraceAccess()
+
+/**
+ * Appends one record to the trace ring buffer, the oldest record is overwritten when it is full.
+ */
+void MFRC522::PCD_TraceAppend(	uint32_t time,	///< micros() of the access, payload bytes in a continuation record.
+								byte address,	///< See TraceRecord.
+								byte value,
+								byte first,
+								byte digest
+							) {
+	TraceRecord &record = _trace[_traceNext];
+	record.micros = time;
+	record.address = address;
+	record.value = value;
+	record.first = first;
+	record.digest = digest;
+	if (++_traceNext == MFRC522_TRACE) {
+		_traceNext = 0;
+	}
+	if (_traceCount < MFRC522_TRACE) {
+		_traceCount++;
+	}
+} // End PCD_TraceAppend()
+
+/**
+ * Starts or stops recording register accesses, e.g. stop after an error to keep the accesses that led to it.
+ * Recording is on after construction.
+ */
+void MFRC522::PCD_SetTracing(	bool enable	///< true to record, false to keep the trace as it is.
+							) {
+	_tracing = enable;
+} // End PCD_SetTracing()
+
+/**
+ * Discards all records of the trace.
+ */
+void MFRC522::PCD_ClearTrace() {
+	_traceNext = 0;
+	_traceCount = 0;
+} // End PCD_ClearTrace()
+
+/**
+ * Copies the newest records of the trace, oldest first.
+ *
+ * @return The number of records copied.
+ */
+uint16_t MFRC522::PCD_GetTrace(	TraceRecord *records,	///< Out: The records.
+								uint16_t maxRecords		///< Size of records.
+							) {
+	uint16_t count = _traceCount < maxRecords ? _traceCount : maxRecords;
+	uint16_t index = (_traceNext + MFRC522_TRACE - count) % MFRC522_TRACE;
+	for (uint16_t i = 0; i < count; i++) {
+		records[i] = _trace[index];
+		if (++index == MFRC522_TRACE) {
+			index = 0;
+		}
+	}
+	return count;
+} // End PCD_GetTrace()
+
+/**
+ * Writes the trace in binary, e.g. to Serial. Decode it on the PC with extras/host/trace_decode.cpp, replay
+ * it with MFRC522TransportReplay. Format, all numbers little endian:
+ * 		"MFTR", version, record size 8, number of records (2 bytes),
+ * 		then per record, oldest first: micros (4 bytes), address, value, first, digest. See TraceRecord.
+ * Version 2 is written with MFRC522_TRACE_PAYLOAD: a record with address 0x7F continues the multi-byte access
+ * before it with 7 more bytes of its payload, in place of micros, value, first and digest.
+ *
+ * @return The number of bytes written.
+ */
+size_t MFRC522::PCD_DumpTrace(	Print &out	///< Where to write to.
+							) {
+	uint16_t count = _traceCount;
+	uint16_t index = (_traceNext + MFRC522_TRACE - count) % MFRC522_TRACE;
+	// After the ring buffer wrapped, the oldest records may continue an access that was overwritten
+	while (count > 0 && _trace[index].address == MFRC522TransportReplay::CONTINUATION) {
+		count--;
+		if (++index == MFRC522_TRACE) {
+			index = 0;
+		}
+	}
+	byte header[8] = { 'M', 'F', 'T', 'R', MFRC522_TRACE_PAYLOAD ? 2 : 1, 8, (byte)(count & 0xFF), (byte)(count >> 8) };
+	size_t written = out.write(header, sizeof(header));
+	for (uint16_t i = 0; i < count; i++) {
+		const TraceRecord &record = _trace[index];
+		byte bytes[8] = {	(byte)(record.micros & 0xFF), (byte)((record.micros >> 8) & 0xFF),
+							(byte)((record.micros >> 16) & 0xFF), (byte)(record.micros >> 24),
+							record.address, record.value, record.first, record.digest };
+		written += out.write(bytes, sizeof(bytes));
+		if (++index == MFRC522_TRACE) {
+			index = 0;
+		}
+	}
+	return written;
+} // End PCD_DumpTrace()
+#endif
+
 
 /**
  * Use the CRC coprocessor in the MFRC522 to calculate a CRC_A.
@@ -157,9 +387,10 @@ MFRC522::StatusCode MFRC522::PCD_CalculateCRC(	byte *data,		///< In: Pointer to
 												byte length,	///< In: The number of bytes to transfer.
 												byte *result	///< Out: Pointer to result buffer. Result is written to result[0..1], low byte first.
 					 ) {
+	MFRC522BusSession session(_transport);
 	PCD_WriteRegister(CommandReg, PCD_Idle);		// Stop any active command.
 	PCD_WriteRegister(DivIrqReg, 0x04);				// Clear the CRCIRq interrupt request bit
-	PCD_WriteRegister(FIFOLevelReg, 0x80);			// FlushBuffer = 1, FIFO initialization
+	PCD_WriteRegister(FIFOLevelReg, FIFOLevelReg_FlushBuffer::mask);			// FlushBuffer = 1, FIFO initialization
 	PCD_WriteRegister(FIFODataReg, length, data);	// Write data to the FIFO
 	PCD_WriteRegister(CommandReg, PCD_CalcCRC);		// Start the calculation
 	
@@ -172,6 +403,7 @@ MFRC522::StatusCode MFRC522::PCD_CalculateCRC(	byte *data,		///< In: Pointer to
 	do {
 		// DivIrqReg[7..0] bits are: Set2 reserved reserved MfinActIRq reserved CRCIRq reserved reserved
 		byte n = PCD_ReadRegister(DivIrqReg);
+		MFRC522_STATS_ADD(divIrqPolls, 1);
 		if (n & 0x04) {									// CRCIRq bit set - calculation done
 			PCD_WriteRegister(CommandReg, PCD_Idle);	// Stop calculating CRC for new content in the FIFO.
 			// Transfer the result from the registers to the result buffer
@@ -179,7 +411,9 @@ MFRC522::StatusCode MFRC522::PCD_CalculateCRC(	byte *data,		///< In: Pointer to
 			result[1] = PCD_ReadRegister(CRCResultRegH);
 			return STATUS_OK;
 		}
+		session.suspend();
 		yield();
+		session.resume();
 	}
 	while (static_cast<uint32_t> (millis()) < deadline);
 
@@ -187,20 +421,47 @@ MFRC522::StatusCode MFRC522::PCD_CalculateCRC(	byte *data,		///< In: Pointer to
 	return STATUS_TIMEOUT;
 } // End PCD_CalculateCRC()
 
+/**
+ * Calculates the CRC_A in software, for frames too short to be worth a round trip to the CRC coprocessor.
+ */
+void MFRC522::PICC_CalculateCRC_A(	const byte *data,	///< In: The bytes to calculate the CRC_A over.
+									byte length,		///< In: The number of bytes.
+									byte *result		///< Out: Result buffer. Result is written to result[0..1], low byte first.
+								) {
+	uint16_t crc = 0x6363;
+	for (byte i = 0; i < length; i++) {
+		crc = PICC_CRC_A(crc, data[i]);
+	}
+	result[0] = crc & 0xFF;
+	result[1] = crc >> 8;
+} // End PICC_CalculateCRC_A()
+
 
 /////////////////////////////////////////////////////////////////////////////////////
 // Functions for manipulating the MFRC522
 /////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Registers written by PCD_Init() after the reset, as pairs of register and value.
+ */
+static const byte PCD_InitRegisters[][2] PROGMEM = {
+	// Reset baud rates
+	{MFRC522::TxModeReg, 0x00},
+	{MFRC522::RxModeReg, 0x00},
+	// Reset ModWidthReg
+	{MFRC522::ModWidthReg, 0x26},
+	{MFRC522::TxASKReg, 0x40},		// Default 0x00. Force a 100 % ASK modulation independent of the ModGsPReg register setting
+	{MFRC522::ModeReg, 0x3D},		// Default 0x3F. Set the preset value for the CRC coprocessor for the CalcCRC command to 0x6363 (ISO 14443-3 part 6.2.4)
+};
+
 /**
  * Initializes the MFRC522 chip.
  */
 void MFRC522::PCD_Init() {
 	bool hardReset = false;
 
-	// Set the chipSelectPin as digital output, do not select the slave yet
-	pinMode(_chipSelectPin, OUTPUT);
-	digitalWrite(_chipSelectPin, HIGH);
+	// Prepare the bus, e.g. set the chipSelectPin as digital output, do not select the slave yet
+	_transport.begin();
 	
 	// If a valid pin number has been set, pull device out of power down / reset state.
 	if (_resetPowerDownPin != UNUSED_PIN) {
@@ -212,41 +473,131 @@ void MFRC522::PCD_Init() {
 			digitalWrite(_resetPowerDownPin, LOW);		// Make sure we have a clean LOW state.
 			delayMicroseconds(2);				// 8.8.1 Reset timing requirements says about 100ns. Let us be generous: 2μsl
 			digitalWrite(_resetPowerDownPin, HIGH);		// Exit power down mode. This triggers a hard reset.
-			// Section 8.8.2 in the datasheet says the oscillator start-up time is the start up time of the crystal + 37,74μs. Let us be generous: 50ms.
-			delay(50);
+			PCD_InvalidateShadow();
+			// Section 8.8.2 in the datasheet says the oscillator start-up time is the start up time of the crystal + 37,74μs.
+			// Poll until it answers instead of waiting for the worst case.
+			PCD_WaitReady(micros());
 			hardReset = true;
 		}
 	}
 
+	MFRC522BusSession session(_transport);		// Write the whole register set in one session
 	if (!hardReset) { // Perform a soft reset if we haven't triggered a hard reset above.
 		PCD_Reset();
 	}
 	
-	// Reset baud rates
-	PCD_WriteRegister(TxModeReg, 0x00);
-	PCD_WriteRegister(RxModeReg, 0x00);
-	// Reset ModWidthReg
-	PCD_WriteRegister(ModWidthReg, 0x26);
-
 	// When communicating with a PICC we need a timeout if something goes wrong.
-	// f_timer = 13.56 MHz / (2*TPreScaler+1) where TPreScaler = [TPrescaler_Hi:TPrescaler_Lo].
-	// TPrescaler_Hi are the four low bits in TModeReg. TPrescaler_Lo is TPrescalerReg.
-	PCD_WriteRegister(TModeReg, 0x80);			// TAuto=1; timer starts automatically at the end of the transmission in all communication modes at all speeds
-	PCD_WriteRegister(TPrescalerReg, 0xA9);		// TPreScaler = TModeReg[3..0]:TPrescalerReg, ie 0x0A9 = 169 => f_timer=40kHz, ie a timer period of 25μs.
-	PCD_WriteRegister(TReloadRegH, 0x03);		// Reload timer with 0x3E8 = 1000, ie 25ms before timeout.
-	PCD_WriteRegister(TReloadRegL, 0xE8);
+	PCD_WriteInitConfig(DEFAULT_TIMEOUT);	// 25ms before timeout.
 	
-	PCD_WriteRegister(TxASKReg, 0x40);		// Default 0x00. Force a 100 % ASK modulation independent of the ModGsPReg register setting
-	PCD_WriteRegister(ModeReg, 0x3D);		// Default 0x3F. Set the preset value for the CRC coprocessor for the CalcCRC command to 0x6363 (ISO 14443-3 part 6.2.4)
-	PCD_AntennaOn();						// Enable the antenna driver pins TX1 and TX2 (they were disabled by the reset)
+#if MFRC522_LINK_QUALITY
+	if (_linkAdaptation) {
+		PCD_ApplyLinkLevel(_linkQuality.level);	// The reset restored the default gain and threshold
+	}
+#endif
+#if MFRC522_HEALTH
+	_healthStalls = 0;
+#endif
 } // End PCD_Init()
 
+/**
+ * Writes the configuration of PCD_Init() after a reset and switches the antenna on.
+ */
+void MFRC522::PCD_WriteInitConfig(uint32_t timeoutMicros	///< Timeout to program, see PCD_SetTimeout().
+								) {
+	for (byte i = 0; i < sizeof(PCD_InitRegisters) / sizeof(PCD_InitRegisters[0]); i++) {
+		PCD_WriteRegister((PCD_Register)pgm_read_byte(&PCD_InitRegisters[i][0]), pgm_read_byte(&PCD_InitRegisters[i][1]));
+	}
+	PCD_SetTimeout(timeoutMicros);
+	PCD_AntennaOn();						// Enable the antenna driver pins TX1 and TX2 (they were disabled by the reset)
+} // End PCD_WriteInitConfig()
+
+#if MFRC522_HEALTH
+/**
+ * Looks up the value PCD_Init() writes to a register.
+ * 
+ * @return The value, or 0 if PCD_Init() does not write the register.
+ */
+static byte PCD_InitValue(byte reg) {
+	for (byte i = 0; i < sizeof(PCD_InitRegisters) / sizeof(PCD_InitRegisters[0]); i++) {
+		if (pgm_read_byte(&PCD_InitRegisters[i][0]) == reg) {
+			return pgm_read_byte(&PCD_InitRegisters[i][1]);
+		}
+	}
+	return 0;
+} // End PCD_InitValue()
+#endif
+
+/**
+ * Writable configuration registers of a ConfigSnapshot: the interrupt enables and the FIFO water level of
+ * page 0, pages 1 and 2 without SerialSpeedReg (changing it cuts off a UART connection).
+ * TxControlReg is restored last, so the antenna is only switched on with the final settings.
+ */
+static const byte PCD_ConfigRegisters[] PROGMEM = {
+	MFRC522::ComIEnReg,		MFRC522::DivIEnReg,		MFRC522::WaterLevelReg,
+	MFRC522::ModeReg,		MFRC522::TxModeReg,		MFRC522::RxModeReg,		MFRC522::TxASKReg,
+	MFRC522::TxSelReg,		MFRC522::RxSelReg,		MFRC522::RxThresholdReg,	MFRC522::DemodReg,
+	MFRC522::MfTxReg,		MFRC522::MfRxReg,
+	MFRC522::ModWidthReg,	MFRC522::RFCfgReg,		MFRC522::GsNReg,		MFRC522::CWGsPReg,
+	MFRC522::ModGsPReg,		MFRC522::TModeReg,		MFRC522::TPrescalerReg,	MFRC522::TReloadRegH,
+	MFRC522::TReloadRegL,
+	MFRC522::TxControlReg,
+};
+static_assert(sizeof(PCD_ConfigRegisters) == MFRC522::CONFIG_REGISTERS, "CONFIG_REGISTERS does not match PCD_ConfigRegisters");
+
+/**
+ * Reads the writable configuration registers into a snapshot, e.g. after changing TxASKReg, the gain or the timeout.
+ * Takes one bus transaction. Pass the snapshot to PCD_HealthPoll() or PCD_Recover() to have it restored.
+ */
+void MFRC522::PCD_SaveConfig(ConfigSnapshot &snapshot	///< Out: The current configuration.
+							) {
+	MFRC522BusSession session(_transport);
+	for (byte i = 0; i < CONFIG_REGISTERS; i++) {
+		snapshot.values[i] = PCD_ReadRegister((PCD_Register)pgm_read_byte(&PCD_ConfigRegisters[i]));
+	}
+	snapshot.timeoutMicros = _timeoutMicros;
+} // End PCD_SaveConfig()
+
+/**
+ * Writes a snapshot taken by PCD_SaveConfig() back, e.g. after a reset. Replaces the register writes of
+ * PCD_Init(): one bus transaction of CONFIG_REGISTERS writes instead of a reset sequence.
+ */
+void MFRC522::PCD_RestoreConfig(const ConfigSnapshot &snapshot	///< The configuration to write.
+								) {
+	MFRC522BusSession session(_transport);
+	for (byte i = 0; i < CONFIG_REGISTERS; i++) {
+		PCD_WriteRegister((PCD_Register)pgm_read_byte(&PCD_ConfigRegisters[i]), snapshot.values[i]);
+	}
+	_timeoutMicros = snapshot.timeoutMicros;
+} // End PCD_RestoreConfig()
+
+#if MFRC522_HEALTH
+/**
+ * Looks up the value of a register in a snapshot.
+ * 
+ * @return The value, or 0 if the register is not part of a ConfigSnapshot.
+ */
+byte MFRC522::PCD_ConfigValue(	const ConfigSnapshot &snapshot,	///< The snapshot to look in.
+								PCD_Register reg				///< One of the registers of PCD_ConfigRegisters.
+							) {
+	for (byte i = 0; i < CONFIG_REGISTERS; i++) {
+		if (pgm_read_byte(&PCD_ConfigRegisters[i]) == reg) {
+			return snapshot.values[i];
+		}
+	}
+	return 0;
+} // End PCD_ConfigValue()
+#endif
+
 /**
  * Initializes the MFRC522 chip.
  */
 void MFRC522::PCD_Init(	byte resetPowerDownPin	///< Arduino pin connected to MFRC522's reset and power down input (Pin 6, NRSTPD, active low)
 					) {
-	PCD_Init(SS, resetPowerDownPin); // SS is defined in pins_arduino.h
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_SPI
+	_transport.setDevice(SS); // SS is defined in pins_arduino.h
+#endif
+	_resetPowerDownPin = resetPowerDownPin;
+	PCD_Init();
 } // End PCD_Init()
 
 /**
@@ -255,43 +606,95 @@ void MFRC522::PCD_Init(	byte resetPowerDownPin	///< Arduino pin connected to MFR
 void MFRC522::PCD_Init(	byte chipSelectPin,		///< Arduino pin connected to MFRC522's SPI slave select input (Pin 24, NSS, active low)
 						byte resetPowerDownPin	///< Arduino pin connected to MFRC522's reset and power down input (Pin 6, NRSTPD, active low)
 					) {
-	_chipSelectPin = chipSelectPin;
+	_transport.setDevice(chipSelectPin);
 	_resetPowerDownPin = resetPowerDownPin; 
-	// Set the chipSelectPin as digital output, do not select the slave yet
 	PCD_Init();
 } // End PCD_Init()
 
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_SPI
+/**
+ * Initializes the MFRC522 chip on the given SPI bus.
+ */
+void MFRC522::PCD_Init(	byte chipSelectPin,			///< Arduino pin connected to MFRC522's SPI slave select input (Pin 24, NSS, active low)
+						byte resetPowerDownPin,		///< Arduino pin connected to MFRC522's reset and power down input (Pin 6, NRSTPD, active low)
+						SPIClass &spi,				///< SPI bus the MFRC522 is connected to. Call begin() on it before.
+						const SPISettings &settings	///< Settings for every transaction.
+					) {
+	_transport = MFRC522Transport(chipSelectPin, spi, settings);
+	_resetPowerDownPin = resetPowerDownPin;
+	PCD_Init();
+} // End PCD_Init()
+#endif
+
 /**
  * Performs a soft reset on the MFRC522 chip and waits for it to be ready again.
+ * 
+ * @return true if the MFRC522 is ready, false if it did not answer within MFRC522_RESET_TIMEOUT_MS.
  */
-void MFRC522::PCD_Reset() {
+bool MFRC522::PCD_Reset() {
+	MFRC522BusSession session(_transport);
 	PCD_WriteRegister(CommandReg, PCD_SoftReset);	// Issue the SoftReset command.
+	PCD_InvalidateShadow();							// All registers get their reset values
 	// The datasheet does not mention how long the SoftRest command takes to complete.
 	// But the MFRC522 might have been in soft power-down mode (triggered by bit 4 of CommandReg) 
-	// Section 8.8.2 in the datasheet says the oscillator start-up time is the start up time of the crystal + 37,74μs. Let us be generous: 50ms.
-	uint8_t count = 0;
-	do {
-		// Wait for the PowerDown bit in CommandReg to be cleared (max 3x50ms)
-		delay(50);
-	} while ((PCD_ReadRegister(CommandReg) & (1 << 4)) && (++count) < 3);
+	// Section 8.8.2 in the datasheet says the oscillator start-up time is the start up time of the crystal + 37,74μs.
+	return PCD_WaitReady(micros());
 } // End PCD_Reset()
 
+/**
+ * Waits for the MFRC522 to finish a reset or wake up: the PowerDown bit in CommandReg is cleared,
+ * the Idle command is active and VersionReg reads a plausible value.
+ * Polls every MFRC522_RESET_POLL_US until the timeout and stores the time taken.
+ * 
+ * @return true if the MFRC522 is ready.
+ */
+bool MFRC522::PCD_WaitReady(	uint32_t start,			///< micros() when the reset or wake up was triggered.
+								uint32_t timeoutMicros	///< Upper bound for the wait.
+							) {
+	MFRC522BusSession session(_transport);
+	while (true) {
+		byte command = PCD_ReadRegister(CommandReg);
+		if (!(command & 0x10) && (command & 0x0F) != PCD_SoftReset) {	// PowerDown bit cleared, no SoftReset pending
+			byte version = PCD_ReadRegister(VersionReg);
+			if ((version != 0x00) && (version != 0xFF)) {
+				_timeToReady = micros() - start;
+				return true;
+			}
+		}
+		if ((uint32_t)(micros() - start) >= timeoutMicros) {
+			_timeToReady = micros() - start;
+			return false;
+		}
+		session.suspend();
+		delayMicroseconds(MFRC522_RESET_POLL_US);
+		yield();
+		session.resume();
+	}
+} // End PCD_WaitReady()
+
+/**
+ * Returns the time the MFRC522 needed to become ready after the last reset or wake up,
+ * measured by PCD_Init(), PCD_Reset() and PCD_SoftPowerUp().
+ * 
+ * @return Time in microseconds, or at least MFRC522_RESET_TIMEOUT_MS if it did not become ready.
+ */
+uint32_t MFRC522::PCD_GetTimeToReady() {
+	return _timeToReady;
+} // End PCD_GetTimeToReady()
+
 /**
  * Turns the antenna on by enabling pins TX1 and TX2.
  * After a reset these pins are disabled.
  */
 void MFRC522::PCD_AntennaOn() {
-	byte value = PCD_ReadRegister(TxControlReg);
-	if ((value & 0x03) != 0x03) {
-		PCD_WriteRegister(TxControlReg, value | 0x03);
-	}
+	PCD_WriteFields<TxControlReg_Tx2RFEn, TxControlReg_Tx1RFEn>(1, 1);
 } // End PCD_AntennaOn()
 
 /**
  * Turns the antenna off by disabling pins TX1 and TX2.
  */
 void MFRC522::PCD_AntennaOff() {
-	PCD_ClearRegisterBitMask(TxControlReg, 0x03);
+	PCD_WriteFields<TxControlReg_Tx2RFEn, TxControlReg_Tx1RFEn>(0, 0);
 } // End PCD_AntennaOff()
 
 /**
@@ -302,7 +705,7 @@ void MFRC522::PCD_AntennaOff() {
  * @return Value of the RxGain, scrubbed to the 3 bits used.
  */
 byte MFRC522::PCD_GetAntennaGain() {
-	return PCD_ReadRegister(RFCfgReg) & (0x07<<4);
+	return RFCfgReg_RxGain::set(PCD_ReadField<RFCfgReg_RxGain>());
 } // End PCD_GetAntennaGain()
 
 /**
@@ -311,12 +714,172 @@ byte MFRC522::PCD_GetAntennaGain() {
  * NOTE: Given mask is scrubbed with (0x07<<4)=01110000b as RCFfgReg may use reserved bits.
  */
 void MFRC522::PCD_SetAntennaGain(byte mask) {
-	if (PCD_GetAntennaGain() != mask) {						// only bother if there is a change
-		PCD_ClearRegisterBitMask(RFCfgReg, (0x07<<4));		// clear needed to allow 000 pattern
-		PCD_SetRegisterBitMask(RFCfgReg, mask & (0x07<<4));	// only set RxGain[2:0] bits
-	}
+	PCD_WriteField<RFCfgReg_RxGain>(RFCfgReg_RxGain::get(mask));	// Only written if there is a change
 } // End PCD_SetAntennaGain()
 
+/**
+ * Finds the receiver gain, and optionally driver conductance and receiver threshold, that select a reference
+ * PICC most reliably and fastest with this installation. Place one reference card at the usual reading
+ * distance before calling it.
+ * For each setting the card is woken up, selected and halted attempts times. The settings are swept one
+ * register after the other, RxGain first. Settings with more successful selects win, then those with a
+ * lower average latency. On a tie the lower gain is kept, as high gain also amplifies noise.
+ * The best settings stay active and are stored in record, which can be saved and later given to PCD_ApplyCalibration().
+ * 
+ * @return STATUS_OK on success, STATUS_TIMEOUT if the card was not found with any setting. The previous settings are kept then.
+ */
+MFRC522::StatusCode MFRC522::PCD_CalibrateAntenna(	CalibrationRecord *record,	///< Out: The calibration result.
+													byte options,				///< Additional registers to sweep, a combination of the PCD_CalibrationOption enums.
+													byte attempts				///< Selects per setting, 1..100.
+												) {
+	static const byte rxGains[] PROGMEM = {RxGain_18dB, RxGain_23dB, RxGain_33dB, RxGain_38dB, RxGain_43dB, RxGain_48dB};
+	static const byte conductances[] PROGMEM = {0x08, 0x10, 0x20, 0x3F};
+	static const byte thresholds[] PROGMEM = {0x44, 0x64, 0x84, 0xA4, 0xC4};
+	
+	if (attempts == 0 || attempts > 100) {
+		return STATUS_INVALID;
+	}
+	uint32_t timeout = _timeoutMicros;
+	PCD_SetTimeout(2000);		// Plenty for ISO/IEC 14443-3 frames, and HLTA does not wait 25ms
+	
+	byte previous[4];
+	previous[0] = PCD_GetAntennaGain();
+	previous[1] = PCD_ReadRegister(CWGsPReg);
+	previous[2] = PCD_ReadRegister(ModGsPReg);
+	previous[3] = PCD_ReadRegister(RxThresholdReg);
+	
+	// Learn the UID of the reference card, so another card passing by is not counted
+	Uid reference;
+	reference.size = 0;
+	uint32_t bestMicros;
+	PCD_MeasureSelect(&reference, 1, &bestMicros);
+	
+	byte bestSuccess = 0;
+	bestMicros = UINT32_MAX;
+	PCD_SweepRegister(RFCfgReg, rxGains, sizeof(rxGains), 0x07 << 4, &reference, attempts, &bestSuccess, &bestMicros);
+	if (options & Calibrate_CWGsP) {
+		PCD_SweepRegister(CWGsPReg, conductances, sizeof(conductances), 0x3F, &reference, attempts, &bestSuccess, &bestMicros);
+	}
+	if (options & Calibrate_ModGsP) {
+		PCD_SweepRegister(ModGsPReg, conductances, sizeof(conductances), 0x3F, &reference, attempts, &bestSuccess, &bestMicros);
+	}
+	if (options & Calibrate_RxThreshold) {
+		PCD_SweepRegister(RxThresholdReg, thresholds, sizeof(thresholds), 0xF7, &reference, attempts, &bestSuccess, &bestMicros);
+	}
+	PCD_SetTimeout(timeout);
+	
+	if (bestSuccess == 0) {
+		PCD_SetAntennaGain(previous[0]);
+		PCD_WriteRegister(CWGsPReg, previous[1]);
+		PCD_WriteRegister(ModGsPReg, previous[2]);
+		PCD_WriteRegister(RxThresholdReg, previous[3]);
+		return STATUS_TIMEOUT;
+	}
+	
+	record->rxGain = PCD_GetAntennaGain();
+	record->cwGsP = PCD_ReadRegister(CWGsPReg);
+	record->modGsP = PCD_ReadRegister(ModGsPReg);
+	record->rxThreshold = PCD_ReadRegister(RxThresholdReg);
+	record->successRate = (uint16_t)bestSuccess * 100 / attempts;
+	record->check = PCD_CalibrationCheck(record);
+	return STATUS_OK;
+} // End PCD_CalibrateAntenna()
+
+/**
+ * Writes the settings of a calibration record from PCD_CalibrateAntenna(), e.g. after PCD_Init().
+ * 
+ * @return false if the record is not valid, e.g. erased EEPROM. Nothing is changed then.
+ */
+bool MFRC522::PCD_ApplyCalibration(const CalibrationRecord *record	///< The record to apply.
+									) {
+	if (record->check != PCD_CalibrationCheck(record)) {
+		return false;
+	}
+	PCD_SetAntennaGain(record->rxGain);
+	PCD_WriteRegister(CWGsPReg, record->cwGsP);
+	PCD_WriteRegister(ModGsPReg, record->modGsP);
+	PCD_WriteRegister(RxThresholdReg, record->rxThreshold);
+	return true;
+} // End PCD_ApplyCalibration()
+
+/**
+ * Calculates the check byte of a calibration record. Neither all 0x00 nor all 0xFF are valid records.
+ */
+byte MFRC522::PCD_CalibrationCheck(const CalibrationRecord *record	///< The record to check.
+									) {
+	return 0xA5 ^ record->rxGain ^ record->cwGsP ^ record->modGsP ^ record->rxThreshold ^ record->successRate;
+} // End PCD_CalibrationCheck()
+
+/**
+ * Sweeps one register over the candidate values and keeps the best one, see PCD_CalibrateAntenna().
+ * 
+ * @return true if a candidate was better than the best result so far.
+ */
+bool MFRC522::PCD_SweepRegister(	PCD_Register reg,			///< The register to sweep.
+									const byte *candidates,		///< Candidate values in PROGMEM.
+									byte count,					///< Number of candidates.
+									byte mask,					///< Bits of the register set by the candidates.
+									Uid *reference,				///< UID of the reference card, size 0 for any card.
+									byte attempts,				///< Selects per candidate.
+									byte *bestSuccess,			///< In/Out: Successful selects of the best setting so far.
+									uint32_t *bestMicros		///< In/Out: Average select time of the best setting so far.
+								) {
+	byte original = PCD_ReadRegister(reg);
+	byte best = original;
+	bool improved = false;
+	for (byte i = 0; i < count; i++) {
+		byte value = (original & ~mask) | (pgm_read_byte(&candidates[i]) & mask);
+		PCD_WriteRegister(reg, value);
+		uint32_t latency;
+		byte success = PCD_MeasureSelect(reference, attempts, &latency);
+		// More successes win, equal successes need a clearly lower latency
+		if (success > *bestSuccess || (success > 0 && success == *bestSuccess && latency < *bestMicros - *bestMicros / 16)) {
+			*bestSuccess = success;
+			*bestMicros = latency;
+			best = value;
+			improved = true;
+		}
+	}
+	PCD_WriteRegister(reg, best);
+	return improved;
+} // End PCD_SweepRegister()
+
+/**
+ * Wakes up, selects and halts the reference card a number of times with the current settings.
+ * 
+ * @return The number of successful selects.
+ */
+byte MFRC522::PCD_MeasureSelect(	Uid *reference,				///< In: UID of the reference card, size 0 for any card. Out: the UID found if size was 0.
+									byte attempts,				///< Number of selects.
+									uint32_t *averageMicros		///< Out: Average time of a successful wake up and select.
+								) {
+	byte success = 0;
+	uint32_t total = 0;
+	for (byte i = 0; i < attempts; i++) {
+		byte bufferATQA[2];
+		byte bufferSize = sizeof(bufferATQA);
+		Uid found;
+		uint32_t start = micros();
+		StatusCode result = PICC_WakeupA(bufferATQA, &bufferSize);
+		if (result == STATUS_OK || result == STATUS_COLLISION) {
+			result = MFRC522::PICC_Select(&found);	// No RATS, only ISO/IEC 14443-3
+		}
+		uint32_t elapsed = micros() - start;
+		if (result == STATUS_OK) {
+			if (reference->size == 0) {
+				*reference = found;
+			}
+			if (found.size == reference->size && memcmp(found.uidByte, reference->uidByte, found.size) == 0) {
+				success++;
+				total += elapsed;
+			}
+		}
+		PICC_HaltA();
+	}
+	*averageMicros = success ? total / success : UINT32_MAX;
+	return success;
+} // End PCD_MeasureSelect()
+
 /**
  * Performs a self-test of the MFRC522
  * See 16.1.1 in http://www.nxp.com/documents/data_sheet/MFRC522.pdf
@@ -324,13 +887,17 @@ void MFRC522::PCD_SetAntennaGain(byte mask) {
  * @return Whether or not the test passed. Or false if no firmware reference is available.
  */
 bool MFRC522::PCD_PerformSelfTest() {
+	MFRC522BusSession session(_transport);
+	ConfigSnapshot snapshot;
+	PCD_SaveConfig(snapshot);
+	
 	// This follows directly the steps outlined in 16.1.1
 	// 1. Perform a soft reset.
 	PCD_Reset();
 	
 	// 2. Clear the internal buffer by writing 25 bytes of 00h
 	byte ZEROES[25] = {0x00};
-	PCD_WriteRegister(FIFOLevelReg, 0x80);		// flush the FIFO buffer
+	PCD_WriteRegister(FIFOLevelReg, FIFOLevelReg_FlushBuffer::mask);		// flush the FIFO buffer
 	PCD_WriteRegister(FIFODataReg, 25, ZEROES);	// write 25 bytes of 00h to FIFO
 	PCD_WriteRegister(CommandReg, PCD_Mem);		// transfer to internal buffer
 	
@@ -387,24 +954,474 @@ bool MFRC522::PCD_PerformSelfTest() {
 			reference = MFRC522_firmware_referenceV2_0;
 			break;
 		default:	// Unknown version
-			return false; // abort test
+			reference = nullptr;
+			break;
 	}
 	
 	// Verify that the results match up to our expectations
-	for (uint8_t i = 0; i < 64; i++) {
-		if (result[i] != pgm_read_byte(&(reference[i]))) {
-			return false;
+	bool passed = reference != nullptr;
+	for (uint8_t i = 0; passed && i < 64; i++) {
+		passed = result[i] == pgm_read_byte(&(reference[i]));
+	}
+	
+	// 8. The PCD does not work after the test, "Auto self-test done" does not work as expected.
+	// Reset it and write the configuration from before the test back instead of a full PCD_Init().
+	PCD_Reset();
+	PCD_RestoreConfig(snapshot);
+	
+	return passed;
+} // End PCD_PerformSelfTest()
+
+/**
+ * Programs the MFRC522 timer used to detect that a PICC does not answer.
+ * The timer starts automatically at the end of each transmission (TAuto=1).
+ * The software deadline in PCD_CommunicateWithPICC() follows the timeout, so it must be set before a slow command.
+ * The longest possible timeout is about 39s.
+ */
+void MFRC522::PCD_SetTimeout(uint32_t timeoutMicros	///< Time to wait for the PICC's answer, in microseconds.
+							) {
+	// f_timer = 13.56 MHz / (2*TPreScaler+1) where TPreScaler = [TPrescaler_Hi:TPrescaler_Lo].
+	// TPrescaler_Hi are the four low bits in TModeReg. TPrescaler_Lo is TPrescalerReg.
+	uint16_t prescaler = 0x0A9;					// 169 => f_timer=40kHz, ie a timer period of 25μs.
+	uint32_t reload = (timeoutMicros + 24) / 25;
+	if (reload > 0xFFFF) {						// Longer than 1.6s, use the largest prescaler
+		prescaler = 0xFFF;						// 4095 => f_timer=1.655kHz, ie a timer period of 604μs.
+		reload = (timeoutMicros + 603) / 604;
+		if (reload > 0xFFFF) {
+			reload = 0xFFFF;
+		}
+	}
+	if (reload == 0) {
+		reload = 1;
+	}
+	PCD_WriteRegister(TModeReg, 0x80 | (prescaler >> 8));	// TAuto=1; timer starts automatically at the end of the transmission in all communication modes at all speeds
+	PCD_WriteRegister(TPrescalerReg, prescaler & 0xFF);
+	PCD_WriteRegister(TReloadRegH, reload >> 8);
+	PCD_WriteRegister(TReloadRegL, reload & 0xFF);
+	_timeoutMicros = timeoutMicros;
+} // End PCD_SetTimeout()
+
+/**
+ * Returns the timeout last programmed with PCD_SetTimeout().
+ * 
+ * @return The timeout in microseconds.
+ */
+uint32_t MFRC522::PCD_GetTimeout() {
+	return _timeoutMicros;
+} // End PCD_GetTimeout()
+
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_SPI
+/**
+ * Finds the highest SPI clock that works with the wiring of this reader, up to the 10MHz the MFRC522 accepts.
+ * The clock is stepped up from 1MHz. Each step reads VersionReg, writes a pattern through the FIFO and reads
+ * it back, and optionally lets the MFRC522 calculate the CRC_A of the pattern. The highest passing clock,
+ * lowered by marginSteps steps, is kept in this instance.
+ * Call it after PCD_Init() while no PICC communication is going on; the FIFO content is lost. The configuration
+ * registers are saved at 1MHz before the test and written back at the chosen clock, see PCD_SaveConfig().
+ * 
+ * @return The SPI clock in Hz now used, or 0 if the test failed even at 1MHz. The settings are unchanged then.
+ */
+uint32_t MFRC522::PCD_CalibrateSpiClock(	bool checkCRC,		///< Also compare the CRC_A calculated by the MFRC522, which needs a working chip and not only a working bus.
+											byte marginSteps	///< Number of clock steps below the highest passing one to use, 0 for none.
+										) {
+	static const byte clocksMHz[] PROGMEM = {1, 2, 4, 5, 6, 8, 10};
+	const byte steps = sizeof(clocksMHz);
+	SPISettings previousSettings = _transport.getSettings();
+	uint32_t previousClock = _transport.getClock();
+	byte crc[2];
+	ConfigSnapshot config;
+	
+	// Take the reference values at the lowest clock. A failing step may have garbled the register address of its
+	// FIFO and CommandReg writes, so the configuration is saved first and written back at the end.
+	_transport.setClock(1000000u);
+	PCD_SaveConfig(config);
+	byte version = PCD_ReadRegister(VersionReg);
+	if ((version == 0x00) || (version == 0xFF) || !PCD_CheckBusIntegrity(version, crc, false)) {
+		_transport.setSettings(previousSettings);
+		if (previousClock) {
+			_transport.setClock(previousClock);
+		}
+		PCD_InvalidateShadow();
+		PCD_RestoreConfig(config);
+		return 0;
+	}
+	if (checkCRC) {
+		byte pattern[FIFO_SIZE];
+		for (byte i = 0; i < FIFO_SIZE; i++) {
+			pattern[i] = (byte)(i * 0x3D) ^ ((i & 1) ? 0xAA : 0x55);
+		}
+		if (PCD_CalculateCRC(pattern, FIFO_SIZE, crc) != STATUS_OK) {
+			checkCRC = false;
 		}
 	}
 	
-	// 8. Perform a re-init, because PCD does not work after test.
-	// Reset does not work as expected.
-	// "Auto self-test done" does not work as expected.
-	PCD_Init();
+	// Step up until a test fails
+	byte best = 0;
+	for (byte step = 1; step < steps; step++) {
+		_transport.setClock(pgm_read_byte(&clocksMHz[step]) * 1000000u);
+		if (!PCD_CheckBusIntegrity(version, crc, checkCRC)) {
+			break;
+		}
+		best = step;
+	}
+	best = best > marginSteps ? best - marginSteps : 0;
+	
+	uint32_t clock = pgm_read_byte(&clocksMHz[best]) * 1000000u;
+	_transport.setClock(clock);
+	PCD_InvalidateShadow();					// The shadow may hold values of garbled writes
+	PCD_RestoreConfig(config);
+	PCD_WriteRegister(FIFOLevelReg, FIFOLevelReg_FlushBuffer::mask);		// Leave an empty FIFO
+	return clock;
+} // End PCD_CalibrateSpiClock()
+#endif
+
+/**
+ * Checks that register and FIFO accesses come through the bus unchanged, used by PCD_CalibrateSpiClock().
+ * 
+ * @return true if three rounds of VersionReg, FIFO and, if enabled, CRC_A checks passed.
+ */
+bool MFRC522::PCD_CheckBusIntegrity(	byte version,	///< The content of VersionReg read at a safe clock.
+										byte *crc,		///< The CRC_A of the test pattern calculated at a safe clock.
+										bool checkCRC	///< Whether to check the CRC_A.
+									) {
+	byte pattern[FIFO_SIZE];
+	byte buffer[FIFO_SIZE];
 	
-	// Test passed; all is good.
+	for (byte i = 0; i < FIFO_SIZE; i++) {
+		pattern[i] = (byte)(i * 0x3D) ^ ((i & 1) ? 0xAA : 0x55);	// All bit positions toggle between neighbouring bytes
+	}
+	for (byte round = 0; round < 3; round++) {
+		if (PCD_ReadRegister(VersionReg) != version) {
+			return false;
+		}
+		PCD_WriteRegister(CommandReg, PCD_Idle);		// Stop any active command.
+		PCD_WriteRegister(FIFOLevelReg, FIFOLevelReg_FlushBuffer::mask);			// FlushBuffer = 1, FIFO initialization
+		PCD_WriteRegister(FIFODataReg, FIFO_SIZE, pattern);
+		if (PCD_ReadRegister(FIFOLevelReg) != FIFO_SIZE) {
+			return false;
+		}
+		PCD_ReadRegister(FIFODataReg, FIFO_SIZE, buffer);
+		if (memcmp(pattern, buffer, FIFO_SIZE) != 0) {
+			return false;
+		}
+		if (checkCRC) {
+			byte result[2];
+			if (PCD_CalculateCRC(pattern, FIFO_SIZE, result) != STATUS_OK || result[0] != crc[0] || result[1] != crc[1]) {
+				return false;
+			}
+		}
+	}
 	return true;
-} // End PCD_PerformSelfTest()
+} // End PCD_CheckBusIntegrity()
+
+#if MFRC522_LINK_QUALITY
+/**
+ * Enables or disables adapting the reader to the link quality.
+ * When the share of answers with protocol, parity, CRC or buffer overflow errors rises above MFRC522_LINK_DEGRADE
+ * the next step of PCD_LinkLevel is taken, when it falls below MFRC522_LINK_RECOVER one step is taken back.
+ * Enabling takes the current RxGain and RxThresholdReg as the fast settings, disabling restores them.
+ */
+void MFRC522::PCD_SetLinkAdaptation(bool enable	///< true to adapt the settings.
+									) {
+	if (enable && !_linkAdaptation) {
+		_linkBaseGain = PCD_GetAntennaGain();
+		_linkBaseThreshold = PCD_ReadRegister(RxThresholdReg);
+		_linkQuality.level = LinkLevel_Fast;
+	}
+	else if (!enable && _linkAdaptation) {
+		PCD_ApplyLinkLevel(LinkLevel_Fast);
+	}
+	_linkAdaptation = enable;
+} // End PCD_SetLinkAdaptation()
+
+/**
+ * Returns the counters and the current step of the link quality control, e.g. to spot degraded readers.
+ */
+MFRC522::LinkQuality MFRC522::PCD_GetLinkQuality() {
+	return _linkQuality;
+} // End PCD_GetLinkQuality()
+
+/**
+ * Clears the link quality counters, the current step is kept.
+ */
+void MFRC522::PCD_ResetLinkQuality() {
+	byte level = _linkQuality.level;
+	_linkQuality = LinkQuality();
+	_linkQuality.level = level;
+} // End PCD_ResetLinkQuality()
+
+/**
+ * Counts the result of one exchange with a PICC and evaluates the link quality every MFRC522_LINK_WINDOW answers.
+ */
+void MFRC522::PCD_RecordLinkResult(	byte errorRegValue,		///< ErrorReg after the exchange.
+									bool timeout			///< true if the PICC did not answer.
+								) {
+	LinkQuality &q = _linkQuality;
+	q.exchanges++;
+	if (timeout) {
+		q.timeouts++;
+	}
+	for (byte bit = 0; bit < 8; bit++) {
+		if (errorRegValue & (1 << bit)) {
+			q.errors[bit]++;
+		}
+	}
+	
+	uint16_t answers = q.exchanges - q.timeouts;
+	if (answers < MFRC522_LINK_WINDOW && q.exchanges < 4 * MFRC522_LINK_WINDOW) {
+		return;
+	}
+	
+	// Collisions are normal during anticollision, timeouts while no PICC is in the field
+	uint32_t bad = (uint32_t)q.errors[0] + q.errors[1] + q.errors[2] + q.errors[4];
+	uint32_t rate = answers ? bad * 256 / answers : 0;
+	q.errorRate = rate > 255 ? 255 : rate;
+	rate = (uint32_t)q.timeouts * 256 / q.exchanges;
+	q.timeoutRate = rate > 255 ? 255 : rate;
+	
+	if (_linkAdaptation && answers >= MFRC522_LINK_WINDOW) {
+		if (q.errorRate > MFRC522_LINK_DEGRADE && q.level < LinkLevel_Threshold) {
+			PCD_ApplyLinkLevel(q.level + 1);
+		}
+		else if (q.errorRate < MFRC522_LINK_RECOVER && q.level > LinkLevel_Fast) {
+			PCD_ApplyLinkLevel(q.level - 1);
+		}
+	}
+	
+	// Keep a rolling history
+	q.exchanges /= 2;
+	q.timeouts /= 2;
+	for (byte bit = 0; bit < 8; bit++) {
+		q.errors[bit] /= 2;
+	}
+} // End PCD_RecordLinkResult()
+
+/**
+ * Writes the settings of a step of the link quality control.
+ */
+void MFRC522::PCD_ApplyLinkLevel(byte level	///< One of the PCD_LinkLevel enums.
+								) {
+	byte gain = _linkBaseGain >> 4;
+	if (level >= LinkLevel_Gain) {
+		// 000b and 010b are 18dB, 001b and 011b are 23dB
+		if (gain == 0 || gain == 2) {
+			gain = 1;
+		}
+		else if (gain == 1 || gain == 3) {
+			gain = 4;
+		}
+		else if (gain < 7) {
+			gain++;
+		}
+	}
+	PCD_SetAntennaGain(gain << 4);
+	
+	byte threshold = _linkBaseThreshold;
+	if (level >= LinkLevel_Threshold) {
+		byte minLevel = threshold >> 4;
+		minLevel = minLevel < 13 ? minLevel + 2 : 15;
+		threshold = (minLevel << 4) | (threshold & 0x0F);
+	}
+	PCD_WriteRegister(RxThresholdReg, threshold);
+	_linkQuality.level = level;
+} // End PCD_ApplyLinkLevel()
+#endif
+
+#if MFRC522_HEALTH
+/**
+ * Checks if the MFRC522 still works as PCD_Init() or *config left it. Reads VersionReg, ErrorReg and the registers
+ * PCD_Init() changed from their reset values, and looks at exchanges that did not finish.
+ * Takes a few register accesses, so it can run often. Do not call it in the middle of a PICC command.
+ * 
+ * @return Health_OK or the first fault found.
+ */
+MFRC522::PCD_Health MFRC522::PCD_CheckHealth(const ConfigSnapshot *config	///< The configuration the application keeps, see PCD_SaveConfig(). nullptr for the one of PCD_Init().
+											) {
+	PCD_Health health = PCD_ClassifyHealth(config);
+	_healthStats.checks++;
+	if (health != Health_OK) {
+		_healthStats.faults[health - 1]++;
+	}
+	return health;
+} // End PCD_CheckHealth()
+
+/**
+ * Classifies the state of the MFRC522 without counting, see PCD_CheckHealth().
+ */
+MFRC522::PCD_Health MFRC522::PCD_ClassifyHealth(const ConfigSnapshot *config	///< The expected configuration, nullptr for the one of PCD_Init().
+												) {
+	MFRC522BusSession session(_transport);
+	byte version = PCD_ReadRegister(VersionReg);
+	if (version == 0x00 || version == 0xFF) {
+		return Health_NoAnswer;
+	}
+	// ErrorReg[7..0] bits are: WrErr TempErr reserved BufferOvfl CollErr CRCErr ParityErr ProtocolErr
+	if (PCD_ReadRegister(ErrorReg) & (ErrorReg_WrErr::mask | ErrorReg_TempErr::mask)) {
+		return Health_ChipError;
+	}
+	// Registers the library does not change after PCD_Init(). A reset sets TxASKReg to 0x00, ModeReg to 0x3F and clears TAuto.
+	byte txASK = config ? PCD_ConfigValue(*config, TxASKReg) : PCD_InitValue(TxASKReg);
+	byte mode = config ? PCD_ConfigValue(*config, ModeReg) : PCD_InitValue(ModeReg);
+	byte tAuto = config ? PCD_ConfigValue(*config, TModeReg) & 0x80 : 0x80;	// PCD_SetTimeout() sets TAuto
+	if (PCD_ReadRegister(TxASKReg) != txASK ||
+		PCD_ReadRegister(ModeReg) != mode ||
+		(PCD_ReadRegister(TModeReg) & 0x80) != tAuto) {
+		return Health_ConfigLost;
+	}
+	if (_healthStalls >= MFRC522_HEALTH_STALLS) {
+		return Health_Stalled;
+	}
+	return Health_OK;
+} // End PCD_ClassifyHealth()
+
+/**
+ * Brings the MFRC522 back into *config, or the configuration of PCD_Init() without one, with the cheapest action
+ * that works: writing the configuration registers again, then a soft reset, then a hard reset through the reset pin.
+ * Starts with the soft reset if the MFRC522 did not answer or stalled, as writing the registers stops neither a stuck
+ * command nor the timer. Each step is checked with the health check, after a stall a CRC calculation must finish too.
+ * The link level and the timeout are kept.
+ * 
+ * @return true if the MFRC522 is healthy again.
+ */
+bool MFRC522::PCD_Recover(	PCD_Health health,				///< The fault found by PCD_CheckHealth().
+							const ConfigSnapshot *config	///< The configuration taken with PCD_SaveConfig(), nullptr for the one of PCD_Init().
+						) {
+	if (health == Health_OK) {
+		return true;
+	}
+	const uint32_t start = micros();
+	byte action = (health == Health_NoAnswer || health == Health_Stalled) ? Recovery_SoftReset : Recovery_Rewrite;
+	PCD_InvalidateShadow();		// The MFRC522 may have lost the values written
+	bool healthy = false;
+	
+	for (; action <= Recovery_HardReset && !healthy; action++) {
+		bool ready = true;
+		if (action == Recovery_SoftReset) {
+			ready = PCD_Reset();
+		}
+		else if (action == Recovery_HardReset) {
+			if (_resetPowerDownPin == UNUSED_PIN) {
+				break;
+			}
+			pinMode(_resetPowerDownPin, OUTPUT);
+			digitalWrite(_resetPowerDownPin, LOW);
+			delayMicroseconds(2);				// 8.8.1 Reset timing requirements says about 100ns
+			digitalWrite(_resetPowerDownPin, HIGH);	// Exit power down mode. This triggers a hard reset.
+			PCD_InvalidateShadow();
+			ready = PCD_WaitReady(micros());
+		}
+		if (ready) {
+			if (config) {
+				PCD_RestoreConfig(*config);
+			}
+			else {
+				PCD_WriteInitConfig(_timeoutMicros);
+			}
+#if MFRC522_LINK_QUALITY
+			if (_linkAdaptation) {
+				PCD_ApplyLinkLevel(_linkQuality.level);
+			}
+#endif
+			if (action != Recovery_Rewrite) {
+				_healthStalls = 0;				// The reset stopped any command
+			}
+			healthy = PCD_ClassifyHealth(config) == Health_OK;
+			if (healthy && health == Health_Stalled) {
+				byte data = 0x00;
+				byte crc[2];
+				healthy = PCD_CalculateCRC(&data, 1, crc) == STATUS_OK;
+			}
+		}
+	}
+	
+	_healthStats.lastMicros = micros() - start;
+	if (_healthStats.lastMicros > _healthStats.maxMicros) {
+		_healthStats.maxMicros = _healthStats.lastMicros;
+	}
+	if (healthy) {
+		_healthStats.recovered[action - 1]++;
+	}
+	else {
+		_healthStats.failed++;
+	}
+	return healthy;
+} // End PCD_Recover()
+
+/**
+ * Watchdog for the poll loop. Runs PCD_CheckHealth() every intervalMillis, or at once when
+ * MFRC522_HEALTH_STALLS exchanges in a row did not finish, and calls PCD_Recover() on a fault.
+ * Does nothing while the duty-cycled card detection keeps the MFRC522 powered down.
+ * 
+ * @return false if the MFRC522 is faulty and could not be recovered, true otherwise.
+ */
+bool MFRC522::PCD_HealthPoll(	uint32_t intervalMillis,		///< Milliseconds between two checks.
+								const ConfigSnapshot *config	///< The configuration to check and restore, see PCD_Recover().
+							) {
+#if MFRC522_LOW_POWER
+	if (_lowPowerPeriod) {
+		return true;
+	}
+#endif
+	if ((uint32_t)(millis() - _healthLastCheck) < intervalMillis && _healthStalls < MFRC522_HEALTH_STALLS) {
+		return true;
+	}
+	_healthLastCheck = millis();
+	PCD_Health health = PCD_CheckHealth(config);
+	return PCD_Recover(health, config);
+} // End PCD_HealthPoll()
+
+/**
+ * Returns the counters of the health watchdog.
+ */
+MFRC522::HealthStats MFRC522::PCD_GetHealthStats() {
+	return _healthStats;
+} // End PCD_GetHealthStats()
+#endif
+
+#if MFRC522_STATS
+/**
+ * Returns a snapshot of the performance counters, e.g. to spot a reader that retries a lot.
+ * The counters keep running, call PCD_ResetPerfStats() to start a new period.
+ */
+MFRC522::PerfStats MFRC522::PCD_GetPerfStats() {
+	PerfStats stats = _perfStats;
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_SPI
+	stats.spiTransactions = _transport.transactions;
+#endif
+	for (byte i = 0; i < OPERATION_COUNT; i++) {
+		OperationStats &operation = stats.operations[i];
+		operation.averageMicros = operation.count ? (uint32_t)(operation.totalMicros / operation.count) : 0;
+	}
+	return stats;
+} // End PCD_GetPerfStats()
+
+/**
+ * Clears all performance counters.
+ */
+void MFRC522::PCD_ResetPerfStats() {
+	_perfStats = PerfStats();
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_SPI
+	_transport.transactions = 0;
+#endif
+} // End PCD_ResetPerfStats()
+
+/**
+ * Adds the duration of one operation to its OperationStats, see OperationTimer.
+ */
+void MFRC522::PCD_RecordLatency(	PCD_Operation operation,	///< The operation that ended.
+									uint32_t duration			///< Its duration in microseconds.
+								) {
+	OperationStats &stats = _perfStats.operations[operation];
+	if (stats.count == 0 || duration < stats.minMicros) {
+		stats.minMicros = duration;
+	}
+	if (duration > stats.maxMicros) {
+		stats.maxMicros = duration;
+	}
+	stats.count++;
+	stats.totalMicros += duration;
+} // End PCD_RecordLatency()
+#endif
 
 /////////////////////////////////////////////////////////////////////////////////////
 // Power control
@@ -420,21 +1437,146 @@ void MFRC522::PCD_SoftPowerDown(){//Note : Only soft power down mode is availabl
 	PCD_WriteRegister(CommandReg, val);//write new value to the command register
 }
 
-void MFRC522::PCD_SoftPowerUp(){
+/**
+ * Leaves soft power-down mode and waits until the oscillator is running again.
+ * 
+ * @return true if the MFRC522 is ready, false if it did not wake up in time.
+ */
+bool MFRC522::PCD_SoftPowerUp(uint32_t timeoutMicros	///< Upper bound for the wake up, see PCD_GetTimeToReady() for the time it took.
+							) {
+	uint32_t start = micros();
 	byte val = PCD_ReadRegister(CommandReg); // Read state of the command register 
 	val &= ~(1<<4);// set PowerDown bit ( bit 4 ) to 0 
 	PCD_WriteRegister(CommandReg, val);//write new value to the command register
 	// wait until PowerDown bit is cleared (this indicates end of wake up procedure) 
-	const uint32_t timeout = (uint32_t)millis() + 500;// create timer for timeout (just in case) 
+	return PCD_WaitReady(start, timeoutMicros);
+} // End PCD_SoftPowerUp()
+
+#if MFRC522_LOW_POWER
+/**
+ * Starts duty-cycled card detection for battery powered readers.
+ * The reader sleeps between checks in soft power-down mode, or with only the antenna off, which wakes up faster but draws
+ * a few mA. Call PCD_LowPowerCheck() from loop(), the MCU may sleep in between.
+ * Each check wakes the reader, switches the field on for the wake budget, which gives the PICC time to power up
+ * (ISO/IEC 14443-3 allows it up to 5ms), and ends with one REQA with a short timeout.
+ */
+void MFRC522::PCD_LowPowerBegin(	uint32_t periodMillis,		///< Time between checks, e.g. 250ms.
+									uint32_t wakeBudgetMicros,	///< Time the field is on per check including the REQA. Lower it to save energy if your PICCs power up faster.
+									bool antennaOffOnly			///< true: keep the MFRC522 powered and only switch the antenna off between checks.
+								) {
+	_lowPowerPeriod = periodMillis > 0 ? periodMillis : 1;
+	_lowPowerBudget = wakeBudgetMicros;
+	_lowPowerAntennaOnly = antennaOffOnly;
+	_lowPowerStats = LowPowerStats();
+	_lowPowerLastWake = millis() - _lowPowerPeriod;		// Check at the first call
+	PCD_AntennaOff();
+	if (!_lowPowerAntennaOnly) {
+		PCD_WriteRegister(CommandReg, PCD_Idle);		// Power down without an active command
+		PCD_SoftPowerDown();
+	}
+} // End PCD_LowPowerBegin()
+
+/**
+ * Stops the duty-cycled card detection, the reader is powered and the antenna is on again.
+ */
+void MFRC522::PCD_LowPowerEnd() {
+	if (_lowPowerPeriod == 0) {
+		return;
+	}
+	_lowPowerPeriod = 0;
+	if (!_lowPowerAntennaOnly) {
+		PCD_SoftPowerUp();
+	}
+	PCD_AntennaOn();
+} // End PCD_LowPowerEnd()
+
+/**
+ * Checks for a card if the period set with PCD_LowPowerBegin() has passed since the last check.
+ * If a card answered the REQA the reader stays awake and the card is in READY state, so continue e.g. with
+ * PICC_ReadCardSerial() as after PICC_IsNewCardPresent(). The next check puts the reader to sleep again.
+ * 
+ * @return true if a card is present.
+ */
+bool MFRC522::PCD_LowPowerCheck() {
+	if (_lowPowerPeriod == 0) {
+		return false;
+	}
+	uint32_t now = millis();
+	if ((uint32_t)(now - _lowPowerLastWake) < _lowPowerPeriod) {
+		return false;
+	}
+	_lowPowerLastWake = now;
 	
-	while(millis()<=timeout){ // set timeout to 500 ms 
-		val = PCD_ReadRegister(CommandReg);// Read state of the command register
-		if(!(val & (1<<4))){ // if powerdown bit is 0 
-			break;// wake up procedure is finished 
+	uint32_t start = micros();
+	if (!_lowPowerAntennaOnly) {
+		PCD_SoftPowerUp(MFRC522_RESET_TIMEOUT_MS * 1000ul);
+	}
+	PCD_AntennaOn();
+	
+	// Let the PICC power up in the field, the REQA below takes about 300us
+	const uint32_t reqaMicros = 300;
+	uint32_t settle = _lowPowerBudget > reqaMicros ? _lowPowerBudget - reqaMicros : 0;
+	if (settle >= 1000) {
+		delay(settle / 1000);
+	}
+	delayMicroseconds(settle % 1000);
+	
+	uint32_t timeout = _timeoutMicros;
+	PCD_SetTimeout(reqaMicros);			// The ATQA starts 86us after the REQA
+	bool present = PICC_IsNewCardPresent();
+	PCD_SetTimeout(timeout);
+	
+	if (!present) {
+		PCD_AntennaOff();
+		if (!_lowPowerAntennaOnly) {
+			PCD_WriteRegister(CommandReg, PCD_Idle);
+			PCD_SoftPowerDown();
 		}
-		yield();
 	}
-}
+	
+	uint32_t awake = micros() - start;
+	_lowPowerStats.wakeUps++;
+	_lowPowerStats.wakeMicros += awake;
+	if (awake > _lowPowerStats.wakeMicrosMax) {
+		_lowPowerStats.wakeMicrosMax = awake;
+	}
+	if (present) {
+		_lowPowerStats.detections++;
+	}
+	return present;
+} // End PCD_LowPowerCheck()
+
+/**
+ * Returns the counters of the duty-cycled card detection since PCD_LowPowerBegin().
+ */
+MFRC522::LowPowerStats MFRC522::PCD_GetLowPowerStats() {
+	return _lowPowerStats;
+} // End PCD_GetLowPowerStats()
+
+/**
+ * Returns the average time a check of the duty-cycled card detection was awake, in microseconds.
+ */
+uint32_t MFRC522::PCD_GetLowPowerAverageWake() {
+	if (_lowPowerStats.wakeUps == 0) {
+		return 0;
+	}
+	return (uint32_t)(_lowPowerStats.wakeMicros / _lowPowerStats.wakeUps);
+} // End PCD_GetLowPowerAverageWake()
+
+/**
+ * Estimates the share of time the reader is awake in the duty-cycled card detection,
+ * from the average wake time and the period.
+ * 
+ * @return Duty cycle in parts per million, e.g. 20000 is 2%.
+ */
+uint32_t MFRC522::PCD_GetLowPowerDutyCycle() {
+	if (_lowPowerPeriod == 0) {
+		return 0;
+	}
+	uint64_t duty = (uint64_t)PCD_GetLowPowerAverageWake() * 1000 / _lowPowerPeriod;
+	return duty > 1000000 ? 1000000 : (uint32_t)duty;
+} // End PCD_GetLowPowerDutyCycle()
+#endif
 
 /////////////////////////////////////////////////////////////////////////////////////
 // Functions for communicating with PICCs
@@ -477,15 +1619,18 @@ MFRC522::StatusCode MFRC522::PCD_CommunicateWithPICC(	byte command,		///< The co
 	// Prepare values for BitFramingReg
 	byte txLastBits = validBits ? *validBits : 0;
 	byte bitFraming = (rxAlign << 4) + txLastBits;		// RxAlign = BitFramingReg[6..4]. TxLastBits = BitFramingReg[2..0]
+	MFRC522BusSession session(_transport);				// Hold the bus for all register accesses below
+	MFRC522_STATS_ADD(transceives, command == PCD_Transceive);
+	MFRC522_STATS_ADD(authents, command == PCD_MFAuthent);
 	
 	PCD_WriteRegister(CommandReg, PCD_Idle);			// Stop any active command.
 	PCD_WriteRegister(ComIrqReg, 0x7F);					// Clear all seven interrupt request bits
-	PCD_WriteRegister(FIFOLevelReg, 0x80);				// FlushBuffer = 1, FIFO initialization
+	PCD_WriteRegister(FIFOLevelReg, FIFOLevelReg_FlushBuffer::mask);				// FlushBuffer = 1, FIFO initialization
 	PCD_WriteRegister(FIFODataReg, sendLen, sendData);	// Write sendData to the FIFO
 	PCD_WriteRegister(BitFramingReg, bitFraming);		// Bit adjustments
 	PCD_WriteRegister(CommandReg, command);				// Execute the command
 	if (command == PCD_Transceive) {
-		PCD_SetRegisterBitMask(BitFramingReg, 0x80);	// StartSend=1, transmission of data starts
+		PCD_WriteField<BitFramingReg_StartSend>(1);	// Transmission of data starts
 	}
 	
 	// In PCD_Init() we set the TAuto flag in TModeReg. This means the timer
@@ -495,31 +1640,57 @@ MFRC522::StatusCode MFRC522::PCD_CommunicateWithPICC(	byte command,		///< The co
 	// `waitIRq` parameter define what bits constitute a completed command.
 	// When they are set in the ComIrqReg register, then the command is
 	// considered complete. If the command is not indicated as complete in
-	// ~36ms, then consider the command as timed out.
-	const uint32_t deadline = millis() + 36;
+	// the timer period + ~11ms, then consider the command as timed out.
+	const uint32_t deadline = millis() + _timeoutMicros / 1000 + 11;
 	bool completed = false;
 
 	do {
 		byte n = PCD_ReadRegister(ComIrqReg);	// ComIrqReg[7..0] bits are: Set1 TxIRq RxIRq IdleIRq HiAlertIRq LoAlertIRq ErrIRq TimerIRq
+		MFRC522_STATS_ADD(comIrqPolls, 1);
 		if (n & waitIRq) {					// One of the interrupts that signal success has been set.
 			completed = true;
 			break;
 		}
-		if (n & 0x01) {						// Timer interrupt - nothing received in 25ms
+		if (n & 0x01) {						// Timer interrupt - nothing received before the timeout
+#if MFRC522_LINK_QUALITY
+			PCD_RecordLinkResult(0, true);
+#endif
+			MFRC522_STATS_ADD(timeouts, 1);
+#if MFRC522_HEALTH
+			_healthStalls = 0;
+#endif
 			return STATUS_TIMEOUT;
 		}
+		session.suspend();
 		yield();
+		session.resume();
 	}
 	while (static_cast<uint32_t> (millis()) < deadline);
 
-	// 36ms and nothing happened. Communication with the MFRC522 might be down.
+	// The deadline passed and nothing happened. Communication with the MFRC522 might be down.
 	if (!completed) {
+#if MFRC522_LINK_QUALITY
+		PCD_RecordLinkResult(0, true);
+#endif
+		MFRC522_STATS_ADD(timeouts, 1);
+#if MFRC522_HEALTH
+		if (_healthStalls < 0xFF) {
+			_healthStalls++;
+		}
+#endif
 		return STATUS_TIMEOUT;
 	}
+#if MFRC522_HEALTH
+	_healthStalls = 0;
+#endif
 	
 	// Stop now if any errors except collisions were detected.
 	byte errorRegValue = PCD_ReadRegister(ErrorReg); // ErrorReg[7..0] bits are: WrErr TempErr reserved BufferOvfl CollErr CRCErr ParityErr ProtocolErr
-	if (errorRegValue & 0x13) {	 // BufferOvfl ParityErr ProtocolErr
+#if MFRC522_LINK_QUALITY
+	PCD_RecordLinkResult(errorRegValue, false);
+#endif
+	if (errorRegValue & (ErrorReg_BufferOvfl::mask | ErrorReg_ParityErr::mask | ErrorReg_ProtocolErr::mask)) {
+		MFRC522_STATS_ADD(errors, 1);
 		return STATUS_ERROR;
 	}
   
@@ -533,25 +1704,34 @@ MFRC522::StatusCode MFRC522::PCD_CommunicateWithPICC(	byte command,		///< The co
 		}
 		*backLen = n;											// Number of bytes returned
 		PCD_ReadRegister(FIFODataReg, n, backData, rxAlign);	// Get received data from FIFO
-		_validBits = PCD_ReadRegister(ControlReg) & 0x07;		// RxLastBits[2:0] indicates the number of valid bits in the last received byte. If this value is 000b, the whole byte is valid.
+		_validBits = PCD_ReadField<ControlReg_RxLastBits>();	// The number of valid bits in the last received byte. If this value is 000b, the whole byte is valid.
 		if (validBits) {
 			*validBits = _validBits;
 		}
 	}
 	
 	// Tell about collisions
-	if (errorRegValue & 0x08) {		// CollErr
+	if (errorRegValue & ErrorReg_CollErr::mask) {
+		MFRC522_STATS_ADD(collisions, 1);
 		return STATUS_COLLISION;
 	}
 	
+	// With RxCRCEn the MFRC522 checks and removes the CRC_A itself, a mismatch is only reported in ErrorReg
+	if (errorRegValue & ErrorReg_CRCErr::mask) {
+		MFRC522_STATS_ADD(crcErrors, 1);
+		return STATUS_CRC_WRONG;
+	}
+	
 	// Perform CRC_A validation if requested.
 	if (backData && backLen && checkCRC) {
 		// In this case a MIFARE Classic NAK is not OK.
 		if (*backLen == 1 && _validBits == 4) {
+			MFRC522_STATS_ADD(naks, 1);
 			return STATUS_MIFARE_NACK;
 		}
 		// We need at least the CRC_A value and all 8 bits of the last byte must be received.
 		if (*backLen < 2 || _validBits != 0) {
+			MFRC522_STATS_ADD(crcErrors, 1);
 			return STATUS_CRC_WRONG;
 		}
 		// Verify CRC_A - do our own calculation and store the control in controlBuffer.
@@ -561,6 +1741,10 @@ MFRC522::StatusCode MFRC522::PCD_CommunicateWithPICC(	byte command,		///< The co
 			return status;
 		}
 		if ((backData[*backLen - 2] != controlBuffer[0]) || (backData[*backLen - 1] != controlBuffer[1])) {
+#if MFRC522_LINK_QUALITY
+			_linkQuality.errors[2]++;			// Count like CRCErr of the MFRC522
+#endif
+			MFRC522_STATS_ADD(crcErrors, 1);
 			return STATUS_CRC_WRONG;
 		}
 	}
@@ -608,7 +1792,7 @@ MFRC522::StatusCode MFRC522::PICC_REQA_or_WUPA(	byte command, 		///< The command
 	if (bufferATQA == nullptr || *bufferSize < 2) {	// The ATQA response is 2 bytes long.
 		return STATUS_NO_ROOM;
 	}
-	PCD_ClearRegisterBitMask(CollReg, 0x80);		// ValuesAfterColl=1 => Bits received after collision are cleared.
+	PCD_WriteField<CollReg_ValuesAfterColl>(0);	// Bits received after a collision are cleared.
 	validBits = 7;									// For REQA and WUPA we need the short frame format - transmit only 7 bits of the last (and only) byte. TxLastBits = BitFramingReg[2..0]
 	status = PCD_TransceiveData(&command, 1, bufferATQA, bufferSize, &validBits);
 	if (status != STATUS_OK) {
@@ -640,6 +1824,8 @@ MFRC522::StatusCode MFRC522::PICC_REQA_or_WUPA(	byte command, 		///< The command
 MFRC522::StatusCode MFRC522::PICC_Select(	Uid *uid,			///< Pointer to Uid struct. Normally output, but can also be used to supply a known UID.
 											byte validBits		///< The number of known UID bits supplied in *uid. Normally 0. If set you must also supply uid->size.
 										 ) {
+	OperationTimer timer(*this, Operation_Select);
+	MFRC522BusSession session(_transport);		// One bus session for the whole anticollision loop
 	bool uidComplete;
 	bool selectDone;
 	bool useCascadeTag;
@@ -685,7 +1871,7 @@ MFRC522::StatusCode MFRC522::PICC_Select(	Uid *uid,			///< Pointer to Uid struct
 	}
 	
 	// Prepare MFRC522
-	PCD_ClearRegisterBitMask(CollReg, 0x80);		// ValuesAfterColl=1 => Bits received after collision are cleared.
+	PCD_WriteField<CollReg_ValuesAfterColl>(0);	// Bits received after a collision are cleared.
 	
 	// Repeat Cascade Level loop until we have a complete UID.
 	uidComplete = false;
@@ -780,10 +1966,10 @@ MFRC522::StatusCode MFRC522::PICC_Select(	Uid *uid,			///< Pointer to Uid struct
 			result = PCD_TransceiveData(buffer, bufferUsed, responseBuffer, &responseLength, &txLastBits, rxAlign);
 			if (result == STATUS_COLLISION) { // More than one PICC in the field => collision.
 				byte valueOfCollReg = PCD_ReadRegister(CollReg); // CollReg[7..0] bits are: ValuesAfterColl reserved CollPosNotValid CollPos[4:0]
-				if (valueOfCollReg & 0x20) { // CollPosNotValid
+				if (CollReg_CollPosNotValid::get(valueOfCollReg)) {
 					return STATUS_COLLISION; // Without a valid collision position we cannot continue
 				}
-				byte collisionPos = valueOfCollReg & 0x1F; // Values 0-31, 0 means bit 32.
+				byte collisionPos = CollReg_CollPos::get(valueOfCollReg); // Values 0-31, 0 means bit 32.
 				if (collisionPos == 0) {
 					collisionPos = 32;
 				}
@@ -849,6 +2035,84 @@ MFRC522::StatusCode MFRC522::PICC_Select(	Uid *uid,			///< Pointer to Uid struct
 	return STATUS_OK;
 } // End PICC_Select()
 
+/**
+ * Wakes up and selects a PICC whose UID is already known, e.g. after PICC_HaltA() or a failed authentication.
+ * Unlike PICC_Select() it sends no ANTICOLLISION frames: WUPA, then one SELECT per cascade level built from the UID.
+ * The CRC_A of the SELECT frames is calculated in software, so the CRC coprocessor is not involved.
+ * Other PICCs woken up by the WUPA do not match the UID and return to IDLE/HALT.
+ * Only ISO/IEC 14443-3, an ISO/IEC 14443-4 PICC needs RATS afterwards, see MFRC522Extended::PICC_RequestATS().
+ * 
+ * @return STATUS_OK on success, STATUS_TIMEOUT if the PICC is gone, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522::PICC_Reselect(	const Uid &uid	///< The UID of the PICC, e.g. uid after PICC_ReadCardSerial(). Size 4, 7 or 10.
+										) {
+	OperationTimer timer(*this, Operation_Select);
+	MFRC522BusSession session(_transport);
+	MFRC522::StatusCode result;
+	byte buffer[9];					// SELECT frame: SEL, NVB, 4 bytes UID CLn, BCC, CRC_A
+	byte response[3];				// SAK and CRC_A
+	byte responseLength;
+	byte validBits;
+	
+	if (uid.size != 4 && uid.size != 7 && uid.size != 10) {
+		return STATUS_INVALID;
+	}
+	byte levels = (uid.size - 1) / 3;
+	
+	// Reset baud rates, the PICC answers WUPA at 106 kBit/s
+	PCD_WriteRegister(TxModeReg, 0x00);
+	PCD_WriteRegister(RxModeReg, 0x00);
+	
+	responseLength = 2;
+	result = PICC_WakeupA(response, &responseLength);
+	if (result != STATUS_OK && result != STATUS_COLLISION) {	// The ATQA of other PICCs may collide with ours
+		return result;
+	}
+	
+	for (byte level = 0; level < levels; level++) {
+		PICC_SelectFrame(uid, level, buffer);
+		PICC_CalculateCRC_A(buffer, 7, &buffer[7]);
+		responseLength = sizeof(response);
+		validBits = 0;
+		result = PCD_TransceiveData(buffer, sizeof(buffer), response, &responseLength, &validBits);
+		if (result != STATUS_OK) {
+			return result;
+		}
+		if (responseLength != 3 || validBits != 0) {	// SAK must be exactly 24 bits (1 byte + CRC_A).
+			return STATUS_ERROR;
+		}
+		if (PICC_CRC_A(0x6363, response[0]) != (uint16_t)(response[1] | (response[2] << 8))) {
+			return STATUS_CRC_WRONG;
+		}
+		// The cascade bit has to match the UID size
+		if (((response[0] & 0x04) != 0) != (level + 1 < levels)) {
+			return STATUS_ERROR;
+		}
+	}
+	return STATUS_OK;
+} // End PICC_Reselect()
+
+/**
+ * Builds the SELECT frame of a complete UID for one cascade level, without CRC_A: SEL, NVB, UID CLn and BCC.
+ * See the description of the buffer in PICC_Select().
+ */
+void MFRC522::PICC_SelectFrame(	const Uid &uid,		///< UID of size 4, 7 or 10
+								byte level,			///< Cascade level minus 1, 0 to 2
+								byte *frame			///< Out: 7 bytes
+							) {
+	byte uidIndex = 3 * level;
+	byte index = 2;
+	frame[0] = PICC_CMD_SEL_CL1 + 2 * level;
+	frame[1] = 0x70;								// NVB: seven whole bytes
+	if (uid.size > uidIndex + 4) {					// More UID bytes follow in the next level
+		frame[index++] = PICC_CMD_CT;
+	}
+	while (index < 6) {
+		frame[index++] = uid.uidByte[uidIndex++];
+	}
+	frame[6] = frame[2] ^ frame[3] ^ frame[4] ^ frame[5];	// BCC
+} // End PICC_SelectFrame()
+
 /**
  * Instructs a PICC in state ACTIVE(*) to go to state HALT.
  *
@@ -858,14 +2122,8 @@ MFRC522::StatusCode MFRC522::PICC_HaltA() {
 	MFRC522::StatusCode result;
 	byte buffer[4];
 	
-	// Build command buffer
-	buffer[0] = PICC_CMD_HLTA;
-	buffer[1] = 0;
-	// Calculate CRC_A
-	result = PCD_CalculateCRC(buffer, 2, &buffer[2]);
-	if (result != STATUS_OK) {
-		return result;
-	}
+	// HLTA with its CRC_A
+	memcpy(buffer, MFRC522_FRAME_HLTA.data, sizeof(buffer));
 	
 	// Send the command.
 	// The standard says:
@@ -903,6 +2161,7 @@ MFRC522::StatusCode MFRC522::PCD_Authenticate(byte command,		///< PICC_CMD_MF_AU
 											MIFARE_Key *key,	///< Pointer to the Crypteo1 key to use (6 bytes)
 											Uid *uid			///< Pointer to Uid struct. The first 4 bytes of the UID is used.
 											) {
+	OperationTimer timer(*this, Operation_Authenticate);
 	byte waitIRq = 0x10;		// IdleIRq
 	
 	// Build command buffer
@@ -930,7 +2189,7 @@ MFRC522::StatusCode MFRC522::PCD_Authenticate(byte command,		///< PICC_CMD_MF_AU
  */
 void MFRC522::PCD_StopCrypto1() {
 	// Clear MFCrypto1On bit
-	PCD_ClearRegisterBitMask(Status2Reg, 0x08); // Status2Reg[7..0] bits are: TempSensClear I2CForceHS reserved reserved MFCrypto1On ModemState[2:0]
+	PCD_WriteField<Status2Reg_MFCrypto1On>(0);
 } // End PCD_StopCrypto1()
 
 /**
@@ -953,6 +2212,7 @@ MFRC522::StatusCode MFRC522::MIFARE_Read(	byte blockAddr, 	///< MIFARE Classic:
 											byte *buffer,		///< The buffer to store the data in
 											byte *bufferSize	///< Buffer size, at least 18 bytes. Also number of bytes returned if STATUS_OK.
 										) {
+	OperationTimer timer(*this, Operation_Read);
 	MFRC522::StatusCode result;
 	
 	// Sanity check
@@ -988,6 +2248,7 @@ MFRC522::StatusCode MFRC522::MIFARE_Write(	byte blockAddr, ///< MIFARE Classic:
 											byte *buffer,	///< The 16 bytes to write to the PICC
 											byte bufferSize	///< Buffer size, must be at least 16 bytes. Exactly 16 bytes are written.
 										) {
+	OperationTimer timer(*this, Operation_Write);
 	MFRC522::StatusCode result;
 	
 	// Sanity check
@@ -1287,6 +2548,7 @@ MFRC522::StatusCode MFRC522::PCD_MIFARE_Transceive(	byte *sendData,		///< Pointe
 		return STATUS_ERROR;
 	}
 	if (cmdBuffer[0] != MF_ACK) {
+		MFRC522_STATS_ADD(naks, 1);
 		return STATUS_MIFARE_NACK;
 	}
 	return STATUS_OK;
@@ -1393,6 +2655,7 @@ void MFRC522::PCD_DumpVersionToSerial() {
  */
 void MFRC522::PICC_DumpToSerial(Uid *uid	///< Pointer to Uid struct returned from a successful PICC_Select().
 								) {
+	MFRC522BusSession session(_transport);
 	MIFARE_Key key;
 	
 	// Dump UID, SAK and Type
@@ -1510,6 +2773,7 @@ void MFRC522::PICC_DumpMifareClassicSectorToSerial(Uid *uid,			///< Pointer to U
 													MIFARE_Key *key,	///< Key A for the sector.
 													byte sector			///< The sector to dump, 0..39.
 													) {
+	MFRC522BusSession session(_transport);
 	MFRC522::StatusCode status;
 	byte firstBlock;		// Address of lowest address to dump actually last block dumped)
 	byte no_of_blocks;		// Number of blocks in sector
@@ -1655,6 +2919,7 @@ void MFRC522::PICC_DumpMifareClassicSectorToSerial(Uid *uid,			///< Pointer to U
  * Dumps memory contents of a MIFARE Ultralight PICC.
  */
 void MFRC522::PICC_DumpMifareUltralightToSerial() {
+	MFRC522BusSession session(_transport);
 	MFRC522::StatusCode status;
 	byte byteCount;
 	byte buffer[18];
@@ -18,8 +18,59 @@
 #include <Arduino.h>
 #include <SPI.h>
 
-#ifndef MFRC522_SPICLOCK
-#define MFRC522_SPICLOCK (4000000u)	// MFRC522 accept upto 10MHz, set to 4MHz.
+#ifndef MFRC522_STATS
+#define MFRC522_STATS (0)			// 1 adds performance counters to every instance, see PCD_GetPerfStats(). Set it as a build flag.
+#endif
+#if MFRC522_STATS
+#define MFRC522_STATS_ADD(counter, value) (_perfStats.counter += (value))
+#else
+#define MFRC522_STATS_ADD(counter, value) ((void)0)
+#endif
+#ifndef MFRC522_SHADOW
+#if defined(__AVR__)
+#define MFRC522_SHADOW (0)			// Off on AVR, where 2 KB of RAM cannot spare the 54 bytes per instance. Set it to 1 as a build flag.
+#else
+#define MFRC522_SHADOW (1)			// Keeps the registers of SHADOW_REGISTERS in RAM so read-modify-write needs no read. 0 saves 54 bytes per instance.
+#endif
+#endif
+#ifndef MFRC522_LOW_POWER
+#define MFRC522_LOW_POWER (0)		// 1 adds the duty-cycled card detection PCD_LowPowerBegin() to every instance. Set it as a build flag.
+#endif
+#ifndef MFRC522_LINK_QUALITY
+#define MFRC522_LINK_QUALITY (0)	// 1 adds the link quality statistics and PCD_SetLinkAdaptation() to every instance. Set it as a build flag.
+#endif
+#ifndef MFRC522_HEALTH
+#define MFRC522_HEALTH (0)			// 1 adds the health watchdog PCD_HealthPoll() and its counters to every instance. Set it as a build flag.
+#endif
+#ifndef MFRC522_TRACE
+#define MFRC522_TRACE (0)			// Register accesses kept in the trace ring buffer of every instance, 0 for none. See PCD_DumpTrace().
+#endif
+#ifndef MFRC522_TRACE_PAYLOAD
+#define MFRC522_TRACE_PAYLOAD (0)	// Set to 1 to also trace the bytes of multi-byte accesses, needed to replay FIFO reads.
+#endif
+
+#include "MFRC522Transport.h"
+
+#ifndef MFRC522_RESET_TIMEOUT_MS
+#define MFRC522_RESET_TIMEOUT_MS (150)	// Upper bound to wait for the oscillator after a reset, the crystal usually needs a few ms.
+#endif
+#ifndef MFRC522_LINK_WINDOW
+#define MFRC522_LINK_WINDOW (32)		// Answers from PICCs between two evaluations of the link quality.
+#endif
+#ifndef MFRC522_LINK_DEGRADE
+#define MFRC522_LINK_DEGRADE (32)		// Error rate in 1/256 above which the link quality control takes the next robust step.
+#endif
+#ifndef MFRC522_LINK_RECOVER
+#define MFRC522_LINK_RECOVER (8)		// Error rate in 1/256 below which it returns one step towards the fast settings.
+#endif
+#ifndef MFRC522_HEALTH_INTERVAL_MS
+#define MFRC522_HEALTH_INTERVAL_MS (1000)	// Milliseconds between two checks of PCD_HealthPoll().
+#endif
+#ifndef MFRC522_HEALTH_STALLS
+#define MFRC522_HEALTH_STALLS (3)		// Exchanges in a row the MFRC522 did not finish before PCD_HealthPoll() checks at once.
+#endif
+#ifndef MFRC522_RESET_POLL_US
+#define MFRC522_RESET_POLL_US (100)		// Interval to check whether the MFRC522 is ready again.
 #endif
 
 // Firmware data for self-test
@@ -81,6 +132,14 @@ class MFRC522 {
 	static constexpr byte FIFO_SIZE = 64;		// The FIFO is 64 bytes.
 	// Default value for unused pin
 	static constexpr uint8_t UNUSED_PIN = UINT8_MAX;
+	// Default timeout for the communication with a PICC
+	static constexpr uint32_t DEFAULT_TIMEOUT = 25000;	// 25ms, in microseconds.
+	// Number of registers in a ConfigSnapshot
+	static constexpr byte CONFIG_REGISTERS = 23;
+	// Number of PCD_Operation enums
+	static constexpr byte OPERATION_COUNT = 5;
+	// Registers 0x00 to SHADOW_SIZE - 1 can be kept in the shadow, see SHADOW_REGISTERS
+	static constexpr byte SHADOW_SIZE = 0x30;
 
 	// MFRC522 registers. Described in chapter 9 of the datasheet.
 	// When using SPI all addresses are shifted one bit left in the "SPI address byte" (section 8.1.2.3)
@@ -158,6 +217,65 @@ class MFRC522 {
 		// 						  0x3F			// reserved for production tests
 	};
 	
+	// Registers whose writable bits only change when the library writes them, so the last value written is kept
+	// in the shadow and read-modify-write needs no read, see PCD_UpdateRegister(). One bit per register address.
+	// Status, IRQ, FIFO and command registers are changed by the MFRC522 and always read from it.
+	static constexpr uint64_t SHADOW_REGISTERS =
+			(1ULL << (ComIEnReg >> 1)) | (1ULL << (DivIEnReg >> 1)) | (1ULL << (WaterLevelReg >> 1)) |
+			(1ULL << (BitFramingReg >> 1)) | (1ULL << (CollReg >> 1)) |
+			(1ULL << (ModeReg >> 1)) | (1ULL << (TxModeReg >> 1)) | (1ULL << (RxModeReg >> 1)) |
+			(1ULL << (TxControlReg >> 1)) | (1ULL << (TxASKReg >> 1)) | (1ULL << (TxSelReg >> 1)) |
+			(1ULL << (RxSelReg >> 1)) | (1ULL << (RxThresholdReg >> 1)) | (1ULL << (DemodReg >> 1)) |
+			(1ULL << (MfTxReg >> 1)) | (1ULL << (MfRxReg >> 1)) | (1ULL << (SerialSpeedReg >> 1)) |
+			(1ULL << (ModWidthReg >> 1)) | (1ULL << (RFCfgReg >> 1)) | (1ULL << (GsNReg >> 1)) |
+			(1ULL << (CWGsPReg >> 1)) | (1ULL << (ModGsPReg >> 1)) | (1ULL << (TModeReg >> 1)) |
+			(1ULL << (TPrescalerReg >> 1)) | (1ULL << (TReloadRegH >> 1)) | (1ULL << (TReloadRegL >> 1));
+	
+	// How a field of a register is accessed, see PCD_Field
+	enum PCD_FieldKind : byte {
+		Field_Cached			= 0,		// Only changed by writes, read from the shadow if it is kept there
+		Field_Volatile			= 1,		// Status bits the MFRC522 changes, always read from the chip
+		Field_Strobe			= 2			// Write-only bits that trigger an action and read as 0, never kept in the shadow
+	};
+	
+	// A bit field of a register: Width bits from bit Offset on. Described in chapter 9 of the datasheet.
+	template <PCD_Register Reg, byte Offset, byte Width, PCD_FieldKind Kind>
+	struct PCD_Field {
+		static constexpr PCD_Register reg = Reg;
+		static constexpr PCD_FieldKind kind = Kind;
+		static constexpr byte mask = (byte)(((1 << Width) - 1) << Offset);
+		// The field value value in place, to be written or combined with other fields of the register
+		static constexpr byte set(byte value) { return (byte)((value << Offset) & mask); }
+		// The field value in the register value registerValue
+		static constexpr byte get(byte registerValue) { return (byte)((registerValue & mask) >> Offset); }
+	};
+	
+	// The register fields used by the library
+	typedef PCD_Field<ErrorReg, 7, 1, Field_Volatile>			ErrorReg_WrErr;
+	typedef PCD_Field<ErrorReg, 6, 1, Field_Volatile>			ErrorReg_TempErr;
+	typedef PCD_Field<ErrorReg, 4, 1, Field_Volatile>			ErrorReg_BufferOvfl;
+	typedef PCD_Field<ErrorReg, 3, 1, Field_Volatile>			ErrorReg_CollErr;
+	typedef PCD_Field<ErrorReg, 2, 1, Field_Volatile>			ErrorReg_CRCErr;
+	typedef PCD_Field<ErrorReg, 1, 1, Field_Volatile>			ErrorReg_ParityErr;
+	typedef PCD_Field<ErrorReg, 0, 1, Field_Volatile>			ErrorReg_ProtocolErr;
+	typedef PCD_Field<Status2Reg, 3, 1, Field_Volatile>			Status2Reg_MFCrypto1On;
+	typedef PCD_Field<FIFOLevelReg, 7, 1, Field_Strobe>			FIFOLevelReg_FlushBuffer;
+	typedef PCD_Field<FIFOLevelReg, 0, 7, Field_Volatile>		FIFOLevelReg_FIFOLevel;
+	typedef PCD_Field<ControlReg, 0, 3, Field_Volatile>			ControlReg_RxLastBits;
+	typedef PCD_Field<BitFramingReg, 7, 1, Field_Strobe>		BitFramingReg_StartSend;
+	typedef PCD_Field<BitFramingReg, 4, 3, Field_Cached>		BitFramingReg_RxAlign;
+	typedef PCD_Field<BitFramingReg, 0, 3, Field_Cached>		BitFramingReg_TxLastBits;
+	typedef PCD_Field<CollReg, 7, 1, Field_Cached>				CollReg_ValuesAfterColl;
+	typedef PCD_Field<CollReg, 5, 1, Field_Volatile>			CollReg_CollPosNotValid;
+	typedef PCD_Field<CollReg, 0, 5, Field_Volatile>			CollReg_CollPos;
+	typedef PCD_Field<TxModeReg, 7, 1, Field_Cached>			TxModeReg_TxCRCEn;
+	typedef PCD_Field<TxModeReg, 4, 3, Field_Cached>			TxModeReg_TxSpeed;
+	typedef PCD_Field<RxModeReg, 7, 1, Field_Cached>			RxModeReg_RxCRCEn;
+	typedef PCD_Field<RxModeReg, 4, 3, Field_Cached>			RxModeReg_RxSpeed;
+	typedef PCD_Field<TxControlReg, 1, 1, Field_Cached>			TxControlReg_Tx2RFEn;
+	typedef PCD_Field<TxControlReg, 0, 1, Field_Cached>			TxControlReg_Tx1RFEn;
+	typedef PCD_Field<RFCfgReg, 4, 3, Field_Cached>				RFCfgReg_RxGain;
+	
 	// MFRC522 commands. Described in chapter 10 of the datasheet.
 	enum PCD_Command : byte {
 		PCD_Idle				= 0x00,		// no action, cancels current command execution
@@ -188,6 +306,47 @@ class MFRC522 {
 		RxGain_max				= 0x07 << 4		// 111b - 48 dB, maximum, convenience for RxGain_48dB
 	};
 	
+	// Steps of the adaptive link quality control, see PCD_SetLinkAdaptation(). Each step includes the ones before.
+	enum PCD_LinkLevel : byte {
+		LinkLevel_Fast			= 0,		// The configured settings and the highest ISO-DEP bit rate
+		LinkLevel_BitRate		= 1,		// ISO-DEP stays at 106 kBit/s
+		LinkLevel_Gain			= 2,		// Receiver gain one step higher
+		LinkLevel_Threshold		= 3			// MinLevel in RxThresholdReg two steps higher to ignore weak noise
+	};
+	
+	// Results of the health check, see PCD_CheckHealth()
+	enum PCD_Health : byte {
+		Health_OK				= 0,
+		Health_NoAnswer			= 1,		// VersionReg reads 0x00 or 0xFF: bus fault, power loss or hard power-down
+		Health_ChipError		= 2,		// TempErr or WrErr in ErrorReg
+		Health_ConfigLost		= 3,		// Registers written by PCD_Init() have their reset values: brown-out or glitch on NRSTPD
+		Health_Stalled			= 4			// Exchanges end neither with an IRQ nor with the timer, the timer or the command is stuck
+	};
+	
+	// Steps of the recovery, cheapest first, see PCD_Recover()
+	enum PCD_RecoveryAction : byte {
+		Recovery_Rewrite		= 0,		// Write the configuration registers again
+		Recovery_SoftReset		= 1,		// SoftReset command and rewrite
+		Recovery_HardReset		= 2			// Pulse NRSTPD and rewrite, needs the reset pin
+	};
+	
+	// Operations whose latency is measured with MFRC522_STATS, see PCD_GetPerfStats()
+	enum PCD_Operation : byte {
+		Operation_Select		= 0,		// PICC_Select() and PICC_Reselect()
+		Operation_Authenticate	= 1,		// PCD_Authenticate()
+		Operation_Read			= 2,		// MIFARE_Read()
+		Operation_Write			= 3,		// MIFARE_Write()
+		Operation_TCLTransceive	= 4			// MFRC522Extended::TCL_Transceive() of an APDU
+	};
+	
+	// Registers swept by PCD_CalibrateAntenna() in addition to RxGain
+	enum PCD_CalibrationOption : byte {
+		Calibrate_CWGsP			= 0x01,		// Conductance of the p-driver without modulation, i.e. field strength
+		Calibrate_ModGsP		= 0x02,		// Conductance of the p-driver during modulation, only used if Force100ASK in TxASKReg is cleared
+		Calibrate_RxThreshold	= 0x04,		// MinLevel and CollLevel of the bit decoder
+		Calibrate_All			= 0x07
+	};
+	
 	// Commands sent to the PICC.
 	enum PICC_Command : byte {
 		// The commands used by the PCD to manage communication with several PICCs (ISO 14443-3, Type A, section 6.4)
@@ -263,6 +422,102 @@ class MFRC522 {
 		byte		keyByte[MF_KEY_SIZE];
 	} MIFARE_Key;
 	
+	// A struct used for a short frame of a fixed PICC command with its CRC_A appended, see PICC_FixedFrame().
+	typedef struct {
+		byte		data[4];		// Command bytes, then CRC_A low byte first
+		byte		size;			// Number of bytes in data, CRC_A included
+	} FixedFrame;
+	
+#if MFRC522_LOW_POWER
+	// A struct used for reporting the duty-cycled card detection, see PCD_LowPowerBegin()
+	typedef struct {
+		uint32_t	wakeUps;		// Number of checks for a card
+		uint32_t	detections;		// Checks that found a card
+		uint64_t	wakeMicros;		// Total time awake during the checks
+		uint32_t	wakeMicrosMax;	// Longest check
+	} LowPowerStats;
+#endif
+	
+	// A struct used for storing the writable configuration registers, see PCD_SaveConfig()
+	typedef struct {
+		byte		values[CONFIG_REGISTERS];	// Register values in the order of PCD_ConfigRegisters in MFRC522.cpp
+		uint32_t	timeoutMicros;				// Timeout the timer registers belong to, see PCD_SetTimeout()
+	} ConfigSnapshot;
+	
+#if MFRC522_HEALTH
+	// A struct used for reporting the health watchdog, see PCD_HealthPoll()
+	typedef struct {
+		uint16_t	checks;			// Health checks done
+		uint16_t	faults[4];		// Faults found, per PCD_Health enum starting with Health_NoAnswer
+		uint16_t	recovered[3];	// Successful recoveries, per PCD_RecoveryAction enum that fixed the fault
+		uint16_t	failed;			// Recoveries that did not help, even after the last step
+		uint32_t	lastMicros;		// Duration of the last recovery
+		uint32_t	maxMicros;		// Longest recovery
+	} HealthStats;
+#endif
+	
+#if MFRC522_LINK_QUALITY
+	// A struct used for reporting the link quality, see PCD_GetLinkQuality().
+	typedef struct {
+		uint16_t	exchanges;		// Exchanges with PICCs in the rolling window. All counts are halved at each evaluation.
+		uint16_t	timeouts;		// Exchanges without an answer, also counts REQA without a card in the field
+		uint16_t	errors[8];		// Count per ErrorReg bit: ProtocolErr ParityErr CRCErr CollErr BufferOvfl reserved TempErr WrErr
+		byte		errorRate;		// Answers with protocol, parity, CRC or overflow errors at the last evaluation, in 1/256
+		byte		timeoutRate;	// Timeouts at the last evaluation, in 1/256
+		byte		level;			// Current step, one of the PCD_LinkLevel enums
+	} LinkQuality;
+#endif
+	
+	// A struct used for storing the antenna calibration, e.g. in EEPROM. See PCD_CalibrateAntenna().
+	typedef struct {
+		byte		rxGain;			// RFCfgReg RxGain bits, one of the PCD_RxGain enums
+		byte		cwGsP;			// CWGsPReg
+		byte		modGsP;			// ModGsPReg
+		byte		rxThreshold;	// RxThresholdReg
+		byte		successRate;	// Percentage of successful selects with these settings
+		byte		check;			// Check byte over the bytes above
+	} CalibrationRecord;
+	
+#if MFRC522_STATS
+	// A struct used for reporting the latency of one PCD_Operation, see PerfStats.
+	typedef struct {
+		uint32_t	count;			// Calls, successful or not
+		uint32_t	minMicros;
+		uint32_t	maxMicros;
+		uint32_t	averageMicros;	// Filled in by PCD_GetPerfStats()
+		uint64_t	totalMicros;
+	} OperationStats;
+	
+	// A struct used for reporting the performance counters, see PCD_GetPerfStats().
+	typedef struct {
+		uint32_t	spiTransactions;	// beginTransaction() calls, 0 with other transports. A MFRC522BusSession holds one over many frames.
+		uint32_t	busFrames;		// Register accesses, i.e. chip select cycles with SPI
+		uint32_t	busBytes;		// Bytes sent and received on the bus, address bytes included
+		uint32_t	transceives;	// PCD_CommunicateWithPICC() calls with PCD_Transceive
+		uint32_t	authents;		// PCD_CommunicateWithPICC() calls with PCD_MFAuthent
+		uint32_t	comIrqPolls;	// Reads of ComIrqReg waiting for the end of a command
+		uint32_t	divIrqPolls;	// Reads of DivIrqReg waiting for the CRC coprocessor
+		uint32_t	timeouts;		// Exchanges without an answer, also REQA without a card in the field
+		uint32_t	collisions;
+		uint32_t	crcErrors;		// CRCErr of the MFRC522 or a wrong CRC_A in the answer
+		uint32_t	errors;			// BufferOvfl, ParityErr or ProtocolErr
+		uint32_t	naks;			// MIFARE NAK instead of ACK or data
+		uint32_t	shadowHits;		// Register reads saved by the shadow, see PCD_UpdateRegister()
+		OperationStats operations[OPERATION_COUNT];	// Per PCD_Operation enum
+	} PerfStats;
+#endif
+	
+#if MFRC522_TRACE
+	// A struct used for one register access in the trace, see PCD_DumpTrace().
+	typedef struct {
+		uint32_t	micros;			// micros() at the access
+		byte		address;		// Address byte as on SPI: bit 7 set for reading, the register in bits 6..1, bit 0 set for a multi-byte access
+		byte		value;			// Value read or written, the number of bytes of a multi-byte access
+		byte		first;			// First byte of a multi-byte access, e.g. the PICC command in the FIFO
+		byte		digest;			// CRC-8 (polynomial 0x07) over all bytes of a multi-byte access
+	} TraceRecord;
+#endif
+	
 	// Member variables
 	Uid uid;								// Used by PICC_ReadCardSerial().
 	
@@ -272,6 +527,10 @@ class MFRC522 {
 	MFRC522();
 	MFRC522(byte resetPowerDownPin);
 	MFRC522(byte chipSelectPin, byte resetPowerDownPin);
+	MFRC522(const MFRC522Transport &transport, byte resetPowerDownPin);
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_SPI
+	MFRC522(byte chipSelectPin, byte resetPowerDownPin, SPIClass &spi, const SPISettings &settings = SPISettings(MFRC522_SPICLOCK, MSBFIRST, SPI_MODE0));
+#endif
 	
 	/////////////////////////////////////////////////////////////////////////////////////
 	// Basic interface functions for communicating with the MFRC522
@@ -280,9 +539,58 @@ class MFRC522 {
 	void PCD_WriteRegister(PCD_Register reg, byte count, byte *values);
 	byte PCD_ReadRegister(PCD_Register reg);
 	void PCD_ReadRegister(PCD_Register reg, byte count, byte *values, byte rxAlign = 0);
+	MFRC522Transport &PCD_GetTransport() { return _transport; };
 	void PCD_SetRegisterBitMask(PCD_Register reg, byte mask);
 	void PCD_ClearRegisterBitMask(PCD_Register reg, byte mask);
+	void PCD_UpdateRegister(PCD_Register reg, byte mask, byte value);
+	void PCD_InvalidateShadow();
+	// In 32 bit halves, AVR has no 64 bit shift instruction
+	static constexpr bool PCD_IsShadowed(PCD_Register reg) {
+		return (reg >> 1) < 32 ? (((uint32_t)SHADOW_REGISTERS >> (reg >> 1)) & 1)
+				: ((reg >> 1) < SHADOW_SIZE && (((uint32_t)(SHADOW_REGISTERS >> 32) >> ((reg >> 1) - 32)) & 1));
+	}
+	// Strobe bits of a register, they are not kept in the shadow
+	static constexpr byte PCD_StrobeBits(PCD_Register reg) {
+		return reg == BitFramingReg ? BitFramingReg_StartSend::mask : 0;
+	}
+	// Reads a field, Field_Cached fields from the shadow
+	template <typename Field>
+	byte PCD_ReadField() {
+		static_assert(Field::kind != Field_Cached || PCD_IsShadowed(Field::reg), "Field_Cached fields need a register in SHADOW_REGISTERS");
+		static_assert(Field::kind != Field_Strobe, "Strobe bits read as 0");
+		return Field::get(Field::kind == Field_Cached ? PCD_ReadShadow(Field::reg) : PCD_ReadRegister(Field::reg));
+	}
+	// Sets a field, the other bits of the register keep their value
+	template <typename Field>
+	void PCD_WriteField(byte value) {
+		PCD_UpdateRegister(Field::reg, Field::mask, Field::set(value));
+	}
+	// Sets two fields of one register with a single write
+	template <typename Field, typename Other>
+	void PCD_WriteFields(byte value, byte other) {
+		static_assert(Field::reg == Other::reg, "Only fields of one register are written together");
+		PCD_UpdateRegister(Field::reg, Field::mask | Other::mask, Field::set(value) | Other::set(other));
+	}
 	StatusCode PCD_CalculateCRC(byte *data, byte length, byte *result);
+	// CRC_A (ISO/IEC 14443-3 annex B) of value added to crc, polynomial 0x8408 LSB first. It is constexpr,
+	// so the compiler computes the CRC_A of constant frames. Start with crc = 0x6363.
+	static constexpr uint16_t PICC_CRC_A(uint16_t crc, byte value, byte bits = 8) {
+		return bits == 0 ? crc : PICC_CRC_A(((crc ^ value) & 0x01) ? (crc >> 1) ^ 0x8408 : crc >> 1, value >> 1, bits - 1);
+	}
+	static constexpr FixedFrame PICC_FixedFrame(byte first) {
+		return FixedFrame{ { first, (byte)PICC_CRC_A(0x6363, first), (byte)(PICC_CRC_A(0x6363, first) >> 8), 0 }, 3 };
+	}
+	static constexpr FixedFrame PICC_FixedFrame(byte first, byte second) {
+		return FixedFrame{ { first, second, (byte)PICC_CRC_A(PICC_CRC_A(0x6363, first), second),
+				(byte)(PICC_CRC_A(PICC_CRC_A(0x6363, first), second) >> 8) }, 4 };
+	}
+	static void PICC_CalculateCRC_A(const byte *data, byte length, byte *result);
+#if MFRC522_TRACE
+	void PCD_SetTracing(bool enable);
+	void PCD_ClearTrace();
+	uint16_t PCD_GetTrace(TraceRecord *records, uint16_t maxRecords);
+	size_t PCD_DumpTrace(Print &out);
+#endif
 	
 	/////////////////////////////////////////////////////////////////////////////////////
 	// Functions for manipulating the MFRC522
@@ -290,18 +598,55 @@ class MFRC522 {
 	void PCD_Init();
 	void PCD_Init(byte resetPowerDownPin);
 	void PCD_Init(byte chipSelectPin, byte resetPowerDownPin);
-	void PCD_Reset();
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_SPI
+	void PCD_Init(byte chipSelectPin, byte resetPowerDownPin, SPIClass &spi, const SPISettings &settings = SPISettings(MFRC522_SPICLOCK, MSBFIRST, SPI_MODE0));
+#endif
+	bool PCD_Reset();
+	uint32_t PCD_GetTimeToReady();
 	void PCD_AntennaOn();
 	void PCD_AntennaOff();
 	byte PCD_GetAntennaGain();
 	void PCD_SetAntennaGain(byte mask);
+	StatusCode PCD_CalibrateAntenna(CalibrationRecord *record, byte options = 0, byte attempts = 10);
+	bool PCD_ApplyCalibration(const CalibrationRecord *record);
+	static byte PCD_CalibrationCheck(const CalibrationRecord *record);
+#if MFRC522_LINK_QUALITY
+	void PCD_SetLinkAdaptation(bool enable);
+	LinkQuality PCD_GetLinkQuality();
+	void PCD_ResetLinkQuality();
+#endif
+	void PCD_SaveConfig(ConfigSnapshot &snapshot);
+	void PCD_RestoreConfig(const ConfigSnapshot &snapshot);
 	bool PCD_PerformSelfTest();
+#if MFRC522_HEALTH
+	PCD_Health PCD_CheckHealth(const ConfigSnapshot *config = nullptr);
+	bool PCD_Recover(PCD_Health health, const ConfigSnapshot *config = nullptr);
+	bool PCD_HealthPoll(uint32_t intervalMillis = MFRC522_HEALTH_INTERVAL_MS, const ConfigSnapshot *config = nullptr);
+	HealthStats PCD_GetHealthStats();
+#endif
+#if MFRC522_STATS
+	PerfStats PCD_GetPerfStats();
+	void PCD_ResetPerfStats();
+#endif
+	void PCD_SetTimeout(uint32_t timeoutMicros);
+	uint32_t PCD_GetTimeout();
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_SPI
+	uint32_t PCD_CalibrateSpiClock(bool checkCRC = true, byte marginSteps = 1);
+#endif
 	
 	/////////////////////////////////////////////////////////////////////////////////////
 	// Power control functions
 	/////////////////////////////////////////////////////////////////////////////////////
 	void PCD_SoftPowerDown();
-	void PCD_SoftPowerUp();
+	bool PCD_SoftPowerUp(uint32_t timeoutMicros = 500000ul);
+#if MFRC522_LOW_POWER
+	void PCD_LowPowerBegin(uint32_t periodMillis, uint32_t wakeBudgetMicros = 5000, bool antennaOffOnly = false);
+	void PCD_LowPowerEnd();
+	bool PCD_LowPowerCheck();
+	LowPowerStats PCD_GetLowPowerStats();
+	uint32_t PCD_GetLowPowerAverageWake();
+	uint32_t PCD_GetLowPowerDutyCycle();
+#endif
 	
 	/////////////////////////////////////////////////////////////////////////////////////
 	// Functions for communicating with PICCs
@@ -312,6 +657,7 @@ class MFRC522 {
 	StatusCode PICC_WakeupA(byte *bufferATQA, byte *bufferSize);
 	StatusCode PICC_REQA_or_WUPA(byte command, byte *bufferATQA, byte *bufferSize);
 	virtual StatusCode PICC_Select(Uid *uid, byte validBits = 0);
+	StatusCode PICC_Reselect(const Uid &uid);
 	StatusCode PICC_HaltA();
 
 	/////////////////////////////////////////////////////////////////////////////////////
@@ -363,9 +709,81 @@ class MFRC522 {
 	virtual bool PICC_ReadCardSerial();
 	
 protected:
-	byte _chipSelectPin;		// Arduino pin connected to MFRC522's SPI slave select input (Pin 24, NSS, active low)
+	MFRC522Transport _transport;	// Bus the MFRC522 is connected to, see MFRC522Transport.h
 	byte _resetPowerDownPin;	// Arduino pin connected to MFRC522's reset and power down input (Pin 6, NRSTPD, active low)
+	uint32_t _timeoutMicros;	// Timeout currently programmed into the MFRC522 timer, see PCD_SetTimeout()
 	StatusCode MIFARE_TwoStepHelper(byte command, byte blockAddr, int32_t data);
+	bool PCD_CheckBusIntegrity(byte version, byte *crc, bool checkCRC);
+	uint32_t _timeToReady;		// Microseconds from the last reset until the MFRC522 answered, see PCD_GetTimeToReady()
+	bool PCD_WaitReady(uint32_t start, uint32_t timeoutMicros = MFRC522_RESET_TIMEOUT_MS * 1000ul);
+#if MFRC522_LOW_POWER
+	uint32_t _lowPowerPeriod;		// Milliseconds between checks, 0 if the low power mode is off
+	uint32_t _lowPowerBudget;		// Microseconds the field is on per check
+	uint32_t _lowPowerLastWake;		// millis() of the last check
+	bool _lowPowerAntennaOnly;		// Only switch the antenna off between checks
+	LowPowerStats _lowPowerStats;
+#endif
+#if MFRC522_LINK_QUALITY
+	LinkQuality _linkQuality;
+	bool _linkAdaptation;			// Adapt the settings to the link quality
+	byte _linkBaseGain;				// RxGain and RxThresholdReg of LinkLevel_Fast
+	byte _linkBaseThreshold;
+	void PCD_RecordLinkResult(byte errorRegValue, bool timeout);
+	void PCD_ApplyLinkLevel(byte level);
+#endif
+#if MFRC522_HEALTH
+	HealthStats _healthStats;
+	uint32_t _healthLastCheck;		// millis() of the last check of PCD_HealthPoll()
+	byte _healthStalls;				// Exchanges in a row that did not finish, see PCD_CommunicateWithPICC()
+#endif
+	static void PICC_SelectFrame(const Uid &uid, byte level, byte *frame);
+#if MFRC522_SHADOW
+	byte _shadow[SHADOW_SIZE];		// Last value of the registers in SHADOW_REGISTERS, strobe bits cleared
+	byte _shadowValid[SHADOW_SIZE / 8];	// Bit per register: _shadow holds its value
+#endif
+	byte PCD_ReadShadow(PCD_Register reg);
+#if MFRC522_HEALTH
+	byte PCD_ConfigValue(const ConfigSnapshot &snapshot, PCD_Register reg);
+	PCD_Health PCD_ClassifyHealth(const ConfigSnapshot *config);
+#endif
+	void PCD_WriteInitConfig(uint32_t timeoutMicros);
+	byte PCD_MeasureSelect(Uid *reference, byte attempts, uint32_t *averageMicros);
+	bool PCD_SweepRegister(PCD_Register reg, const byte *candidates, byte count, byte mask, Uid *reference, byte attempts, byte *bestSuccess, uint32_t *bestMicros);
+#if MFRC522_STATS
+	PerfStats _perfStats;
+	void PCD_RecordLatency(PCD_Operation operation, uint32_t duration);
+	
+	// Measures one PCD_Operation from the constructor to the destructor, i.e. over all return paths
+	class OperationTimer {
+	public:
+		OperationTimer(MFRC522 &owner, PCD_Operation operation) : _owner(owner), _operation(operation), _start(micros()) {}
+		~OperationTimer() { _owner.PCD_RecordLatency(_operation, micros() - _start); }
+		OperationTimer(const OperationTimer &) = delete;
+		OperationTimer &operator=(const OperationTimer &) = delete;
+	private:
+		MFRC522 &_owner;
+		PCD_Operation _operation;
+		uint32_t _start;
+	};
+#else
+	class OperationTimer {
+	public:
+		OperationTimer(MFRC522 &owner, PCD_Operation operation) { (void)owner; (void)operation; }
+	};
+#endif
+#if MFRC522_TRACE
+	TraceRecord _trace[MFRC522_TRACE];	// Ring buffer of the last register accesses
+	uint16_t _traceNext;			// Index of the next record to write
+	uint16_t _traceCount;			// Valid records, up to MFRC522_TRACE
+	bool _tracing;					// Recording, see PCD_SetTracing()
+	void PCD_TraceAccess(byte address, byte value, const byte *payload);
+	void PCD_TraceAppend(uint32_t time, byte address, byte value, byte first, byte digest);
+#endif
 };
 
+// Frames of fixed PICC commands with their CRC_A, computed by the compiler
+constexpr MFRC522::FixedFrame MFRC522_FRAME_HLTA = MFRC522::PICC_FixedFrame(MFRC522::PICC_CMD_HLTA, 0x00);
+// ISO/IEC 14443-3 6.3.3 gives HLTA as 50 00 57 CD
+static_assert(MFRC522_FRAME_HLTA.data[2] == 0x57 && MFRC522_FRAME_HLTA.data[3] == 0xCD, "PICC_CRC_A() does not match the CRC_A of HLTA");
+
 #endif
@@ -26,11 +26,16 @@
  * 		double				 7						2				MIFARE Ultralight
  * 		triple				10						3				Not currently in use?
  * 
+ * If the member tag holds an activated PICC, that PICC is deselected first and the PICCs are invited again with REQA,
+ * so a PICC woken from HALT with PICC_WakeupA() is not found then. PICC_IsNewCardPresent() deselects it before REQA.
+ * 
  * @return STATUS_OK on success, STATUS_??? otherwise.
  */
 MFRC522::StatusCode MFRC522Extended::PICC_Select(	Uid *uid,			///< Pointer to Uid struct. Normally output, but can also be used to supply a known UID.
 											byte validBits		///< The number of known UID bits supplied in *uid. Normally 0. If set you must also supply uid->size.
 										 ) {
+	OperationTimer timer(*this, Operation_Select);
+	MFRC522BusSession session(_transport);		// One bus session for the whole anticollision loop
 	bool uidComplete;
 	bool selectDone;
 	bool useCascadeTag;
@@ -74,8 +79,26 @@ MFRC522::StatusCode MFRC522Extended::PICC_Select(	Uid *uid,			///< Pointer to Ui
 		return STATUS_INVALID;
 	}
 	
+	// The member tag describes the selected PICC from now on. Its previous PICC is probably still ACTIVE in the
+	// field and would answer the blocks of its CID, so deselect it first. S(DESELECT) also returns the PICCs in
+	// state READY to IDLE, invite them again.
+	if (_tagHoldsCID) {
+		if (TCL_Deselect(&tag) != STATUS_OK) {
+			TCL_Release(&tag);
+		}
+		byte bufferATQA[2];
+		byte bufferSize = sizeof(bufferATQA);
+		PCD_WriteRegister(TxModeReg, 0x00);
+		PCD_WriteRegister(RxModeReg, 0x00);
+		PCD_WriteRegister(ModWidthReg, 0x26);
+		result = PICC_RequestA(bufferATQA, &bufferSize);
+		if (result != STATUS_OK && result != STATUS_COLLISION) {
+			return result;
+		}
+	}
+	
 	// Prepare MFRC522
-	PCD_ClearRegisterBitMask(CollReg, 0x80);		// ValuesAfterColl=1 => Bits received after collision are cleared.
+	PCD_WriteField<CollReg_ValuesAfterColl>(0);	// Bits received after a collision are cleared.
 	
 	// Repeat Cascade Level loop until we have a complete UID.
 	uidComplete = false;
@@ -170,10 +193,10 @@ MFRC522::StatusCode MFRC522Extended::PICC_Select(	Uid *uid,			///< Pointer to Ui
 			result = PCD_TransceiveData(buffer, bufferUsed, responseBuffer, &responseLength, &txLastBits, rxAlign);
 			if (result == STATUS_COLLISION) { // More than one PICC in the field => collision.
 				byte valueOfCollReg = PCD_ReadRegister(CollReg); // CollReg[7..0] bits are: ValuesAfterColl reserved CollPosNotValid CollPos[4:0]
-				if (valueOfCollReg & 0x20) { // CollPosNotValid
+				if (CollReg_CollPosNotValid::get(valueOfCollReg)) {
 					return STATUS_COLLISION; // Without a valid collision position we cannot continue
 				}
-				byte collisionPos = valueOfCollReg & 0x1F; // Values 0-31, 0 means bit 32.
+				byte collisionPos = CollReg_CollPos::get(valueOfCollReg); // Values 0-31, 0 means bit 32.
 				if (collisionPos == 0) {
 					collisionPos = 32;
 				}
@@ -239,9 +262,30 @@ MFRC522::StatusCode MFRC522Extended::PICC_Select(	Uid *uid,			///< Pointer to Ui
 	// A Request ATS command should be sent
 	// We also check SAK bit 3 is cero, as it stands for UID complete (1 would tell us it is incomplete)
 	if ((uid->sak & 0x24) == 0x20) {
-		Ats ats;
-		result = PICC_RequestATS(&ats);
+		// Take the CID from the same pool as PICC_Activate(), so TCL_Deselect(&tag) releases the right one
+		byte cid = TCL_GetFreeCID();
+		if (cid > TCL_CID_MAX) {
+			return STATUS_NO_ROOM;
+		}
+		tag.cid = cid;
+		tag.blockNumber = false;
+
+		Ats &ats = tag.ats;	// Keep the ATS, the T=CL layer needs FWI, SFGI and FSC
+		result = PICC_RequestATS(&ats, tag.cid);
 		if (result == STATUS_OK) {
+			// A PICC without CID support answers every block, it cannot share the field
+			if (!ats.tc1.supportsCID && _activeCIDs) {
+				PICC_HaltA();
+				return STATUS_ERROR;
+			}
+			TCL_RegisterCID(&tag);
+			_tagHoldsCID = true;
+
+			// The PICC may need some time before it accepts the next frame
+			session.suspend();
+			TCL_WaitStartupGuardTime(&ats);
+			session.resume();
+			
 			// Check the ATS
 			if (ats.size > 0)
 			{
@@ -292,7 +336,14 @@ MFRC522::StatusCode MFRC522Extended::PICC_Select(	Uid *uid,			///< Pointer to Ui
 					//	ds = BITRATE_106KBITS;
 					//}
 
-					if (ats.ta1.ds & 0x01)
+#if MFRC522_LINK_QUALITY
+					// A degraded link stays at 106 kBaud, see PCD_SetLinkAdaptation()
+					bool fast = _linkQuality.level < LinkLevel_BitRate;
+#else
+					bool fast = true;
+#endif
+
+					if ((ats.ta1.ds & 0x01) && fast)
 					{
 						ds = BITRATE_212KBITS;
 					}
@@ -319,7 +370,7 @@ MFRC522::StatusCode MFRC522Extended::PICC_Select(	Uid *uid,			///< Pointer to Ui
 					//	dr = BITRATE_106KBITS;
 					//}
 
-					if (ats.ta1.dr & 0x01)
+					if ((ats.ta1.dr & 0x01) && fast)
 					{
 						dr = BITRATE_212KBITS;
 					}
@@ -328,7 +379,7 @@ MFRC522::StatusCode MFRC522Extended::PICC_Select(	Uid *uid,			///< Pointer to Ui
 						dr = BITRATE_106KBITS;
 					}
 
-					PICC_PPS(ds, dr);
+					PICC_PPS(ds, dr, tag.cid);
 				}
 			}
 		}
@@ -342,7 +393,9 @@ MFRC522::StatusCode MFRC522Extended::PICC_Select(	Uid *uid,			///< Pointer to Ui
  *
  * @return STATUS_OK on success, STATUS_??? otherwise.
  */
-MFRC522::StatusCode MFRC522Extended::PICC_RequestATS(Ats *ats) 
+MFRC522::StatusCode MFRC522Extended::PICC_RequestATS(Ats *ats,		///< Out: The ATS of the PICC.
+													byte cid		///< The card identifier (CID) assigned to the PICC, 0 to 14. Default 0.
+													) 
 {
 	// TODO unused variable
 	//byte count;
@@ -365,13 +418,9 @@ MFRC522::StatusCode MFRC522Extended::PICC_RequestATS(Ats *ats)
 	// ------------+-----+-----+-----+-----+-----+-----+-----+-----+-----+-----------
 	// FSD (bytes) |  16 |  24 |  32 |  40 |  48 |  64 |  96 | 128 | 256 | RFU > 256
 	//
-	bufferATS[1] = 0x50; // FSD=64, CID=0
-
-	// Calculate CRC_A
-	result = PCD_CalculateCRC(bufferATS, 2, &bufferATS[2]);
-	if (result != STATUS_OK) {
-		return result;
-	}
+	// FSD=64. The CRC_A of these two bytes is calculated in software, the CRC coprocessor takes longer.
+	FixedFrame rats = PICC_FixedFrame(PICC_CMD_RATS, 0x50 | (cid & 0x0F));
+	memcpy(bufferATS, rats.data, rats.size);
 
 	// Transmit the buffer and receive the response, validate CRC_A.
 	result = PCD_TransceiveData(bufferATS, 4, bufferATS, &bufferSize, NULL, 0, true);
@@ -469,7 +518,7 @@ MFRC522::StatusCode MFRC522Extended::PICC_RequestATS(Ats *ats)
 		else
 		{
 			// Defaults for TB1
-			ats->tb1.fwi = 0;	// TODO: Don't know the default for this!
+			ats->tb1.fwi = 4;	// The default value of FWI is 4 (meaning FWT = 4.8ms)
 			ats->tb1.sfgi = 0;	// The default value of SFGI is 0 (meaning that the card does not need any particular SFGT)
 		}
 
@@ -510,7 +559,7 @@ MFRC522::StatusCode MFRC522Extended::PICC_RequestATS(Ats *ats)
 
 		// Defaults for TB1
 		ats->tb1.transmitted = false;
-		ats->tb1.fwi = 0;	// TODO: Don't know the default for this!
+		ats->tb1.fwi = 4;	// The default value of FWI is 4 (meaning FWT = 4.8ms)
 		ats->tb1.sfgi = 0;	// The default value of SFGI is 0 (meaning that the card does not need any particular SFGT)
 
 		// Defaults for TC1
@@ -529,7 +578,8 @@ MFRC522::StatusCode MFRC522Extended::PICC_RequestATS(Ats *ats)
  *
  * @return STATUS_OK on success, STATUS_??? otherwise.
  */
-MFRC522::StatusCode MFRC522Extended::PICC_PPS()
+MFRC522::StatusCode MFRC522Extended::PICC_PPS(byte cid	///< The card identifier (CID) assigned in RATS. Default 0.
+)
 {
 	StatusCode result;
 
@@ -538,25 +588,17 @@ MFRC522::StatusCode MFRC522Extended::PICC_PPS()
 	// Start byte: The start byte (PPS) consists of two parts:
 	//  –The upper nibble(b8–b5) is set to’D'to identify the PPS. All other values are RFU.
 	//  -The lower nibble(b4–b1), which is called the ‘card identifier’ (CID), defines the logical number of the addressed card.
-	ppsBuffer[0] = 0xD0;	// CID is hardcoded as 0 in RATS
-	ppsBuffer[1] = 0x00;	// PPS0 indicates whether PPS1 is present
-
-	// Calculate CRC_A
-	result = PCD_CalculateCRC(ppsBuffer, 2, &ppsBuffer[2]);
-	if (result != STATUS_OK) {
-		return result;
-	}
+	// PPS0 indicates whether PPS1 is present. The CRC_A is calculated in software.
+	FixedFrame pps = PICC_FixedFrame(0xD0 | (cid & 0x0F), 0x00);
+	memcpy(ppsBuffer, pps.data, pps.size);
 
 	// Transmit the buffer and receive the response, validate CRC_A.
 	result = PCD_TransceiveData(ppsBuffer, 4, ppsBuffer, &ppsBufferSize, NULL, 0, true);
 	if (result == STATUS_OK)
 	{
 		// Enable CRC for T=CL
-		byte txReg = PCD_ReadRegister(TxModeReg) | 0x80;
-		byte rxReg = PCD_ReadRegister(RxModeReg) | 0x80;
-
-		PCD_WriteRegister(TxModeReg, txReg);
-		PCD_WriteRegister(RxModeReg, rxReg);
+		PCD_WriteField<TxModeReg_TxCRCEn>(1);
+		PCD_WriteField<RxModeReg_RxCRCEn>(1);
 	}
 
 	return result;
@@ -568,7 +610,8 @@ MFRC522::StatusCode MFRC522Extended::PICC_PPS()
  * @return STATUS_OK on success, STATUS_??? otherwise.
  */
 MFRC522::StatusCode MFRC522Extended::PICC_PPS(TagBitRates sendBitRate,	          ///< DS
-                                      TagBitRates receiveBitRate		  ///< DR
+                                      TagBitRates receiveBitRate,		  ///< DR
+                                      byte cid							  ///< The card identifier (CID) assigned in RATS. Default 0.
 ) {
 	StatusCode result;
 
@@ -581,7 +624,7 @@ MFRC522::StatusCode MFRC522Extended::PICC_PPS(TagBitRates sendBitRate,
 	// Start byte: The start byte (PPS) consists of two parts:
 	//  –The upper nibble(b8–b5) is set to’D'to identify the PPS. All other values are RFU.
 	//  -The lower nibble(b4–b1), which is called the ‘card identifier’ (CID), defines the logical number of the addressed card.
-	ppsBuffer[0] = 0xD0;	// CID is hardcoded as 0 in RATS
+	ppsBuffer[0] = 0xD0 | (cid & 0x0F);
 	ppsBuffer[1] = 0x11;	// PPS0 indicates whether PPS1 is present
 
 	// Bit 8 - Set to '0' as MFRC522 allows different bit rates for send and receive
@@ -601,21 +644,14 @@ MFRC522::StatusCode MFRC522Extended::PICC_PPS(TagBitRates sendBitRate,
 	{
 		// Make sure it is an answer to our PPS
 		// We should receive our PPS byte and 2 CRC bytes
-		if ((ppsBufferSize == 3) && (ppsBuffer[0] == 0xD0)) {
-			byte txReg = PCD_ReadRegister(TxModeReg) & 0x8F;
-			byte rxReg = PCD_ReadRegister(RxModeReg) & 0x8F;
-
-			// Set bit rate and enable CRC for T=CL
-			txReg = (txReg & 0x8F) | ((receiveBitRate & 0x03) << 4) | 0x80;
-			rxReg = (rxReg & 0x8F) | ((sendBitRate & 0x03) << 4) | 0x80;
-			rxReg &= 0xF0; //Enforce although this should be set already
+		if ((ppsBufferSize == 3) && (ppsBuffer[0] == (0xD0 | (cid & 0x0F)))) {
+			// Set bit rate and enable CRC for T=CL. RxNoErr and RxMultiple are cleared, although they should be already.
+			PCD_WriteFields<TxModeReg_TxCRCEn, TxModeReg_TxSpeed>(1, receiveBitRate & 0x03);
+			PCD_WriteRegister(RxModeReg, RxModeReg_RxCRCEn::set(1) | RxModeReg_RxSpeed::set(sendBitRate & 0x03));
 
 			// From ConfigIsoType
 			//rxReg |= 0x06;
 
-			PCD_WriteRegister(TxModeReg, txReg);
-			PCD_WriteRegister(RxModeReg, rxReg);
-
 			// At 212kBps
 			switch (sendBitRate) {
 				case BITRATE_212KBITS:
@@ -656,6 +692,128 @@ MFRC522::StatusCode MFRC522Extended::PICC_PPS(TagBitRates sendBitRate,
 } // End PICC_PPS()
 
 
+/**
+ * Activates the next ISO/IEC 14443-4 PICC in the field using the lowest free card identifier (CID).
+ * See PICC_Activate(TagInfo *tag, byte cid).
+ *
+ * @return STATUS_OK on success, STATUS_NO_ROOM if all CIDs are in use or a PICC without CID support is activated, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::PICC_Activate(TagInfo *tag	///< Out: The TagInfo of the activated PICC.
+)
+{
+	byte cid = TCL_GetFreeCID();
+	if (cid > TCL_CID_MAX) {
+		return STATUS_NO_ROOM;
+	}
+	return PICC_Activate(tag, cid);
+} // End PICC_Activate()
+
+/**
+ * Activates the next ISO/IEC 14443-4 PICC in the field and assigns it the given card identifier (CID).
+ * Runs REQA, anticollision/SELECT, RATS and PPS and fills in *tag.
+ *
+ * PICCs which are already activated do not answer REQA, so several PICCs can be activated one after
+ * another, each with its own TagInfo. Blocks sent with TCL_Transceive() are addressed by the CID in the
+ * TagInfo, so the application can switch between the PICCs without deselecting and reselecting them.
+ * All PICCs activated this way communicate at 106 kBit/s with the CRC calculated by the MFRC522.
+ * Call TCL_Deselect() to release the CID.
+ *
+ * A PICC without CID support answers every block, so it is only activated while no other PICC is, and no
+ * further PICC is activated until it is deselected or released. If no PICC is activated, e.g. none is waiting in
+ * state IDLE, the mode registers keep the settings of the PICCs activated before.
+ *
+ * @return STATUS_OK on success, STATUS_INVALID if the CID is in use or a PICC without CID support is activated, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::PICC_Activate(TagInfo *tag,	///< Out: The TagInfo of the activated PICC.
+													byte cid		///< The card identifier (CID) to assign, 0 to 14.
+)
+{
+	MFRC522::StatusCode result;
+	byte bufferATQA[2];
+	byte bufferSize = sizeof(bufferATQA);
+
+	if (cid > TCL_CID_MAX || (_activeCIDs & ((1 << cid) | TCL_CID_EXCLUSIVE))) {
+		return STATUS_INVALID;
+	}
+
+	// REQA and the anticollision use standard frames without CRC. Keep the settings of the PICCs already activated.
+	byte txMode = PCD_ReadRegister(TxModeReg);
+	byte rxMode = PCD_ReadRegister(RxModeReg);
+	byte modWidth = PCD_ReadRegister(ModWidthReg);
+	PCD_WriteRegister(TxModeReg, 0x00);
+	PCD_WriteRegister(RxModeReg, 0x00);
+	PCD_WriteRegister(ModWidthReg, 0x26);
+
+	result = PICC_RequestA(bufferATQA, &bufferSize);
+	if (result == STATUS_OK) {
+		tag->atqa = ((uint16_t)bufferATQA[1] << 8) | bufferATQA[0];
+
+		// Select without the RATS done by our PICC_Select() override
+		result = MFRC522::PICC_Select(&tag->uid);
+	}
+	if (result == STATUS_OK) {
+		result = PICC_ActivateSelected(tag, cid);
+	}
+	if (result != STATUS_OK) {
+		// No PICC was activated, restore the CRC and bit rate the activated PICCs communicate with
+		PCD_WriteRegister(TxModeReg, txMode);
+		PCD_WriteRegister(RxModeReg, rxMode);
+		PCD_WriteRegister(ModWidthReg, modWidth);
+	}
+	return result;
+} // End PICC_Activate()
+
+/**
+ * Activates a PICC which is already selected, e.g. with MFRC522::PICC_Select() or PICC_Reselect(), and assigns it
+ * the given card identifier (CID). Runs RATS and PPS, tag->uid must hold the UID and SAK of the PICC.
+ * See PICC_Activate(TagInfo *tag, byte cid).
+ *
+ * A PICC rejected after RATS, because it lacks CID support while other PICCs are activated, is halted with HLTA:
+ * S(DESELECT) without CID would deselect the PICC holding CID 0. If PPS fails, the PICC is deselected, and its CID
+ * stays in use until TCL_Release() if that fails as well.
+ *
+ * @return STATUS_OK on success, STATUS_INVALID if the CID is in use or a PICC without CID support is activated, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::PICC_ActivateSelected(TagInfo *tag,	///< In: UID of the selected PICC. Out: The TagInfo of the activated PICC.
+															byte cid		///< The card identifier (CID) to assign, 0 to 14.
+)
+{
+	MFRC522::StatusCode result;
+
+	if (cid > TCL_CID_MAX || (_activeCIDs & ((1 << cid) | TCL_CID_EXCLUSIVE))) {
+		return STATUS_INVALID;
+	}
+	if ((tag->uid.sak & 0x24) != 0x20) {	// Not ISO/IEC 14443-4 compliant
+		PICC_HaltA();
+		return STATUS_ERROR;
+	}
+
+	result = PICC_RequestATS(&tag->ats, cid);
+	if (result != STATUS_OK) {
+		return result;
+	}
+	tag->cid = cid;
+	tag->blockNumber = false;
+	TCL_WaitStartupGuardTime(&tag->ats);
+
+	// A PICC without CID support answers every block, it cannot share the field
+	if (!tag->ats.tc1.supportsCID && _activeCIDs) {
+		PICC_HaltA();
+		return STATUS_ERROR;
+	}
+	// The PICC holds the CID since RATS
+	TCL_RegisterCID(tag);
+
+	// Enable the CRC in the MFRC522
+	result = PICC_PPS(cid);
+	if (result != STATUS_OK) {
+		TCL_Deselect(tag);	// Releases the CID on success
+		return result;
+	}
+	return STATUS_OK;
+} // End PICC_ActivateSelected()
+
+
 /////////////////////////////////////////////////////////////////////////////////////
 // Functions for communicating with ISO/IEC 14433-4 cards
 /////////////////////////////////////////////////////////////////////////////////////
@@ -691,12 +849,16 @@ MFRC522::StatusCode MFRC522Extended::TCL_Transceive(PcbBlock *send, PcbBlock *ba
 	}
 
 	// Is the CRC enabled for transmission?
-	byte txModeReg = PCD_ReadRegister(TxModeReg);
-	if ((txModeReg & 0x80) != 0x80) {
-		// Calculate CRC_A
-		result = PCD_CalculateCRC(outBuffer, outBufferOffset, &outBuffer[outBufferOffset]);
-		if (result != STATUS_OK) {
-			return result;
+	if (!PCD_ReadField<TxModeReg_TxCRCEn>()) {
+		// Calculate CRC_A, in software for R-blocks and S-blocks without INF
+		if (send->inf.size == 0) {
+			PICC_CalculateCRC_A(outBuffer, outBufferOffset, &outBuffer[outBufferOffset]);
+		}
+		else {
+			result = PCD_CalculateCRC(outBuffer, outBufferOffset, &outBuffer[outBufferOffset]);
+			if (result != STATUS_OK) {
+				return result;
+			}
 		}
 
 		outBufferOffset += 2;
@@ -723,11 +885,9 @@ MFRC522::StatusCode MFRC522Extended::TCL_Transceive(PcbBlock *send, PcbBlock *ba
 		inBufferOffset++;
 	}
 
-	// Check if CRC is taken care of by MFRC522
-	byte rxModeReg = PCD_ReadRegister(TxModeReg);
-	if ((rxModeReg & 0x80) != 0x80) {
-		Serial.print("CRC is not taken care of by MFRC522: ");
-		Serial.println(rxModeReg, HEX);
+	// Check if CRC is taken care of by MFRC522, PCD_TransceiveData() returns its CRCErr as STATUS_CRC_WRONG
+	if (!PCD_ReadField<RxModeReg_RxCRCEn>()) {
+		Serial.println("CRC is not taken care of by MFRC522");
 
 		// Check the CRC
 		// We need at least the CRC_A value.
@@ -762,8 +922,8 @@ MFRC522::StatusCode MFRC522Extended::TCL_Transceive(PcbBlock *send, PcbBlock *ba
 		back->inf.size = 0;
 	}
 
-	// If the response is a R-Block check NACK
-	if (((inBuffer[0] & 0xC0) == 0x80) && (inBuffer[0] & 0x20)) {
+	// If the response is a R-Block check NACK, bit 5 of the PCB. Bit 6 is set in every R-Block.
+	if (((inBuffer[0] & 0xC0) == 0x80) && (inBuffer[0] & 0x10)) {
 		return STATUS_MIFARE_NACK;
 	}
 	
@@ -774,20 +934,21 @@ MFRC522::StatusCode MFRC522Extended::TCL_Transceive(PcbBlock *send, PcbBlock *ba
  */
 MFRC522::StatusCode MFRC522Extended::TCL_Transceive(TagInfo *tag, byte *sendData, byte sendLen, byte *backData, byte *backLen)
 {
+	OperationTimer timer(*this, Operation_TCLTransceive);
 	MFRC522::StatusCode result;
 
 	PcbBlock out;
 	PcbBlock in;
 	byte outBuffer[FIFO_SIZE];
 	byte outBufferSize = FIFO_SIZE;
-	byte totalBackLen = *backLen;
+	byte totalBackLen = backLen ? *backLen : 0;
 
 	// This command sends an I-Block
 	out.prologue.pcb = 0x02;
 
 	if (tag->ats.tc1.supportsCID) {
 		out.prologue.pcb |= 0x08;
-		out.prologue.cid = 0x00;	// CID is curentlly hardcoded as 0x00
+		out.prologue.cid = tag->cid;
 	}
 
 	// This command doe not support NAD
@@ -813,7 +974,7 @@ MFRC522::StatusCode MFRC522Extended::TCL_Transceive(TagInfo *tag, byte *sendData
 	in.inf.data = outBuffer;
 	in.inf.size = outBufferSize;
 
-	result = TCL_Transceive(&out, &in);
+	result = TCL_ExchangeWithRecovery(tag, &out, &in);
 	if (result != STATUS_OK) {
 		return result;
 	}
@@ -821,7 +982,7 @@ MFRC522::StatusCode MFRC522Extended::TCL_Transceive(TagInfo *tag, byte *sendData
 	// Swap block number on success
 	tag->blockNumber = !tag->blockNumber;
 
-	if (backData && (*backLen > 0)) {
+	if (backData && (totalBackLen > 0)) {
 		if (*backLen < in.inf.size)
 			return STATUS_NO_ROOM;
 
@@ -829,27 +990,35 @@ MFRC522::StatusCode MFRC522Extended::TCL_Transceive(TagInfo *tag, byte *sendData
 		memcpy(backData, in.inf.data, in.inf.size);
 	}
 
-	// Check chaining
-	if ((in.prologue.pcb & 0x10) == 0x00)
-		return result;
-
 	// Result is chained
-	// Send an ACK to receive more data
-	// TODO: Should be checked I've never needed to send an ACK
+	// Acknowledge each chained I-Block with an R(ACK) to receive more data
 	while (in.prologue.pcb & 0x10) {
-		byte ackData[FIFO_SIZE];
-		byte ackDataSize = FIFO_SIZE;
+		PcbBlock ack;
+		ack.prologue.pcb = 0xA2;
+		if (tag->ats.tc1.supportsCID) {
+			ack.prologue.pcb |= 0x08;
+			ack.prologue.cid = tag->cid;
+		}
+		ack.prologue.nad = 0x00;
+		if (tag->blockNumber) {
+			ack.prologue.pcb |= 0x01;
+		}
+		ack.inf.size = 0;
+		ack.inf.data = NULL;
 
-		result = TCL_TransceiveRBlock(tag, true, ackData, &ackDataSize);
+		in.inf.size = outBufferSize;
+		result = TCL_ExchangeWithRecovery(tag, &ack, &in);
 		if (result != STATUS_OK)
 			return result;
 
-		if (backData && (*backLen > 0)) {
-			if ((*backLen + ackDataSize) > totalBackLen)
+		tag->blockNumber = !tag->blockNumber;
+
+		if (backData && (totalBackLen > 0)) {
+			if ((*backLen + in.inf.size) > totalBackLen)
 				return STATUS_NO_ROOM;
 
-			memcpy(&(backData[*backLen]), ackData, ackDataSize);
-			*backLen += ackDataSize;
+			memcpy(&(backData[*backLen]), in.inf.data, in.inf.size);
+			*backLen += in.inf.size;
 		}
 	}
 	
@@ -877,7 +1046,7 @@ MFRC522::StatusCode MFRC522Extended::TCL_TransceiveRBlock(TagInfo *tag, bool ack
 
 	if (tag->ats.tc1.supportsCID) {
 		out.prologue.pcb |= 0x08;
-		out.prologue.cid = 0x00;	// CID is curentlly hardcoded as 0x00
+		out.prologue.cid = tag->cid;
 	}
 
 	// This command doe not support NAD
@@ -898,7 +1067,7 @@ MFRC522::StatusCode MFRC522Extended::TCL_TransceiveRBlock(TagInfo *tag, bool ack
 	in.inf.data = outBuffer;
 	in.inf.size = outBufferSize;
 
-	result = TCL_Transceive(&out, &in);
+	result = TCL_Exchange(tag, &out, &in);
 	if (result != STATUS_OK) {
 		return result;
 	}
@@ -924,32 +1093,672 @@ MFRC522::StatusCode MFRC522Extended::TCL_Deselect(TagInfo *tag)
 {
 	MFRC522::StatusCode result;
 	byte outBuffer[4];
-	byte outBufferSize = 1;
 	byte inBuffer[FIFO_SIZE];
 	byte inBufferSize = FIFO_SIZE;
 
-	outBuffer[0] = 0xC2;
-	if (tag->ats.tc1.supportsCID)
-	{
-		outBuffer[0] |= 0x08;
-		outBuffer[1] = 0x00;  // CID is hardcoded
-		outBufferSize = 2;
-	}
+	FixedFrame deselect = tag->ats.tc1.supportsCID ? PICC_FixedFrame(0xCA, tag->cid) : MFRC522_FRAME_S_DESELECT;
+	memcpy(outBuffer, deselect.data, deselect.size);
+	// Before PICC_PPS() the MFRC522 does not append the CRC_A, e.g. when PICC_Activate() gives up
+	byte outBufferSize = PCD_ReadField<TxModeReg_TxCRCEn>() ? deselect.size - 2 : deselect.size;
 
+	uint32_t defaultTimeout = PCD_GetTimeout();
+	PCD_SetTimeout(TCL_GetFrameWaitingTime(tag));
 	result = PCD_TransceiveData(outBuffer, outBufferSize, inBuffer, &inBufferSize);
+	PCD_SetTimeout(defaultTimeout);
 	if (result != STATUS_OK) {
 		return result;
 	}
 
 	// TODO:Maybe do some checks? In my test it returns: CA 00 (Same data as I sent to my card)
 
+	// The CID can be assigned to the next PICC
+	TCL_Release(tag);
+
 	return result;
 } // End TCL_Deselect()
 
+/**
+ * Releases the CID of an activated PICC which left the field, so TCL_Deselect() is not possible any more.
+ */
+void MFRC522Extended::TCL_Release(TagInfo *tag	///< Pointer to the TagInfo of the activated PICC.
+								) {
+	_activeCIDs &= ~((1 << tag->cid) | (tag->ats.tc1.supportsCID ? 0 : TCL_CID_EXCLUSIVE));
+	if (tag == &this->tag) {
+		_tagHoldsCID = false;
+	}
+} // End TCL_Release()
+
+/**
+ * Checks that an activated PICC is still in the field without disturbing the block numbering.
+ * An R(NAK) with the PCD's current block number is sent, which the PICC answers with an R(ACK)
+ * carrying its own block number (ISO/IEC 14443-4 7.5.4.3 rule 12). No RATS or reselection is needed.
+ * 
+ * @return STATUS_OK if the PICC answered, STATUS_TIMEOUT if it left the field, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::TCL_PresenceCheck(TagInfo *tag	///< Pointer to the TagInfo of the activated PICC.
+														) {
+	MFRC522::StatusCode result;
+	PcbBlock nak;
+	PcbBlock in;
+	byte inBuffer[FIFO_SIZE];
+	
+	nak.prologue.pcb = 0xB2;
+	if (tag->ats.tc1.supportsCID) {
+		nak.prologue.pcb |= 0x08;
+		nak.prologue.cid = tag->cid;
+	}
+	nak.prologue.nad = 0x00;
+	if (tag->blockNumber) {
+		nak.prologue.pcb |= 0x01;
+	}
+	nak.inf.size = 0;
+	nak.inf.data = NULL;
+	
+	in.inf.data = inBuffer;
+	in.inf.size = sizeof(inBuffer);
+	
+	result = TCL_Exchange(tag, &nak, &in);
+	if (result != STATUS_OK) {
+		return result;
+	}
+	// Expect an R(ACK) with the block number of the last block we received
+	if ((in.prologue.pcb & 0xF6) != 0xA2 || (bool)(in.prologue.pcb & 0x01) == tag->blockNumber) {
+		return STATUS_ERROR;
+	}
+	return STATUS_OK;
+} // End TCL_PresenceCheck()
+
+/**
+ * Exchanges an I-Block or R(ACK) with the PICC and recovers from transmission errors
+ * following the rules of ISO/IEC 14443-4 7.5.4.
+ * 
+ * When no valid block is received (timeout, CRC or protocol error) an R(NAK) is sent, or the
+ * R(ACK) is repeated while the PICC is chaining. The PICC answers with its last block if it received
+ * ours, or with an R(ACK) asking for our last block to be re-transmitted. This is tried
+ * TCL_MAX_RETRIES times, and counted in tclRecovery.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::TCL_ExchangeWithRecovery(	TagInfo *tag,		///< Pointer to the TagInfo of the activated PICC.
+																PcbBlock *send,		///< The I-Block or R(ACK) block to send.
+																PcbBlock *back		///< In: Buffer for the INF field. Out: The I-Block received.
+															) {
+	MFRC522::StatusCode result;
+	byte backSize = back->inf.size;
+	bool blockNumber = send->prologue.pcb & 0x01;
+	bool sendIsIBlock = (send->prologue.pcb & 0xC0) == 0x00;
+	byte attempts = 0;
+	
+	tclRecovery.exchanges++;
+	result = TCL_Exchange(tag, send, back);
+	while (true) {
+		if (result == STATUS_OK) {
+			byte pcb = back->prologue.pcb;
+			if ((pcb & 0xC0) == 0x00) {				// I-Block
+				if ((bool)(pcb & 0x01) == blockNumber) {
+					break;							// The expected answer
+				}
+				result = STATUS_ERROR;				// Out of sequence
+			}
+			else if ((pcb & 0xF6) == 0xA2 && sendIsIBlock && (bool)(pcb & 0x01) != blockNumber) {
+				// R(ACK) with another block number: the PICC did not receive our I-Block (rule 6)
+				if (attempts >= TCL_MAX_RETRIES) {
+					result = STATUS_ERROR;
+					break;
+				}
+				attempts++;
+				tclRecovery.attempts++;
+				back->inf.size = backSize;
+				result = TCL_Exchange(tag, send, back);
+				continue;
+			}
+			else {
+				result = STATUS_ERROR;				// Not allowed here
+			}
+		}
+		
+		// Only transmission errors can be recovered from
+		if (result != STATUS_TIMEOUT && result != STATUS_CRC_WRONG && result != STATUS_ERROR) {
+			break;
+		}
+		if (attempts >= TCL_MAX_RETRIES) {
+			break;
+		}
+		attempts++;
+		tclRecovery.attempts++;
+		
+		// Rule 4: R(NAK), rule 5: R(ACK) while the PICC is chaining
+		PcbBlock rblock;
+		rblock.prologue.pcb = (sendIsIBlock ? 0xB2 : 0xA2) | (blockNumber ? 0x01 : 0x00);
+		if (tag->ats.tc1.supportsCID) {
+			rblock.prologue.pcb |= 0x08;
+			rblock.prologue.cid = tag->cid;
+		}
+		rblock.prologue.nad = 0x00;
+		rblock.inf.size = 0;
+		rblock.inf.data = NULL;
+		
+		back->inf.size = backSize;
+		result = TCL_Exchange(tag, &rblock, back);
+	}
+	
+	if (attempts) {
+		if (result == STATUS_OK) {
+			tclRecovery.recovered++;
+		}
+		else {
+			tclRecovery.failed++;
+		}
+	}
+	return result;
+} // End TCL_ExchangeWithRecovery()
+
+/**
+ * Exchanges one block with the PICC using its frame waiting time (FWT) as timeout.
+ * Waiting time extension requests (S(WTX)) sent by the PICC are answered here, extending the
+ * timeout to FWT * WTXM until the next block is received. The previous timeout is restored afterwards.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::TCL_Exchange(	TagInfo *tag,		///< Pointer to the TagInfo of the activated PICC.
+													PcbBlock *send,		///< The block to send.
+													PcbBlock *back		///< In: Buffer for the INF field. Out: The block received.
+												) {
+	MFRC522::StatusCode result;
+	uint32_t defaultTimeout = PCD_GetTimeout();
+	uint32_t fwt = TCL_GetFrameWaitingTime(tag);
+	byte backSize = back->inf.size;
+	
+	if (fwt != defaultTimeout) {
+		PCD_SetTimeout(fwt);
+	}
+	result = TCL_Transceive(send, back);
+	
+	// S(WTX) request: PCB 1111x010, INF is the WTXM in bits 6..1
+	while (result == STATUS_OK && (back->prologue.pcb & 0xF7) == 0xF2 && back->inf.size == 1) {
+		byte wtxm = back->inf.data[0] & 0x3F;
+		if (wtxm == 0 || wtxm > 59) {	// Values 0 and 60 to 63 are RFU
+			result = STATUS_ERROR;
+			break;
+		}
+		
+		// Answer with a S(WTX) response with the same WTXM
+		PcbBlock wtx;
+		wtx.prologue.pcb = back->prologue.pcb;
+		wtx.prologue.cid = back->prologue.cid;
+		wtx.prologue.nad = 0x00;
+		wtx.inf.size = 1;
+		wtx.inf.data = &wtxm;
+		
+		// The extended waiting time only applies until the next block is received
+		uint32_t extended = fwt * wtxm;
+		if (extended > TCL_FWT_MAX) {
+			extended = TCL_FWT_MAX;
+		}
+		PCD_SetTimeout(extended);
+		back->inf.size = backSize;
+		result = TCL_Transceive(&wtx, back);
+	}
+	
+	if (PCD_GetTimeout() != defaultTimeout) {
+		PCD_SetTimeout(defaultTimeout);
+	}
+	return result;
+} // End TCL_Exchange()
+
+/////////////////////////////////////////////////////////////////////////////////////
+// Functions for communicating with MIFARE DESFire PICCs
+/////////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * Sends a native MIFARE DESFire command wrapped in I-Blocks and collects the complete response.
+ * 
+ * The command parameters and data are split into as many frames as the frame size negotiated in the
+ * ATS requires; the PICC acknowledges each intermediate frame with DESFIRE_ADDITIONAL_FRAME (0xAF).
+ * When the PICC answers with DESFIRE_ADDITIONAL_FRAME after everything was sent it has more data to
+ * return, which is requested with empty 0xAF frames until a final status is received.
+ * Only plain communication is supported, no authentication, MAC or encryption is applied.
+ * 
+ * The status byte returned by the PICC is stored in desfireStatus.
+ * 
+ * @return STATUS_OK on success, STATUS_ERROR if the PICC returned an error status, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::DESFire_Transceive(	TagInfo *tag,		///< Pointer to the TagInfo of the activated PICC.
+															byte command,		///< One of the DESFire_Command enums.
+															byte *params,		///< Command parameters sent before data, or NULL.
+															byte paramsLen,		///< Number of bytes in params.
+															byte *data,			///< Command data, or NULL. Default NULL.
+															uint16_t dataLen,	///< Number of bytes in data. Default 0.
+															byte *backData,		///< NULL or pointer to a buffer for the response data (without status bytes).
+															uint16_t *backLen	///< In: Size of backData. Out: The number of bytes returned.
+														) {
+	MFRC522::StatusCode result;
+	byte frame[FIFO_SIZE];
+	byte response[FIFO_SIZE];
+	byte responseSize;
+	byte maxInfSize = TCL_GetMaxInfSize(tag);
+	uint16_t totalLen = paramsLen + dataLen;
+	uint16_t sent = 0;
+	uint16_t received = 0;
+	uint16_t backSize = (backData && backLen) ? *backLen : 0;
+	
+	frame[0] = command;
+	while (true) {
+		// Fill the frame with the next chunk of parameters and data
+		byte frameLen = 1;
+		while (sent < totalLen && frameLen < maxInfSize) {
+			frame[frameLen++] = (sent < paramsLen) ? params[sent] : data[sent - paramsLen];
+			sent++;
+		}
+		
+		responseSize = sizeof(response);
+		result = TCL_Transceive(tag, frame, frameLen, response, &responseSize);
+		if (result != STATUS_OK) {
+			return result;
+		}
+		if (responseSize < 1) {
+			return STATUS_ERROR;
+		}
+		desfireStatus = response[0];
+		
+		// Collect the response data
+		if (responseSize > 1) {
+			if ((uint16_t)(received + responseSize - 1) > backSize) {
+				return STATUS_NO_ROOM;
+			}
+			memcpy(&backData[received], &response[1], responseSize - 1);
+			received += responseSize - 1;
+		}
+		
+		if (desfireStatus != DESFIRE_ADDITIONAL_FRAME) {
+			break;
+		}
+		// Continue sending our data or ask for more data
+		frame[0] = DESFIRE_CMD_ADDITIONAL_FRAME;
+	}
+	
+	if (backData && backLen) {
+		*backLen = received;
+	}
+	
+	if (desfireStatus != DESFIRE_OPERATION_OK && desfireStatus != DESFIRE_NO_CHANGES) {
+		return STATUS_ERROR;
+	}
+	// The PICC finished before all our data was sent
+	if (sent < totalLen) {
+		return STATUS_ERROR;
+	}
+	return STATUS_OK;
+} // End DESFire_Transceive()
+
+/**
+ * Reads the hardware, software and production information of a MIFARE DESFire PICC.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::DESFire_GetVersion(	TagInfo *tag,			///< Pointer to the TagInfo of the activated PICC.
+															DESFireVersion *version	///< Out: The version information.
+														) {
+	MFRC522::StatusCode result;
+	byte buffer[28];
+	uint16_t bufferSize = sizeof(buffer);
+	
+	result = DESFire_Transceive(tag, DESFIRE_CMD_GET_VERSION, NULL, 0, NULL, 0, buffer, &bufferSize);
+	if (result != STATUS_OK) {
+		return result;
+	}
+	if (bufferSize != sizeof(buffer)) {
+		return STATUS_ERROR;
+	}
+	
+	memcpy(&version->hardware, &buffer[0], 7);
+	memcpy(&version->software, &buffer[7], 7);
+	memcpy(version->uid, &buffer[14], 7);
+	memcpy(version->batchNo, &buffer[21], 5);
+	version->productionWeek = buffer[26];
+	version->productionYear = buffer[27];
+	return STATUS_OK;
+} // End DESFire_GetVersion()
+
+/**
+ * Selects an application on a MIFARE DESFire PICC. AID 0x000000 selects the PICC level.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::DESFire_SelectApplication(	TagInfo *tag,	///< Pointer to the TagInfo of the activated PICC.
+																	uint32_t aid	///< The 24 bit application identifier.
+																) {
+	byte params[3];
+	params[0] = aid & 0xFF;
+	params[1] = (aid >> 8) & 0xFF;
+	params[2] = (aid >> 16) & 0xFF;
+	
+	return DESFire_Transceive(tag, DESFIRE_CMD_SELECT_APPLICATION, params, sizeof(params));
+} // End DESFire_SelectApplication()
+
+/**
+ * Returns the file IDs of all active files within the currently selected application.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::DESFire_GetFileIDs(	TagInfo *tag,		///< Pointer to the TagInfo of the activated PICC.
+															byte *fileIds,		///< Out: The file IDs. An application has at most 32 files.
+															byte *fileCount		///< In: Size of fileIds. Out: The number of file IDs returned.
+														) {
+	MFRC522::StatusCode result;
+	uint16_t count = *fileCount;
+	
+	result = DESFire_Transceive(tag, DESFIRE_CMD_GET_FILE_IDS, NULL, 0, NULL, 0, fileIds, &count);
+	if (result == STATUS_OK) {
+		*fileCount = count;
+	}
+	return result;
+} // End DESFire_GetFileIDs()
+
+/**
+ * Returns the settings of one file within the currently selected application.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::DESFire_GetFileSettings(	TagInfo *tag,					///< Pointer to the TagInfo of the activated PICC.
+																byte fileNo,					///< The file number.
+																DESFireFileSettings *settings	///< Out: The file settings.
+															) {
+	MFRC522::StatusCode result;
+	byte buffer[17];
+	uint16_t bufferSize = sizeof(buffer);
+	
+	result = DESFire_Transceive(tag, DESFIRE_CMD_GET_FILE_SETTINGS, &fileNo, 1, NULL, 0, buffer, &bufferSize);
+	if (result != STATUS_OK) {
+		return result;
+	}
+	if (bufferSize < 7) {
+		return STATUS_ERROR;
+	}
+	
+	settings->fileType = (DESFire_FileType)buffer[0];
+	settings->communicationSettings = buffer[1];
+	settings->accessRights = ((uint16_t)buffer[3] << 8) | buffer[2];
+	
+	// All numbers are transmitted LSB first
+	switch (settings->fileType) {
+		case DESFIRE_FILE_STANDARD_DATA:
+		case DESFIRE_FILE_BACKUP_DATA:
+			settings->data.fileSize = ((uint32_t)buffer[6] << 16) | ((uint32_t)buffer[5] << 8) | buffer[4];
+			break;
+		
+		case DESFIRE_FILE_VALUE:
+			if (bufferSize < 17) {
+				return STATUS_ERROR;
+			}
+			settings->value.lowerLimit = (int32_t)(((uint32_t)buffer[7] << 24) | ((uint32_t)buffer[6] << 16) | ((uint32_t)buffer[5] << 8) | buffer[4]);
+			settings->value.upperLimit = (int32_t)(((uint32_t)buffer[11] << 24) | ((uint32_t)buffer[10] << 16) | ((uint32_t)buffer[9] << 8) | buffer[8]);
+			settings->value.limitedCreditValue = (int32_t)(((uint32_t)buffer[15] << 24) | ((uint32_t)buffer[14] << 16) | ((uint32_t)buffer[13] << 8) | buffer[12]);
+			settings->value.limitedCreditEnabled = buffer[16] & 0x01;
+			break;
+		
+		case DESFIRE_FILE_LINEAR_RECORD:
+		case DESFIRE_FILE_CYCLIC_RECORD:
+			if (bufferSize < 13) {
+				return STATUS_ERROR;
+			}
+			settings->record.recordSize = ((uint32_t)buffer[6] << 16) | ((uint32_t)buffer[5] << 8) | buffer[4];
+			settings->record.maxRecords = ((uint32_t)buffer[9] << 16) | ((uint32_t)buffer[8] << 8) | buffer[7];
+			settings->record.currentRecords = ((uint32_t)buffer[12] << 16) | ((uint32_t)buffer[11] << 8) | buffer[10];
+			break;
+		
+		default:
+			return STATUS_ERROR;
+	}
+	return STATUS_OK;
+} // End DESFire_GetFileSettings()
+
+/**
+ * Reads data from a standard or backup data file with plain communication settings.
+ * 
+ * With length 0 the whole file starting at offset is read. The PICC returns as much data per frame as the
+ * frame size (FSD) allows, so the file is transferred in the least number of frames.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::DESFire_ReadData(	TagInfo *tag,			///< Pointer to the TagInfo of the activated PICC.
+														byte fileNo,			///< The file number.
+														uint32_t offset,		///< The first byte to read.
+														uint32_t length,		///< The number of bytes to read, 0 for all data up to the end of the file.
+														byte *buffer,			///< Out: The data read.
+														uint16_t *bufferSize	///< In: Size of buffer. Out: The number of bytes read.
+													) {
+	MFRC522::StatusCode result;
+	byte params[7];
+	
+	// Sanity check
+	if (buffer == NULL || (length > *bufferSize)) {
+		return STATUS_NO_ROOM;
+	}
+	
+	params[0] = fileNo;
+	params[1] = offset & 0xFF;
+	params[2] = (offset >> 8) & 0xFF;
+	params[3] = (offset >> 16) & 0xFF;
+	params[4] = length & 0xFF;
+	params[5] = (length >> 8) & 0xFF;
+	params[6] = (length >> 16) & 0xFF;
+	
+	result = DESFire_Transceive(tag, DESFIRE_CMD_READ_DATA, params, sizeof(params), NULL, 0, buffer, bufferSize);
+	if (result != STATUS_OK) {
+		return result;
+	}
+	if (length && *bufferSize != length) {
+		return STATUS_ERROR;
+	}
+	return STATUS_OK;
+} // End DESFire_ReadData()
+
+/**
+ * Writes data to a standard or backup data file with plain communication settings.
+ * For backup data files DESFire_CommitTransaction() must be called afterwards to validate the data.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::DESFire_WriteData(	TagInfo *tag,		///< Pointer to the TagInfo of the activated PICC.
+														byte fileNo,		///< The file number.
+														uint32_t offset,	///< The first byte to write.
+														byte *buffer,		///< The data to write.
+														uint16_t length		///< The number of bytes to write.
+													) {
+	byte params[7];
+	
+	// Sanity check
+	if (buffer == NULL || length == 0) {
+		return STATUS_INVALID;
+	}
+	
+	params[0] = fileNo;
+	params[1] = offset & 0xFF;
+	params[2] = (offset >> 8) & 0xFF;
+	params[3] = (offset >> 16) & 0xFF;
+	params[4] = length & 0xFF;
+	params[5] = (length >> 8) & 0xFF;
+	params[6] = 0;
+	
+	return DESFire_Transceive(tag, DESFIRE_CMD_WRITE_DATA, params, sizeof(params), buffer, length);
+} // End DESFire_WriteData()
+
+/**
+ * Reads the currently stored value from a value file with plain communication settings.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::DESFire_GetValue(	TagInfo *tag,	///< Pointer to the TagInfo of the activated PICC.
+														byte fileNo,	///< The file number.
+														int32_t *value	///< Out: The value.
+													) {
+	MFRC522::StatusCode result;
+	byte buffer[4];
+	uint16_t bufferSize = sizeof(buffer);
+	
+	result = DESFire_Transceive(tag, DESFIRE_CMD_GET_VALUE, &fileNo, 1, NULL, 0, buffer, &bufferSize);
+	if (result != STATUS_OK) {
+		return result;
+	}
+	if (bufferSize != sizeof(buffer)) {
+		return STATUS_ERROR;
+	}
+	*value = (int32_t)(((uint32_t)buffer[3] << 24) | ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[1] << 8) | buffer[0]);
+	return STATUS_OK;
+} // End DESFire_GetValue()
+
+/**
+ * Increases the value stored in a value file.
+ * DESFire_CommitTransaction() must be called afterwards to validate the new value.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::DESFire_Credit(	TagInfo *tag,	///< Pointer to the TagInfo of the activated PICC.
+														byte fileNo,	///< The file number.
+														int32_t value	///< The value to add, must be positive.
+													) {
+	return DESFire_ValueHelper(tag, DESFIRE_CMD_CREDIT, fileNo, value);
+} // End DESFire_Credit()
+
+/**
+ * Decreases the value stored in a value file.
+ * DESFire_CommitTransaction() must be called afterwards to validate the new value.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::DESFire_Debit(	TagInfo *tag,	///< Pointer to the TagInfo of the activated PICC.
+													byte fileNo,	///< The file number.
+													int32_t value	///< The value to subtract, must be positive.
+												) {
+	return DESFire_ValueHelper(tag, DESFIRE_CMD_DEBIT, fileNo, value);
+} // End DESFire_Debit()
+
+/**
+ * Helper function for the value file operations Credit and Debit.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::DESFire_ValueHelper(	TagInfo *tag,	///< Pointer to the TagInfo of the activated PICC.
+															byte command,	///< DESFIRE_CMD_CREDIT or DESFIRE_CMD_DEBIT.
+															byte fileNo,	///< The file number.
+															int32_t value	///< The value to transfer.
+														) {
+	byte params[5];
+	
+	// Sanity check
+	if (value < 0) {
+		return STATUS_INVALID;
+	}
+	
+	params[0] = fileNo;
+	params[1] = value & 0xFF;
+	params[2] = (value >> 8) & 0xFF;
+	params[3] = (value >> 16) & 0xFF;
+	params[4] = (value >> 24) & 0xFF;
+	
+	return DESFire_Transceive(tag, command, params, sizeof(params));
+} // End DESFire_ValueHelper()
+
+/**
+ * Validates all previous write access on backup data, value and record files within the selected application.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::DESFire_CommitTransaction(TagInfo *tag	///< Pointer to the TagInfo of the activated PICC.
+															) {
+	return DESFire_Transceive(tag, DESFIRE_CMD_COMMIT_TRANSACTION, NULL, 0);
+} // End DESFire_CommitTransaction()
+
+/**
+ * Invalidates all previous write access on backup data, value and record files within the selected application.
+ * 
+ * @return STATUS_OK on success, STATUS_??? otherwise.
+ */
+MFRC522::StatusCode MFRC522Extended::DESFire_AbortTransaction(TagInfo *tag	///< Pointer to the TagInfo of the activated PICC.
+															) {
+	return DESFire_Transceive(tag, DESFIRE_CMD_ABORT_TRANSACTION, NULL, 0);
+} // End DESFire_AbortTransaction()
+
 /////////////////////////////////////////////////////////////////////////////////////
 // Support functions
 /////////////////////////////////////////////////////////////////////////////////////
 
+/**
+ * Calculates the frame waiting time (FWT) of the PICC from the FWI in its ATS.
+ * FWT = (256 * 16 / fc) * 2^FWI, plus the additional delta FWT of ISO/IEC 14443-4 7.2.
+ * 
+ * @return The frame waiting time in microseconds.
+ */
+uint32_t MFRC522Extended::TCL_GetFrameWaitingTime(TagInfo *tag	///< Pointer to the TagInfo of the activated PICC.
+												) {
+	byte fwi = tag->ats.tb1.fwi;
+	if (fwi > 14) {	// FWI = 15 is RFU, use the default
+		fwi = 4;
+	}
+	// 256 * 16 / 13.56MHz = 302μs, delta FWT = 49152 / 13.56MHz = 3.6ms
+	return ((uint32_t)302 << fwi) + 3625;
+} // End TCL_GetFrameWaitingTime()
+
+/**
+ * Waits the start-up frame guard time (SFGT) the PICC needs after sending its ATS before it is ready to receive the next frame.
+ * SFGT = (256 * 16 / fc) * 2^SFGI, plus the additional delta SFGT of ISO/IEC 14443-4 5.2.5.
+ */
+void MFRC522Extended::TCL_WaitStartupGuardTime(Ats *ats	///< Pointer to the ATS received from the PICC.
+												) {
+	byte sfgi = ats->tb1.sfgi;
+	if (sfgi == 0 || sfgi > 14) {	// 0 means no SFGT needed, 15 is RFU
+		return;
+	}
+	// 256 * 16 / 13.56MHz = 302μs, delta SFGT = 384 / 13.56MHz * 2^SFGI = 28μs * 2^SFGI
+	uint32_t sfgt = (uint32_t)330 << sfgi;
+	if (sfgt >= 1000) {
+		delay(sfgt / 1000);
+	}
+	delayMicroseconds(sfgt % 1000);
+} // End TCL_WaitStartupGuardTime()
+
+/**
+ * Returns the maximum number of INF bytes that fit in one block sent to the PICC.
+ * This is the frame size accepted by the PICC (FSC), limited by the FIFO size, without prologue and CRC_A.
+ * 
+ * @return The maximum INF size in bytes.
+ */
+byte MFRC522Extended::TCL_GetMaxInfSize(TagInfo *tag	///< Pointer to the TagInfo of the activated PICC.
+										) {
+	byte frameSize = tag->ats.fsc;
+	if (frameSize == 0 || frameSize > FIFO_SIZE) {	// FSC of 256 bytes is not decoded, the FIFO is the limit
+		frameSize = FIFO_SIZE;
+	}
+	// PCB + CID + CRC_A
+	return frameSize - (tag->ats.tc1.supportsCID ? 4 : 3);
+} // End TCL_GetMaxInfSize()
+
+/**
+ * Returns the lowest card identifier (CID) not in use.
+ * 
+ * @return The CID, or 0xFF if all are in use or a PICC without CID support is activated.
+ */
+byte MFRC522Extended::TCL_GetFreeCID() {
+	if (_activeCIDs & TCL_CID_EXCLUSIVE) {
+		return 0xFF;
+	}
+	for (byte cid = 0; cid <= TCL_CID_MAX; cid++) {
+		if (!(_activeCIDs & (1 << cid))) {
+			return cid;
+		}
+	}
+	return 0xFF;
+} // End TCL_GetFreeCID()
+
+/**
+ * Marks the CID of a PICC which answered RATS as in use. A PICC without CID support takes the whole field.
+ */
+void MFRC522Extended::TCL_RegisterCID(TagInfo *tag	///< Pointer to the TagInfo of the activated PICC.
+									) {
+	_activeCIDs |= (1 << tag->cid) | (tag->ats.tc1.supportsCID ? 0 : TCL_CID_EXCLUSIVE);
+} // End TCL_RegisterCID()
+
 /**
  * Get the PICC type.
  *
@@ -1089,6 +1898,40 @@ void MFRC522Extended::PICC_DumpISO14443_4(TagInfo *tag)
 	
 } // End PICC_DumpISO14443_4
 
+/**
+ * Returns a __FlashStringHelper pointer to a MIFARE DESFire status name.
+ * 
+ * @return const __FlashStringHelper *
+ */
+const __FlashStringHelper *MFRC522Extended::DESFire_GetStatusName(byte status	///< One of the DESFire_Status enums.
+																) {
+	switch (status) {
+		case DESFIRE_OPERATION_OK:			return F("Successful operation.");
+		case DESFIRE_NO_CHANGES:			return F("No changes done to backup files.");
+		case DESFIRE_OUT_OF_EEPROM_ERROR:	return F("Insufficient NV-Memory to complete command.");
+		case DESFIRE_ILLEGAL_COMMAND_CODE:	return F("Command code not supported.");
+		case DESFIRE_INTEGRITY_ERROR:		return F("CRC or MAC does not match data.");
+		case DESFIRE_NO_SUCH_KEY:			return F("Invalid key number specified.");
+		case DESFIRE_LENGTH_ERROR:			return F("Length of command string invalid.");
+		case DESFIRE_PERMISSION_DENIED:		return F("Permission denied.");
+		case DESFIRE_PARAMETER_ERROR:		return F("Value of the parameter(s) invalid.");
+		case DESFIRE_APPLICATION_NOT_FOUND:	return F("Requested AID not present on PICC.");
+		case DESFIRE_APPL_INTEGRITY_ERROR:	return F("Unrecoverable error within application.");
+		case DESFIRE_AUTHENTICATION_ERROR:	return F("Authentication required.");
+		case DESFIRE_ADDITIONAL_FRAME:		return F("Additional data frame is expected.");
+		case DESFIRE_BOUNDARY_ERROR:		return F("Attempt to read/write beyond the file's limits.");
+		case DESFIRE_PICC_INTEGRITY_ERROR:	return F("Unrecoverable error within PICC.");
+		case DESFIRE_COMMAND_ABORTED:		return F("Previous command was not fully completed.");
+		case DESFIRE_PICC_DISABLED_ERROR:	return F("PICC was disabled by an unrecoverable error.");
+		case DESFIRE_COUNT_ERROR:			return F("Number of applications limited to 28.");
+		case DESFIRE_DUPLICATE_ERROR:		return F("File/application already exists.");
+		case DESFIRE_EEPROM_ERROR:			return F("Could not complete NV-write operation.");
+		case DESFIRE_FILE_NOT_FOUND:		return F("Specified file number does not exist.");
+		case DESFIRE_FILE_INTEGRITY_ERROR:	return F("Unrecoverable error within file.");
+		default:							return F("Unknown status");
+	}
+} // End DESFire_GetStatusName()
+
 /////////////////////////////////////////////////////////////////////////////////////
 // Convenience functions - does not add extra functionality
 /////////////////////////////////////////////////////////////////////////////////////
@@ -1096,6 +1939,7 @@ void MFRC522Extended::PICC_DumpISO14443_4(TagInfo *tag)
 /**
  * Returns true if a PICC responds to PICC_CMD_REQA.
  * Only "new" cards in state IDLE are invited. Sleeping cards in state HALT are ignored.
+ * A PICC activated into the member tag by PICC_Select() is deselected first, see TCL_Deselect().
  * 
  * @return bool
  */
@@ -1103,6 +1947,14 @@ bool MFRC522Extended::PICC_IsNewCardPresent() {
 	byte bufferATQA[2];
 	byte bufferSize = sizeof(bufferATQA);
 
+	// The member tag is overwritten by the next PICC. Deselect its previous PICC now, with the bit rate and CRC
+	// settings still in the mode registers: after REQA, S(DESELECT) would return the new PICC to IDLE.
+	if (_tagHoldsCID) {
+		if (TCL_Deselect(&tag) != STATUS_OK) {
+			TCL_Release(&tag);
+		}
+	}
+
 	// Reset baud rates
 	PCD_WriteRegister(TxModeReg, 0x00);
 	PCD_WriteRegister(RxModeReg, 0x00);
@@ -1124,7 +1976,7 @@ bool MFRC522Extended::PICC_IsNewCardPresent() {
 
 		// Defaults for TB1
 		tag.ats.tb1.transmitted = false;
-		tag.ats.tb1.fwi = 0;	// TODO: Don't know the default for this!
+		tag.ats.tb1.fwi = 4;	// The default value of FWI is 4 (meaning FWT = 4.8ms)
 		tag.ats.tb1.sfgi = 0;	// The default value of SFGI is 0 (meaning that the card does not need any particular SFGT)
 
 		// Defaults for TC1
@@ -1134,6 +1986,7 @@ bool MFRC522Extended::PICC_IsNewCardPresent() {
 
 		memset(tag.ats.data, 0, FIFO_SIZE - 2);
 
+		tag.cid = 0;
 		tag.blockNumber = false;
 		return true;
 	}
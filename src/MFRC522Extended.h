@@ -12,6 +12,13 @@
 class MFRC522Extended : public MFRC522 {
 		
 public:
+	// Maximum frame waiting time, FWI = 14 (ISO/IEC 14443-4 7.2)
+	static constexpr uint32_t TCL_FWT_MAX = 4949000;	// In microseconds.
+	// Highest card identifier (CID), 15 is RFU
+	static constexpr byte TCL_CID_MAX = 14;
+	// Number of R(NAK)/retransmission attempts before an exchange fails (ISO/IEC 14443-4 7.5.4)
+	static constexpr byte TCL_MAX_RETRIES = 2;
+
 	// ISO/IEC 14443-4 bit rates
 	enum TagBitRates : byte {
 		BITRATE_106KBITS = 0x00,
@@ -55,6 +62,7 @@ class MFRC522Extended : public MFRC522 {
 		Ats		    ats; 
 
 		// For Block PCB
+		byte cid;				// Card identifier assigned in RATS, 0 to 14
 		bool blockNumber;
 	} TagInfo;
 
@@ -70,24 +78,129 @@ class MFRC522Extended : public MFRC522 {
 			byte *data;
 		} inf;
 	} PcbBlock;
+
+	// A struct used for counting the ISO/IEC 14443-4 error recovery
+	typedef struct {
+		uint16_t exchanges;		// Block exchanges started by TCL_Transceive()
+		uint16_t attempts;		// R-blocks sent and blocks retransmitted to recover from errors
+		uint16_t recovered;		// Exchanges that succeeded after recovery
+		uint16_t failed;		// Exchanges that still failed after TCL_MAX_RETRIES attempts
+	} TCL_RecoveryStats;
+
+	// MIFARE DESFire native commands (DESFire EV1, plain communication mode).
+	enum DESFire_Command : byte {
+		DESFIRE_CMD_GET_VERSION			= 0x60,		// Returns manufacturing related data of the PICC in three frames.
+		DESFIRE_CMD_SELECT_APPLICATION	= 0x5A,		// Selects one specific application (AID 000000h is the PICC level).
+		DESFIRE_CMD_GET_FILE_IDS		= 0x6F,		// Returns the file IDs of all active files within the selected application.
+		DESFIRE_CMD_GET_FILE_SETTINGS	= 0xF5,		// Returns the settings of one file.
+		DESFIRE_CMD_READ_DATA			= 0xBD,		// Reads data from a standard or backup data file.
+		DESFIRE_CMD_WRITE_DATA			= 0x3D,		// Writes data to a standard or backup data file.
+		DESFIRE_CMD_GET_VALUE			= 0x6C,		// Reads the currently stored value from a value file.
+		DESFIRE_CMD_CREDIT				= 0x0C,		// Increases a value stored in a value file.
+		DESFIRE_CMD_DEBIT				= 0xDC,		// Decreases a value stored in a value file.
+		DESFIRE_CMD_COMMIT_TRANSACTION	= 0xC7,		// Validates all previous write access on backup data, value and record files.
+		DESFIRE_CMD_ABORT_TRANSACTION	= 0xA7,		// Invalidates all previous write access on backup data, value and record files.
+		DESFIRE_CMD_ADDITIONAL_FRAME	= 0xAF		// Requests (or sends) the next frame of a multi-frame exchange.
+	};
+
+	// MIFARE DESFire status codes, returned by the PICC in the first byte of each response.
+	enum DESFire_Status : byte {
+		DESFIRE_OPERATION_OK			= 0x00,		// Successful operation.
+		DESFIRE_NO_CHANGES				= 0x0C,		// No changes done to backup files, CommitTransaction/AbortTransaction not necessary.
+		DESFIRE_OUT_OF_EEPROM_ERROR		= 0x0E,		// Insufficient NV-Memory to complete command.
+		DESFIRE_ILLEGAL_COMMAND_CODE	= 0x1C,		// Command code not supported.
+		DESFIRE_INTEGRITY_ERROR			= 0x1E,		// CRC or MAC does not match data. Padding bytes not valid.
+		DESFIRE_NO_SUCH_KEY				= 0x40,		// Invalid key number specified.
+		DESFIRE_LENGTH_ERROR			= 0x7E,		// Length of command string invalid.
+		DESFIRE_PERMISSION_DENIED		= 0x9D,		// Current configuration / status does not allow the requested command.
+		DESFIRE_PARAMETER_ERROR			= 0x9E,		// Value of the parameter(s) invalid.
+		DESFIRE_APPLICATION_NOT_FOUND	= 0xA0,		// Requested AID not present on PICC.
+		DESFIRE_APPL_INTEGRITY_ERROR	= 0xA1,		// Unrecoverable error within application, application will be disabled.
+		DESFIRE_AUTHENTICATION_ERROR	= 0xAE,		// Current authentication status does not allow the requested command.
+		DESFIRE_ADDITIONAL_FRAME		= 0xAF,		// Additional data frame is expected to be sent.
+		DESFIRE_BOUNDARY_ERROR			= 0xBE,		// Attempt to read/write data from/to beyond the file's/record's limits.
+		DESFIRE_PICC_INTEGRITY_ERROR	= 0xC1,		// Unrecoverable error within PICC, PICC will be disabled.
+		DESFIRE_COMMAND_ABORTED			= 0xCA,		// Previous command was not fully completed.
+		DESFIRE_PICC_DISABLED_ERROR		= 0xCD,		// PICC was disabled by an unrecoverable error.
+		DESFIRE_COUNT_ERROR				= 0xCE,		// Number of applications limited to 28, no additional CreateApplication possible.
+		DESFIRE_DUPLICATE_ERROR			= 0xDE,		// Creation of file/application failed because file/application with same number already exists.
+		DESFIRE_EEPROM_ERROR			= 0xEE,		// Could not complete NV-write operation due to loss of power.
+		DESFIRE_FILE_NOT_FOUND			= 0xF0,		// Specified file number does not exist.
+		DESFIRE_FILE_INTEGRITY_ERROR	= 0xF1		// Unrecoverable error within file, file will be disabled.
+	};
+
+	// MIFARE DESFire file types, as returned by DESFire_GetFileSettings().
+	enum DESFire_FileType : byte {
+		DESFIRE_FILE_STANDARD_DATA		= 0x00,
+		DESFIRE_FILE_BACKUP_DATA		= 0x01,
+		DESFIRE_FILE_VALUE				= 0x02,
+		DESFIRE_FILE_LINEAR_RECORD		= 0x03,
+		DESFIRE_FILE_CYCLIC_RECORD		= 0x04
+	};
+
+	// A struct used for passing the MIFARE DESFire GetVersion response
+	typedef struct {
+		struct {
+			byte vendorId;		// 0x04 for NXP
+			byte type;
+			byte subtype;
+			byte majorVersion;
+			byte minorVersion;
+			byte storageSize;	// 2^(storageSize >> 1) bytes, +/- if the LSBit is set
+			byte protocol;		// 0x05 for ISO/IEC 14443-2 and -3
+		} hardware, software;
+		byte uid[7];
+		byte batchNo[5];
+		byte productionWeek;
+		byte productionYear;
+	} DESFireVersion;
+
+	// A struct used for passing the MIFARE DESFire GetFileSettings response
+	typedef struct {
+		DESFire_FileType fileType;
+		byte communicationSettings;	// 0x00 plain, 0x01 MACed, 0x03 fully enciphered
+		uint16_t accessRights;
+		union {
+			struct {
+				uint32_t fileSize;
+			} data;					// Standard and backup data files
+			struct {
+				int32_t lowerLimit;
+				int32_t upperLimit;
+				int32_t limitedCreditValue;
+				bool limitedCreditEnabled;
+			} value;				// Value files
+			struct {
+				uint32_t recordSize;
+				uint32_t maxRecords;
+				uint32_t currentRecords;
+			} record;				// Linear and cyclic record files
+		};
+	} DESFireFileSettings;
 	
 	// Member variables
 	TagInfo tag;
+	byte desfireStatus;		// Status byte of the last MIFARE DESFire response, one of the DESFire_Status enums.
+	TCL_RecoveryStats tclRecovery;	// Error recovery counters, reset them at will.
 	
 	/////////////////////////////////////////////////////////////////////////////////////
 	// Contructors
 	/////////////////////////////////////////////////////////////////////////////////////
-	MFRC522Extended() : MFRC522() {};
-	MFRC522Extended(uint8_t rst) : MFRC522(rst) {};
-	MFRC522Extended(uint8_t ss, uint8_t rst) : MFRC522(ss, rst) {};
+	MFRC522Extended() : MFRC522(), desfireStatus(0), tclRecovery(), _activeCIDs(0), _tagHoldsCID(false) {};
+	MFRC522Extended(uint8_t rst) : MFRC522(rst), desfireStatus(0), tclRecovery(), _activeCIDs(0), _tagHoldsCID(false) {};
+	MFRC522Extended(uint8_t ss, uint8_t rst) : MFRC522(ss, rst), desfireStatus(0), tclRecovery(), _activeCIDs(0), _tagHoldsCID(false) {};
+	MFRC522Extended(const MFRC522Transport &transport, uint8_t rst) : MFRC522(transport, rst), desfireStatus(0), tclRecovery(), _activeCIDs(0), _tagHoldsCID(false) {};
 	
 	/////////////////////////////////////////////////////////////////////////////////////
 	// Functions for communicating with PICCs
 	/////////////////////////////////////////////////////////////////////////////////////
 	StatusCode PICC_Select(Uid *uid, byte validBits = 0) override; // overrride
-	StatusCode PICC_RequestATS(Ats *ats);
-	StatusCode PICC_PPS();	                                                  // PPS command without bitrate parameter
-	StatusCode PICC_PPS(TagBitRates sendBitRate, TagBitRates receiveBitRate); // Different D values
+	StatusCode PICC_RequestATS(Ats *ats, byte cid = 0);
+	StatusCode PICC_PPS(byte cid = 0);	                                                    // PPS command without bitrate parameter
+	StatusCode PICC_PPS(TagBitRates sendBitRate, TagBitRates receiveBitRate, byte cid = 0); // Different D values
+	StatusCode PICC_Activate(TagInfo *tag);
+	StatusCode PICC_Activate(TagInfo *tag, byte cid);
+	StatusCode PICC_ActivateSelected(TagInfo *tag, byte cid);
 	
 	/////////////////////////////////////////////////////////////////////////////////////
 	// Functions for communicating with ISO/IEC 14433-4 cards
@@ -96,6 +209,24 @@ class MFRC522Extended : public MFRC522 {
 	StatusCode TCL_Transceive(TagInfo * tag, byte *sendData, byte sendLen, byte *backData = NULL, byte *backLen = NULL);
 	StatusCode TCL_TransceiveRBlock(TagInfo *tag, bool ack, byte *backData = NULL, byte *backLen = NULL);
 	StatusCode TCL_Deselect(TagInfo *tag);
+	StatusCode TCL_PresenceCheck(TagInfo *tag);
+	void TCL_Release(TagInfo *tag);
+	
+	/////////////////////////////////////////////////////////////////////////////////////
+	// Functions for communicating with MIFARE DESFire PICCs (native commands, plain communication)
+	/////////////////////////////////////////////////////////////////////////////////////
+	StatusCode DESFire_Transceive(TagInfo *tag, byte command, byte *params, byte paramsLen, byte *data = NULL, uint16_t dataLen = 0, byte *backData = NULL, uint16_t *backLen = NULL);
+	StatusCode DESFire_GetVersion(TagInfo *tag, DESFireVersion *version);
+	StatusCode DESFire_SelectApplication(TagInfo *tag, uint32_t aid);
+	StatusCode DESFire_GetFileIDs(TagInfo *tag, byte *fileIds, byte *fileCount);
+	StatusCode DESFire_GetFileSettings(TagInfo *tag, byte fileNo, DESFireFileSettings *settings);
+	StatusCode DESFire_ReadData(TagInfo *tag, byte fileNo, uint32_t offset, uint32_t length, byte *buffer, uint16_t *bufferSize);
+	StatusCode DESFire_WriteData(TagInfo *tag, byte fileNo, uint32_t offset, byte *buffer, uint16_t length);
+	StatusCode DESFire_GetValue(TagInfo *tag, byte fileNo, int32_t *value);
+	StatusCode DESFire_Credit(TagInfo *tag, byte fileNo, int32_t value);
+	StatusCode DESFire_Debit(TagInfo *tag, byte fileNo, int32_t value);
+	StatusCode DESFire_CommitTransaction(TagInfo *tag);
+	StatusCode DESFire_AbortTransaction(TagInfo *tag);
 	
 	/////////////////////////////////////////////////////////////////////////////////////
 	// Support functions
@@ -109,12 +240,33 @@ class MFRC522Extended : public MFRC522 {
 	void PICC_DumpDetailsToSerial(TagInfo *tag);
 	using MFRC522::PICC_DumpDetailsToSerial; // make old PICC_DumpDetailsToSerial(Uid *uid) available, otherwise would be hidden by PICC_DumpDetailsToSerial(TagInfo *tag)
 	void PICC_DumpISO14443_4(TagInfo *tag);
+	static const __FlashStringHelper *DESFire_GetStatusName(byte status);
 	
 	/////////////////////////////////////////////////////////////////////////////////////
 	// Convenience functions - does not add extra functionality
 	/////////////////////////////////////////////////////////////////////////////////////
 	bool PICC_IsNewCardPresent() override; // overrride
 	bool PICC_ReadCardSerial() override; // overrride
+	
+protected:
+	// Set in _activeCIDs while a PICC without CID support is activated, no other PICC can be activated then
+	static constexpr uint16_t TCL_CID_EXCLUSIVE = 0x8000;
+
+	uint16_t _activeCIDs;	// Bit n is set while an activated PICC uses CID n, see TCL_CID_EXCLUSIVE
+	bool _tagHoldsCID;		// The member tag was activated by PICC_Select() and its CID is set in _activeCIDs
+	
+	StatusCode TCL_Exchange(TagInfo *tag, PcbBlock *send, PcbBlock *back);
+	StatusCode TCL_ExchangeWithRecovery(TagInfo *tag, PcbBlock *send, PcbBlock *back);
+	static uint32_t TCL_GetFrameWaitingTime(TagInfo *tag);
+	static void TCL_WaitStartupGuardTime(Ats *ats);
+	byte TCL_GetMaxInfSize(TagInfo *tag);
+	byte TCL_GetFreeCID();
+	void TCL_RegisterCID(TagInfo *tag);
+	StatusCode DESFire_ValueHelper(TagInfo *tag, byte command, byte fileNo, int32_t value);
 };
 
+// S(DESELECT) without CID with its CRC_A, computed by the compiler
+constexpr MFRC522::FixedFrame MFRC522_FRAME_S_DESELECT = MFRC522::PICC_FixedFrame(0xC2);
+static_assert(MFRC522_FRAME_S_DESELECT.data[1] == 0xE0 && MFRC522_FRAME_S_DESELECT.data[2] == 0xB4, "PICC_CRC_A() does not match the CRC_A of S(DESELECT)");
+
 #endif
@@ -0,0 +1,265 @@
+/*
+ * Tracks the card on a reader, see MFRC522PresenceTracker.h.
+ *
+ * Released into the public domain.
+ */
+
+#include "MFRC522PresenceTracker.h"
+
+/**
+ * Constructor.
+ * Tracks every PICC with PICC_Reselect().
+ */
+MFRC522PresenceTracker::MFRC522PresenceTracker(	MFRC522 &reader		///< The initialized reader, see PCD_Init().
+											) : _reader(reader) {
+	_extended = nullptr;
+	_tag = nullptr;
+	_cid = 0;
+	_callback = nullptr;
+	_context = nullptr;
+	_interval = DEFAULT_INTERVAL;
+	_arrivals = 1;
+	_departures = 2;
+	_activated = false;
+	reset();
+} // End constructor
+
+/**
+ * Constructor.
+ * ISO/IEC 14443-4 PICCs are activated on arrival with PICC_ActivateSelected() and checked with TCL_PresenceCheck(),
+ * so the application can exchange APDUs with *tag while the card is present. Other PICCs are tracked with PICC_Reselect().
+ */
+MFRC522PresenceTracker::MFRC522PresenceTracker(	MFRC522Extended &reader,			///< The initialized reader, see PCD_Init().
+												MFRC522Extended::TagInfo *tag,		///< Out: The TagInfo of an activated PICC, see isActivated().
+												byte cid							///< The card identifier (CID) to assign, 0 to 14.
+											) : MFRC522PresenceTracker(static_cast<MFRC522 &>(reader)) {
+	_extended = &reader;
+	_tag = tag;
+	_cid = cid;
+} // End constructor
+
+/**
+ * Sets the function called with every event. Without a callback the events are queued for getEvent().
+ */
+void MFRC522PresenceTracker::setCallback(	PresenceCallback callback,	///< The function to call, nullptr to queue the events.
+											void *context				///< Passed to the callback.
+										) {
+	_callback = callback;
+	_context = context;
+} // End setCallback()
+
+/**
+ * Sets the time between two checks of poll(), i.e. the detection latency. A card is reported after up to
+ * intervalMillis * arrivals, its departure after up to intervalMillis * departures, see setHysteresis().
+ */
+void MFRC522PresenceTracker::setInterval(	uint32_t intervalMillis	///< Milliseconds between checks.
+										) {
+	_interval = intervalMillis;
+} // End setInterval()
+
+/**
+ * Sets the hysteresis: the number of checks in a row a card has to answer before Presence_Arrived,
+ * and the number of checks in a row it has to miss before Presence_Departed.
+ */
+void MFRC522PresenceTracker::setHysteresis(	byte arrivals,		///< Checks to arrive, at least 1. Default 1.
+											byte departures		///< Checks to depart, at least 1. Default 2.
+										) {
+	_arrivals = arrivals ? arrivals : 1;
+	_departures = departures ? departures : 1;
+} // End setHysteresis()
+
+/**
+ * Checks for the card if the interval since the last check has passed. Call it from loop().
+ *
+ * @return true if an event was emitted.
+ */
+bool MFRC522PresenceTracker::poll() {
+	if (_checked && static_cast<uint32_t> (millis()) - _lastCheck < _interval) {
+		return false;
+	}
+	return check();
+} // End poll()
+
+/**
+ * Checks for the card now: looks for a new card while none is present, else checks the known one.
+ * A card the application selected or authenticated in the meantime is halted first.
+ *
+ * @return true if an event was emitted.
+ */
+bool MFRC522PresenceTracker::check() {
+	uint32_t now = millis();
+	_lastCheck = now;
+	_checked = true;
+
+	// Frames of ISO/IEC 14443-3 are answered within microseconds, and HLTA does not wait 25ms
+	uint32_t timeout = _reader.PCD_GetTimeout();
+	_reader.PCD_SetTimeout(CHECK_TIMEOUT);
+	bool answered = _state == Absent ? discover() : confirm();
+	_reader.PCD_SetTimeout(timeout);
+
+	if (_state == Present) {
+		if (answered) {
+			_count = 0;
+			_lastSeen = now;
+			emit(Presence_Present, now);
+			return true;
+		}
+		if (++_count < _departures) {
+			return false;
+		}
+		if (_activated) {
+			_extended->TCL_Release(_tag);
+			_activated = false;
+		}
+		_selected = false;
+		_state = Absent;
+		_count = 0;
+		emit(Presence_Departed, now);
+		return true;
+	}
+
+	// Absent or Arriving
+	if (!answered) {
+		_state = Absent;
+		_count = 0;
+		return false;
+	}
+	_count = _state == Absent ? 1 : _count + 1;
+	_state = Arriving;
+	if (_count < _arrivals) {
+		return false;
+	}
+	_state = Present;
+	_count = 0;
+	_arrival = now;
+	_lastSeen = now;
+	_reader.uid = _uid;								// For PCD_Authenticate() and the dumps, like PICC_ReadCardSerial()
+	if (_extended && (_uid.sak & 0x24) == 0x20) {		// ISO/IEC 14443-4 compliant
+		_tag->uid = _uid;
+		_activated = _extended->PICC_ActivateSelected(_tag, _cid) == MFRC522::STATUS_OK;
+		_selected = !_activated;
+	}
+	emit(Presence_Arrived, now);
+	return true;
+} // End check()
+
+/**
+ * Returns the oldest queued event. Events are only queued without a callback, see setCallback().
+ *
+ * @return false if the queue is empty.
+ */
+bool MFRC522PresenceTracker::getEvent(	PresenceReport *report	///< Out: The event.
+									) {
+	if (_queueCount == 0) {
+		return false;
+	}
+	*report = _queue[_queueHead];
+	_queueHead = (_queueHead + 1) % MFRC522_PRESENCE_QUEUE;
+	_queueCount--;
+	return true;
+} // End getEvent()
+
+/**
+ * Forgets the card and the queued events, the next poll() looks for a new card.
+ * An activated PICC is deselected, its CID is released even if it does not answer S(DESELECT).
+ */
+void MFRC522PresenceTracker::reset() {
+	if (_activated) {
+		if (_extended->TCL_Deselect(_tag) != MFRC522::STATUS_OK) {	// TCL_Deselect() releases the CID on success
+			_extended->TCL_Release(_tag);
+		}
+		_activated = false;
+	}
+	_checked = false;
+	_lastCheck = 0;
+	_state = Absent;
+	_count = 0;
+	_selected = false;
+	_uid.size = 0;
+	_uid.sak = 0;
+	_arrival = 0;
+	_lastSeen = 0;
+	_queueHead = 0;
+	_queueCount = 0;
+	_dropped = 0;
+} // End reset()
+
+/**
+ * Looks for a card with WUPA and anticollision, so cards in state HALT are found as well.
+ *
+ * @return true if a card was selected.
+ */
+bool MFRC522PresenceTracker::discover() {
+	byte bufferATQA[2];
+	byte bufferSize = sizeof(bufferATQA);
+
+	halt();
+	// Reset baud rates and ModWidthReg like PICC_IsNewCardPresent()
+	_reader.PCD_WriteRegister(MFRC522::TxModeReg, 0x00);
+	_reader.PCD_WriteRegister(MFRC522::RxModeReg, 0x00);
+	_reader.PCD_WriteRegister(MFRC522::ModWidthReg, 0x26);
+
+	MFRC522::StatusCode result = _reader.PICC_WakeupA(bufferATQA, &bufferSize);
+	if (result != MFRC522::STATUS_OK && result != MFRC522::STATUS_COLLISION) {
+		return false;
+	}
+	// Without the RATS of MFRC522Extended::PICC_Select(), see check()
+	if (_reader.MFRC522::PICC_Select(&_uid) != MFRC522::STATUS_OK) {
+		return false;
+	}
+	if (_tag && result == MFRC522::STATUS_OK) {
+		_tag->atqa = ((uint16_t)bufferATQA[1] << 8) | bufferATQA[0];
+	}
+	_selected = true;
+	return true;
+} // End discover()
+
+/**
+ * Checks that the known card is still in the field.
+ *
+ * @return true if it answered.
+ */
+bool MFRC522PresenceTracker::confirm() {
+	if (_activated) {
+		return _extended->TCL_PresenceCheck(_tag) == MFRC522::STATUS_OK;
+	}
+	halt();
+	_selected = _reader.PICC_Reselect(_uid) == MFRC522::STATUS_OK;
+	return _selected;
+} // End confirm()
+
+/**
+ * Sends the card left in state ACTIVE to HALT, so it answers the next WUPA.
+ */
+void MFRC522PresenceTracker::halt() {
+	if (_selected) {
+		_reader.PCD_StopCrypto1();
+		_reader.PICC_HaltA();
+		_selected = false;
+	}
+} // End halt()
+
+/**
+ * Calls the callback with the event or queues it, dropping the oldest event if the queue is full.
+ */
+void MFRC522PresenceTracker::emit(	PresenceEvent event,	///< The event.
+									uint32_t now			///< millis() of the check.
+								) {
+	PresenceReport report;
+	report.event = event;
+	report.uid = _uid;
+	report.timestamp = now;
+	report.arrival = _arrival;
+	report.lastSeen = _lastSeen;
+	if (_callback) {
+		_callback(report, _context);
+		return;
+	}
+	if (_queueCount == MFRC522_PRESENCE_QUEUE) {
+		_queueHead = (_queueHead + 1) % MFRC522_PRESENCE_QUEUE;
+		_queueCount--;
+		_dropped++;
+	}
+	_queue[(_queueHead + _queueCount) % MFRC522_PRESENCE_QUEUE] = report;
+	_queueCount++;
+} // End emit()
@@ -0,0 +1,108 @@
+/**
+ * Tracks the card on a reader: reports when it arrives, while it stays and when it leaves.
+ *
+ * PICC_IsNewCardPresent() only sees PICCs in state IDLE, so a card which stays on the reader either is read again
+ * and again or its removal goes unnoticed. MFRC522PresenceTracker keeps the UID of the current card and checks it
+ * cheaply every interval: WUPA and SELECT of the known UID with PICC_Reselect(), no anticollision. An ISO/IEC
+ * 14443-4 PICC stays activated and is checked with TCL_PresenceCheck() if the tracker is built on an
+ * MFRC522Extended. Hysteresis on both edges filters out a card at the edge of the field.
+ *
+ * Every visit of a card produces one Presence_Arrived, Presence_Present per successful check and one
+ * Presence_Departed. With Presence_Arrived the card is selected (and activated), so it is read once per visit.
+ * Events go to a callback, or to a queue read with getEvent() if there is none.
+ *
+ *   MFRC522PresenceTracker tracker(mfrc522);
+ *   void loop() {
+ *     MFRC522PresenceTracker::PresenceReport report;
+ *     tracker.poll();
+ *     while (tracker.getEvent(&report)) { ... }
+ *   }
+ *
+ * Released into the public domain.
+ */
+#ifndef MFRC522PresenceTracker_h
+#define MFRC522PresenceTracker_h
+
+#include <Arduino.h>
+#include "MFRC522.h"
+#include "MFRC522Extended.h"
+
+// Events kept for getEvent(), the oldest is dropped when the queue is full
+#ifndef MFRC522_PRESENCE_QUEUE
+#define MFRC522_PRESENCE_QUEUE (4)
+#endif
+
+class MFRC522PresenceTracker {
+public:
+	static constexpr uint32_t DEFAULT_INTERVAL = 100;	// Milliseconds between checks
+	static constexpr uint32_t CHECK_TIMEOUT = 2000;		// Microseconds, plenty for ISO/IEC 14443-3 frames
+
+	enum PresenceEvent : byte {
+		Presence_Arrived		= 0,		// A card entered the field, it is selected until the next check
+		Presence_Present		= 1,		// The card answered the check
+		Presence_Departed		= 2			// The card missed the checks, see setHysteresis()
+	};
+
+	// A struct used for reporting an event
+	typedef struct {
+		PresenceEvent	event;
+		MFRC522::Uid	uid;			// UID and SAK of the card
+		uint32_t		timestamp;		// millis() of the check that produced the event
+		uint32_t		arrival;		// millis() of the Presence_Arrived of this visit
+		uint32_t		lastSeen;		// millis() of the last check the card answered
+	} PresenceReport;
+
+	typedef void (*PresenceCallback)(const PresenceReport &report, void *context);
+
+	explicit MFRC522PresenceTracker(MFRC522 &reader);
+	MFRC522PresenceTracker(MFRC522Extended &reader, MFRC522Extended::TagInfo *tag, byte cid = 0);
+
+	void setCallback(PresenceCallback callback, void *context = nullptr);
+	void setInterval(uint32_t intervalMillis);
+	void setHysteresis(byte arrivals, byte departures);
+	bool poll();
+	bool check();
+	bool getEvent(PresenceReport *report);
+	uint16_t getDropped() const { return _dropped; }
+	bool isPresent() const { return _state == Present; }
+	bool isActivated() const { return _activated; }
+	const MFRC522::Uid &getUid() const { return _uid; }
+	void reset();
+
+protected:
+	enum State : byte {
+		Absent		= 0,
+		Arriving	= 1,		// Seen, fewer than _arrivals checks in a row
+		Present		= 2
+	};
+
+	MFRC522 &_reader;
+	MFRC522Extended *_extended;		// Set if ISO/IEC 14443-4 PICCs are activated
+	MFRC522Extended::TagInfo *_tag;
+	byte _cid;
+	PresenceCallback _callback;
+	void *_context;
+	uint32_t _interval;
+	uint32_t _lastCheck;			// millis() of the last check
+	bool _checked;					// Checked since reset(), poll() checks at once otherwise
+	byte _arrivals;					// Checks in a row a card has to answer to arrive
+	byte _departures;				// Checks in a row a card has to miss to depart
+	State _state;
+	byte _count;					// Answered checks while Arriving, missed checks while Present
+	bool _selected;					// The card was left in state ACTIVE, send HLTA before the next WUPA
+	bool _activated;				// The ISO/IEC 14443-4 PICC in *_tag is activated
+	MFRC522::Uid _uid;
+	uint32_t _arrival;
+	uint32_t _lastSeen;
+	PresenceReport _queue[MFRC522_PRESENCE_QUEUE];
+	byte _queueHead;
+	byte _queueCount;
+	uint16_t _dropped;
+
+	bool discover();
+	bool confirm();
+	void halt();
+	void emit(PresenceEvent event, uint32_t now);
+};
+
+#endif
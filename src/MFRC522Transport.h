@@ -0,0 +1,781 @@
+/**
+ * Bus transports for the MFRC522 register interface.
+ *
+ * The MFRC522 can be connected by SPI, I2C or UART (datasheet section 8.1). Each transport below
+ * is a small policy class with the same non-virtual member functions, so MFRC522 calls are inlined
+ * into the register functions without any run-time dispatch:
+ *
+ *   void begin();                                          // Prepare pins, called by PCD_Init()
+ *   void setDevice(byte device);                           // Chip select pin (SPI) or address (I2C)
+ *   void writeRegister(byte reg, byte value);
+ *   void writeRegister(byte reg, byte count, byte *values);
+ *   byte readRegister(byte reg);
+ *   void readRegister(byte reg, byte count, byte *values);
+ *   void beginSession(); void endSession();               // See MFRC522BusSession
+ *   void suspendSession(); void resumeSession();
+ *
+ * reg is always one of the MFRC522::PCD_Register enums, that is the register address shifted
+ * one bit left as needed for SPI. The other transports shift it back.
+ *
+ * The transport is selected at compile time with MFRC522_TRANSPORT, SPI is the default:
+ *   -DMFRC522_TRANSPORT=MFRC522_TRANSPORT_I2C
+ * Like MFRC522_SPICLOCK the define must be seen by the library sources too, so set it as a build flag.
+ */
+#ifndef MFRC522Transport_h
+#define MFRC522Transport_h
+
+#include <stdint.h>
+#include <string.h>
+#include <Arduino.h>
+#include <SPI.h>
+
+#define MFRC522_TRANSPORT_SPI	1
+#define MFRC522_TRANSPORT_I2C	2
+#define MFRC522_TRANSPORT_UART	3
+#define MFRC522_TRANSPORT_MOCK	4
+#define MFRC522_TRANSPORT_REPLAY	5
+
+#ifndef MFRC522_TRANSPORT
+#define MFRC522_TRANSPORT MFRC522_TRANSPORT_SPI
+#endif
+
+#ifndef MFRC522_SPICLOCK
+#define MFRC522_SPICLOCK (4000000u)	// MFRC522 accept upto 10MHz, set to 4MHz.
+#endif
+
+#ifndef MFRC522_SPI_CHUNK_SIZE
+#define MFRC522_SPI_CHUNK_SIZE (64)	// Stack buffer for buffered SPI writes, the FIFO is 64 bytes.
+#endif
+
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_I2C
+#include <Wire.h>
+#endif
+
+/**
+ * SPI transport, datasheet section 8.1.2.
+ * Each instance can use its own SPIClass, e.g. HSPI/VSPI on ESP32 or SPI1 on RP2040, and SPISettings.
+ * Call begin() on the SPIClass before PCD_Init().
+ */
+class MFRC522TransportSPI {
+public:
+	MFRC522TransportSPI() : MFRC522TransportSPI(SS) {}	// SS is defined in pins_arduino.h
+	explicit MFRC522TransportSPI(	byte chipSelectPin,
+									SPIClass &spi = SPI,
+									const SPISettings &settings = SPISettings(MFRC522_SPICLOCK, MSBFIRST, SPI_MODE0)
+								) : _chipSelectPin(chipSelectPin), _spi(&spi), _settings(settings), _clock(MFRC522_SPICLOCK), _sessionDepth(0), _sessionActive(false) {
+		resolveChipSelect();
+#if MFRC522_STATS
+		transactions = 0;
+#endif
+	}
+
+	void begin() {
+		// Set the chipSelectPin as digital output, do not select the slave yet
+		pinMode(_chipSelectPin, OUTPUT);
+		digitalWrite(_chipSelectPin, HIGH);
+	}
+
+	void setDevice(byte chipSelectPin) {
+		_chipSelectPin = chipSelectPin;
+		resolveChipSelect();
+	}
+
+	SPIClass &spi() {
+		return *_spi;
+	}
+
+	const SPISettings &getSettings() {
+		return _settings;
+	}
+
+	void setSettings(const SPISettings &settings) {
+		_settings = settings;
+		_clock = 0;
+		if (_sessionActive) {					// Apply the new settings to the running session
+			_spi->endTransaction();
+			beginTransaction();
+		}
+	}
+
+	void setClock(uint32_t clock) {
+		setSettings(SPISettings(clock, MSBFIRST, SPI_MODE0));
+		_clock = clock;
+	}
+
+	void beginSession() {
+		if (_sessionDepth++ == 0) {
+			beginTransaction();
+			_sessionActive = true;
+		}
+	}
+
+	void endSession() {
+		if (_sessionDepth == 0) {
+			return;
+		}
+		if (--_sessionDepth == 0 && _sessionActive) {
+			_spi->endTransaction();
+			_sessionActive = false;
+		}
+	}
+
+	void suspendSession() {
+		if (_sessionActive) {
+			_spi->endTransaction();
+			_sessionActive = false;
+		}
+	}
+
+	void resumeSession() {
+		if (_sessionDepth > 0 && !_sessionActive) {
+			beginTransaction();
+			_sessionActive = true;
+		}
+	}
+
+	// The SPI clock in Hz, 0 if it is only known to the SPISettings given by the user
+	uint32_t getClock() {
+		return _clock;
+	}
+
+#if MFRC522_STATS
+	uint32_t transactions;		// beginTransaction() calls, see MFRC522::PCD_GetPerfStats()
+#endif
+
+	void writeRegister(byte reg, byte value) {
+		beginAccess();
+		_spi->transfer(reg);					// MSB == 0 is for writing. LSB is not used in address. Datasheet section 8.1.2.3.
+		_spi->transfer(value);
+		endAccess();
+	}
+
+	void writeRegister(byte reg, byte count, byte *values) {
+		beginAccess();
+		_spi->transfer(reg);					// MSB == 0 is for writing. LSB is not used in address. Datasheet section 8.1.2.3.
+#if defined(ESP32) || defined(ESP8266)
+		_spi->writeBytes(values, count);		// Transmit only, the driver fills the hardware FIFO
+#elif defined(__AVR__)
+		for (byte index = 0; index < count; index++) {	// A buffer transfer is the same loop on AVR, save the RAM
+			_spi->transfer(values[index]);
+		}
+#else
+		// The buffer transfer overwrites its data with the received bytes, so send a copy
+		byte buffer[MFRC522_SPI_CHUNK_SIZE];
+		while (count > 0) {
+			byte chunk = count < MFRC522_SPI_CHUNK_SIZE ? count : MFRC522_SPI_CHUNK_SIZE;
+			memcpy(buffer, values, chunk);
+			_spi->transfer(buffer, chunk);
+			values += chunk;
+			count -= chunk;
+		}
+#endif
+		endAccess();
+	}
+
+	byte readRegister(byte reg) {
+		byte value;
+		beginAccess();
+		_spi->transfer(0x80 | reg);				// MSB == 1 is for reading. LSB is not used in address. Datasheet section 8.1.2.3.
+		value = _spi->transfer(0);				// Read the value back. Send 0 to stop reading.
+		endAccess();
+		return value;
+	}
+
+	void readRegister(byte reg, byte count, byte *values) {
+		byte address = 0x80 | reg;				// MSB == 1 is for reading. LSB is not used in address. Datasheet section 8.1.2.3.
+		byte index = 0;
+		beginAccess();
+		_spi->transfer(address);				// Tell MFRC522 which address we want to read
+		// Every byte read tells the address to read next, the final 0 stops reading.
+		// Transfer them as one buffer, the values are received in place.
+		count--;
+		while (index < count) {
+			values[index] = address;
+			index++;
+		}
+		values[index] = 0;
+		_spi->transfer(values, count + 1);
+		endAccess();
+	}
+
+protected:
+	byte _chipSelectPin;		// Arduino pin connected to MFRC522's SPI slave select input (Pin 24, NSS, active low)
+	SPIClass *_spi;				// Bus the MFRC522 is connected to
+	SPISettings _settings;		// Clock, bit order and mode used for every transaction
+	uint32_t _clock;			// Clock of _settings, see getClock()
+	byte _sessionDepth;			// Number of open MFRC522BusSession
+	bool _sessionActive;		// The session holds the bus, register accesses skip beginTransaction()
+#if defined(__AVR__)
+	volatile uint8_t *_chipSelectPort;	// Output register of the chip select pin, nullptr to use digitalWrite()
+	uint8_t _chipSelectMask;
+#endif
+
+	void beginTransaction() {
+#if MFRC522_STATS
+		transactions++;
+#endif
+		_spi->beginTransaction(_settings);
+	}
+
+	// digitalWrite() on AVR looks up port and bit mask in flash on every call. Look them up once instead.
+	void resolveChipSelect() {
+#if defined(__AVR__)
+		_chipSelectPort = nullptr;
+		_chipSelectMask = digitalPinToBitMask(_chipSelectPin);
+		uint8_t port = digitalPinToPort(_chipSelectPin);
+		if (port != NOT_A_PIN) {
+			_chipSelectPort = portOutputRegister(port);
+		}
+#endif
+	}
+
+	void beginAccess() {
+		if (!_sessionActive) {
+			beginTransaction();					// Set the settings to work with SPI bus
+		}
+		select();
+	}
+
+	void endAccess() {
+		release();
+		if (!_sessionActive) {
+			_spi->endTransaction(); // Stop using the SPI bus
+		}
+	}
+
+	// Select slave
+	void select() {
+#if defined(__AVR__)
+		if (_chipSelectPort) {
+			// SREG is saved and interrupts are disabled as in digitalWrite(), the read-modify-write must not be
+			// interrupted. Only the pin table lookups of digitalWrite() are saved.
+			uint8_t oldSREG = SREG;
+			cli();
+			*_chipSelectPort &= ~_chipSelectMask;
+			SREG = oldSREG;
+			return;
+		}
+#endif
+		digitalWrite(_chipSelectPin, LOW);
+	}
+
+	// Release slave again
+	void release() {
+#if defined(__AVR__)
+		if (_chipSelectPort) {
+			uint8_t oldSREG = SREG;
+			cli();
+			*_chipSelectPort |= _chipSelectMask;
+			SREG = oldSREG;
+			return;
+		}
+#endif
+		digitalWrite(_chipSelectPin, HIGH);
+	}
+};
+
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_I2C
+#ifndef MFRC522_I2C_ADDRESS
+#define MFRC522_I2C_ADDRESS (0x28)	// Address with pins ADR_0..ADR_5 tied low, see datasheet section 8.1.3.2
+#endif
+
+/**
+ * I2C transport, datasheet section 8.1.3.
+ * All data bytes of one frame go to the same register, which allows fast FIFO access.
+ * Call Wire.begin() before PCD_Init(), as you would call SPI.begin().
+ */
+class MFRC522TransportI2C {
+public:
+	// Bytes per Wire frame, the AVR Wire library buffers 32 bytes including the register address
+	static constexpr byte CHUNK_SIZE = 30;
+
+	MFRC522TransportI2C() : MFRC522TransportI2C(MFRC522_I2C_ADDRESS) {}
+	explicit MFRC522TransportI2C(byte address, TwoWire &wire = Wire) : _address(address), _wire(&wire) {}
+
+	void begin() {}
+
+	void setDevice(byte address) {
+		_address = address;
+	}
+
+	void beginSession() {}
+	void endSession() {}
+	void suspendSession() {}
+	void resumeSession() {}
+
+	void writeRegister(byte reg, byte value) {
+		writeRegister(reg, 1, &value);
+	}
+
+	void writeRegister(byte reg, byte count, byte *values) {
+		while (count > 0) {
+			byte chunk = count < CHUNK_SIZE ? count : CHUNK_SIZE;
+			_wire->beginTransmission(_address);
+			_wire->write(reg >> 1);
+			_wire->write(values, chunk);
+			_wire->endTransmission();
+			values += chunk;
+			count -= chunk;
+		}
+	}
+
+	byte readRegister(byte reg) {
+		byte value = 0;
+		readRegister(reg, 1, &value);
+		return value;
+	}
+
+	void readRegister(byte reg, byte count, byte *values) {
+		while (count > 0) {
+			byte chunk = count < CHUNK_SIZE ? count : CHUNK_SIZE;
+			_wire->beginTransmission(_address);
+			_wire->write(reg >> 1);
+			_wire->endTransmission(false);		// Repeated start
+			_wire->requestFrom(_address, chunk);
+			for (byte index = 0; index < chunk; index++) {
+				values[index] = _wire->available() ? _wire->read() : 0;
+			}
+			values += chunk;
+			count -= chunk;
+		}
+	}
+
+protected:
+	byte _address;				// 7 bit I2C address of the MFRC522
+	TwoWire *_wire;
+};
+#endif // MFRC522_TRANSPORT_I2C
+
+#ifndef MFRC522_UART_SERIAL
+#define MFRC522_UART_SERIAL Serial	// Default 9600 baud, see datasheet section 8.1.4.1
+#endif
+
+/**
+ * UART transport, datasheet section 8.1.4.
+ * Every access is an address byte (bit 7 set for reading) and a data byte. The MFRC522 answers a
+ * write with the address byte and a read with the data byte.
+ * Call begin() on the serial port before PCD_Init().
+ */
+class MFRC522TransportUART {
+public:
+	MFRC522TransportUART() : MFRC522TransportUART(MFRC522_UART_SERIAL) {}
+	explicit MFRC522TransportUART(Stream &stream) : _stream(&stream) {}
+	// Accepts the chip select pin of the SPI constructors so MFRC522(ss, rst) keeps compiling; it is not used
+	explicit MFRC522TransportUART(byte) : MFRC522TransportUART(MFRC522_UART_SERIAL) {}
+
+	void begin() {
+		while (_stream->available()) {		// Drop anything sent while the MFRC522 powered up
+			_stream->read();
+		}
+	}
+
+	void setDevice(byte) {}
+
+	void beginSession() {}
+	void endSession() {}
+	void suspendSession() {}
+	void resumeSession() {}
+
+	void writeRegister(byte reg, byte value) {
+		byte echo;
+		_stream->write((byte)(reg >> 1));
+		_stream->write(value);
+		_stream->readBytes(&echo, 1);
+	}
+
+	void writeRegister(byte reg, byte count, byte *values) {
+		for (byte index = 0; index < count; index++) {
+			writeRegister(reg, values[index]);
+		}
+	}
+
+	byte readRegister(byte reg) {
+		byte value = 0;
+		_stream->write((byte)(0x80 | (reg >> 1)));
+		_stream->readBytes(&value, 1);
+		return value;
+	}
+
+	void readRegister(byte reg, byte count, byte *values) {
+		for (byte index = 0; index < count; index++) {
+			values[index] = readRegister(reg);
+		}
+	}
+
+protected:
+	Stream *_stream;
+};
+
+/**
+ * Recording transport without hardware, for tests on the host or on a board without a reader.
+ * Writes are stored in a register file and logged. Reads return the values queued with queueRead()
+ * first, then the register file.
+ */
+class MFRC522TransportMock {
+public:
+	static constexpr byte LOG_SIZE = 64;
+	static constexpr byte QUEUE_SIZE = 64;
+
+	typedef struct {
+		byte reg;		// PCD_Register as passed to the transport
+		byte value;
+		bool write;
+	} Access;
+
+	byte registers[64];			// Register file indexed by the register address (reg >> 1)
+	Access accesses[LOG_SIZE];	// Ring buffer of the last accesses
+	uint16_t logCount;			// Number of accesses since clearLog(), the newest is accesses[(logCount - 1) % LOG_SIZE]
+
+	MFRC522TransportMock() : registers(), accesses(), logCount(0), _queue(), _queueHead(0), _queueTail(0) {}
+	explicit MFRC522TransportMock(byte) : MFRC522TransportMock() {}
+
+	void begin() {}
+
+	void setDevice(byte) {}
+
+	void beginSession() {}
+	void endSession() {}
+	void suspendSession() {}
+	void resumeSession() {}
+
+	void writeRegister(byte reg, byte value) {
+		registers[(reg >> 1) & 0x3F] = value;
+		record(reg, value, true);
+	}
+
+	void writeRegister(byte reg, byte count, byte *values) {
+		for (byte index = 0; index < count; index++) {
+			writeRegister(reg, values[index]);
+		}
+	}
+
+	byte readRegister(byte reg) {
+		byte value = registers[(reg >> 1) & 0x3F];
+		if (_queueHead != _queueTail) {
+			value = _queue[_queueHead];
+			_queueHead = (_queueHead + 1) % QUEUE_SIZE;
+		}
+		record(reg, value, false);
+		return value;
+	}
+
+	void readRegister(byte reg, byte count, byte *values) {
+		for (byte index = 0; index < count; index++) {
+			values[index] = readRegister(reg);
+		}
+	}
+
+	bool queueRead(byte value) {
+		byte next = (_queueTail + 1) % QUEUE_SIZE;
+		if (next == _queueHead) {
+			return false;
+		}
+		_queue[_queueTail] = value;
+		_queueTail = next;
+		return true;
+	}
+
+	void clearLog() {
+		logCount = 0;
+	}
+
+protected:
+	byte _queue[QUEUE_SIZE];
+	byte _queueHead;
+	byte _queueTail;
+
+	void record(byte reg, byte value, bool write) {
+		Access &access = accesses[logCount % LOG_SIZE];
+		access.reg = reg;
+		access.value = value;
+		access.write = write;
+		logCount++;
+	}
+};
+
+/**
+ * Replays a register trace written by MFRC522::PCD_DumpTrace(), e.g. recorded on a reader in the field,
+ * so the library runs against real card behaviour on the host. Reads return the recorded values, writes
+ * are checked against the trace. Multi-byte reads need the payload, record with MFRC522_TRACE_PAYLOAD=1.
+ *
+ * Strict: every access must be the next one of the trace. The first one that is not is kept as
+ * divergence(), the accesses after it are answered like in Tolerant mode so the library can finish.
+ * Tolerant: accesses the trace has but the library no longer does are skipped, up to the next write of
+ * CommandReg that starts a command. Accesses the trace does not have are answered with the last value
+ * of the register in the trace. counts() then shows how the traffic of the library compares to the trace.
+ * The trace must stay valid while it is replayed, the transport keeps a pointer to it.
+ */
+class MFRC522TransportReplay {
+public:
+	enum Mode : byte { Strict, Tolerant };
+
+	static constexpr byte CONTINUATION = 0x7F;	// Address byte of a record carrying 7 more payload bytes of the access before
+	static constexpr byte LOOKAHEAD = 64;		// Records searched for the access of the library in Tolerant mode
+	static constexpr uint32_t NONE = 0xFFFFFFFF;
+
+	typedef struct {
+		uint32_t	record;			// Index of the trace record expected, the number of records if the trace ended
+		byte		address;		// Access of the library: address byte as in the trace
+		byte		value;			// ... and value or number of bytes
+		byte		expectedAddress;	// Access of the trace, 0 if the trace ended
+		byte		expectedValue;
+	} Divergence;
+
+	typedef struct {
+		uint32_t	frames;			// Register accesses of the library
+		uint32_t	bytes;			// Bytes they would move on SPI, address bytes included
+		uint32_t	traceFrames;	// Register accesses in the trace
+		uint32_t	matched;		// Accesses of the library found in the trace
+		uint32_t	skipped;		// Accesses of the trace the library did not do
+		uint32_t	extra;			// Accesses of the library not in the trace, answered from the register file
+		uint32_t	missingPayload;	// Multi-byte reads without recorded payload, only the first byte is known
+	} Counts;
+
+	MFRC522TransportReplay() : MFRC522TransportReplay(nullptr, 0) {}
+	// Accepts the chip select pin of the SPI constructors so MFRC522(ss, rst) keeps compiling; load() the trace later
+	explicit MFRC522TransportReplay(byte) : MFRC522TransportReplay(nullptr, 0) {}
+	MFRC522TransportReplay(const byte *trace, size_t size, Mode mode = Strict) {
+		load(trace, size, mode);
+	}
+
+	// Starts the replay of a trace from its first record
+	bool load(const byte *trace, size_t size, Mode mode = Strict) {
+		_records = nullptr;
+		_count = 0;
+		_next = 0;
+		_mode = mode;
+		memset(_registers, 0, sizeof(_registers));
+		memset(&_counts, 0, sizeof(_counts));
+		_divergence.record = NONE;
+		if (!trace || size < 8 || memcmp(trace, "MFTR", 4) != 0 || trace[4] < 1 || trace[4] > 2 || trace[5] != 8) {
+			return false;
+		}
+		_records = trace + 8;
+		_count = trace[6] | (trace[7] << 8);
+		if (size < 8 + (size_t)_count * 8) {
+			_count = (uint16_t)((size - 8) / 8);
+		}
+		for (uint16_t i = 0; i < _count; i++) {
+			_counts.traceFrames += _records[i * 8 + 4] != CONTINUATION;
+		}
+		skipContinuations();
+		return true;
+	}
+
+	bool diverged() const { return _divergence.record != NONE; }
+	const Divergence &divergence() const { return _divergence; }
+	const Counts &counts() const { return _counts; }
+	bool finished() const { return _next >= _count; }
+	uint32_t position() const { return _next; }
+
+	// CRC-8 with the polynomial 0x07 over the bytes of a multi-byte access, the digest in the trace
+	static byte digest(const byte *values, byte count) {
+		byte crc = 0;
+		for (byte i = 0; i < count; i++) {
+			crc ^= values[i];
+			for (byte bit = 0; bit < 8; bit++) {
+				crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+			}
+		}
+		return crc;
+	}
+
+	void begin() {}
+
+	void setDevice(byte) {}
+
+	void beginSession() {}
+	void endSession() {}
+	void suspendSession() {}
+	void resumeSession() {}
+
+	void writeRegister(byte reg, byte value) {
+		access(reg, value, nullptr);
+	}
+
+	void writeRegister(byte reg, byte count, byte *values) {
+		access(reg | 0x01, count, values);
+	}
+
+	byte readRegister(byte reg) {
+		byte value;
+		access(0x80 | reg, 1, &value);
+		return value;
+	}
+
+	void readRegister(byte reg, byte count, byte *values) {
+		access(0x80 | reg | 0x01, count, values);
+	}
+
+protected:
+	const byte *_records;		// First record of the trace
+	uint16_t _count;			// Records in the trace
+	uint32_t _next;				// Next record to replay
+	Mode _mode;
+	byte _registers[64];		// Last value of every register in the trace or written by the library
+	Counts _counts;
+	Divergence _divergence;
+
+	const byte *record(uint32_t index) const { return &_records[index * 8]; }
+
+	void skipContinuations() {
+		while (_next < _count && record(_next)[4] == CONTINUATION) {
+			_next++;
+		}
+	}
+
+	// Copies the payload of the multi-byte access at index, returns false if it was not recorded
+	bool payload(uint32_t index, byte *values, byte count) const {
+		byte copied = 0;
+		for (uint32_t i = index + 1; i < _count && record(i)[4] == CONTINUATION && copied < count; i++) {
+			const byte *r = record(i);
+			const byte bytes[7] = { r[0], r[1], r[2], r[3], r[5], r[6], r[7] };
+			for (byte j = 0; j < 7 && copied < count; j++) {
+				values[copied++] = bytes[j];
+			}
+		}
+		return copied == count;
+	}
+
+	// The access of the library matches the record: same register and direction, same data if written
+	bool matches(uint32_t index, byte address, byte value, const byte *values) const {
+		const byte *r = record(index);
+		if (r[4] != address) {
+			return false;
+		}
+		if (address & 0x80) {
+			return !(address & 0x01) || r[5] == value;
+		}
+		if (!(address & 0x01)) {
+			return r[5] == value;
+		}
+		return r[5] == value && (value == 0 || (r[6] == values[0] && r[7] == digest(values, value)));
+	}
+
+	// Updates the register file with a record of the trace that is consumed or skipped
+	void apply(uint32_t index) {
+		const byte *r = record(index);
+		byte reg = (r[4] >> 1) & 0x3F;
+		_registers[reg] = (r[4] & 0x01) ? r[6] : r[5];
+		_next = index + 1;
+		skipContinuations();
+	}
+
+	void access(byte address, byte value, byte *values) {
+		bool read = address & 0x80;
+		byte reg = (address >> 1) & 0x3F;
+		_counts.frames++;
+		_counts.bytes += (address & 0x01) ? 1 + value : 2;
+
+		uint32_t found = NONE;
+		if (_next < _count && matches(_next, address, value, values)) {
+			found = _next;
+		}
+		else if (_mode == Tolerant || diverged()) {
+			// Look ahead, but not past the start of the next command unless this is the start
+			for (uint32_t i = _next, seen = 0; i < _count && seen < LOOKAHEAD; i++) {
+				const byte *r = record(i);
+				if (r[4] == CONTINUATION) {
+					continue;
+				}
+				if (matches(i, address, value, values)) {
+					found = i;
+					break;
+				}
+				if (r[4] == (byte)(0x01 << 1) && !(address == (byte)(0x01 << 1) && !read)) {	// Write of CommandReg
+					break;
+				}
+				seen++;
+			}
+		}
+		else {
+			_divergence.record = _next;
+			_divergence.address = address;
+			_divergence.value = value;
+			_divergence.expectedAddress = _next < _count ? record(_next)[4] : 0;
+			_divergence.expectedValue = _next < _count ? record(_next)[5] : 0;
+		}
+
+		if (found == NONE) {
+			_counts.extra++;
+			if (read) {
+				for (byte i = 0; i < value; i++) {
+					values[i] = _registers[reg];
+				}
+			}
+			else {
+				_registers[reg] = (address & 0x01) ? (value ? values[value - 1] : _registers[reg]) : value;
+			}
+			return;
+		}
+
+		while (_next < found) {
+			if (record(_next)[4] != CONTINUATION) {
+				_counts.skipped++;
+			}
+			apply(_next);
+		}
+		_counts.matched++;
+		if (read) {
+			const byte *r = record(found);
+			if (address & 0x01) {
+				if (!payload(found, values, value)) {
+					_counts.missingPayload++;
+					memset(values, 0, value);
+					if (value > 0) {
+						values[0] = r[6];
+					}
+				}
+			}
+			else {
+				values[0] = r[5];
+			}
+		}
+		apply(found);
+	}
+};
+
+#if MFRC522_TRANSPORT == MFRC522_TRANSPORT_SPI
+typedef MFRC522TransportSPI MFRC522Transport;
+#elif MFRC522_TRANSPORT == MFRC522_TRANSPORT_I2C
+typedef MFRC522TransportI2C MFRC522Transport;
+#elif MFRC522_TRANSPORT == MFRC522_TRANSPORT_UART
+typedef MFRC522TransportUART MFRC522Transport;
+#elif MFRC522_TRANSPORT == MFRC522_TRANSPORT_MOCK
+typedef MFRC522TransportMock MFRC522Transport;
+#elif MFRC522_TRANSPORT == MFRC522_TRANSPORT_REPLAY
+typedef MFRC522TransportReplay MFRC522Transport;
+#else
+#error "Unknown MFRC522_TRANSPORT"
+#endif
+
+/**
+ * Holds the bus for a sequence of register accesses, so e.g. SPI.beginTransaction() is called once
+ * instead of for every access. Sessions nest, the bus is released when the outermost one ends.
+ * Call suspend() before delay() or yield() so other users of the bus are not starved, and resume() after.
+ *
+ *   MFRC522BusSession session(mfrc522.PCD_GetTransport());
+ */
+class MFRC522BusSession {
+public:
+	explicit MFRC522BusSession(MFRC522Transport &transport) : _transport(transport) {
+		_transport.beginSession();
+	}
+	~MFRC522BusSession() {
+		_transport.endSession();
+	}
+	MFRC522BusSession(const MFRC522BusSession &) = delete;
+	MFRC522BusSession &operator=(const MFRC522BusSession &) = delete;
+
+	void suspend() {
+		_transport.suspendSession();
+	}
+	void resume() {
+		_transport.resumeSession();
+	}
+
+protected:
+	MFRC522Transport &_transport;
+};
+
+#endif